@@ -0,0 +1,60 @@
+// Example CE plugin. See crts_ce_plugin.h
+//
+// Moves one rung down the MCS ladder after every invalid payload, and one
+// step up after a run of error free payloads.
+// pluginArgs: "up_after=N" sets the length of that run (default 10).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "crts_ce_plugin.h"
+
+struct exampleState {
+    unsigned int up_after;
+    unsigned int run;               // Error free payloads since the last change
+};
+
+static void * exampleCreate(const char * args)
+{
+    struct exampleState * s = (struct exampleState *) calloc(1, sizeof(struct exampleState));
+    s->up_after = 10;
+    sscanf(args, "up_after=%u", &s->up_after);
+    return s;
+} // End exampleCreate()
+
+static void exampleDestroy(void * state)
+{
+    free(state);
+} // End exampleDestroy()
+
+static int exampleDecide(void * state, const struct crts_ce_feedback * fb,
+                         const struct crts_ce_metrics * metrics, struct crts_ce_delta * delta)
+{
+    struct exampleState * s = (struct exampleState *) state;
+
+    if (!fb->payload_valid)
+    {
+        s->run = 0;
+        delta->set = CRTS_CE_SET_MCS_STEP;
+        delta->mcs_step = -1;
+    }
+    else if (fb->payloadBitErrors == 0 && ++s->run >= s->up_after)
+    {
+        s->run = 0;
+        delta->set = CRTS_CE_SET_MCS_STEP;
+        delta->mcs_step = 1;
+    }
+    return 0;
+} // End exampleDecide()
+
+static const struct crts_ce_plugin examplePlugin = {
+    CRTS_CE_PLUGIN_ABI_VERSION,
+    "exampleCE",
+    exampleCreate,
+    exampleDestroy,
+    exampleDecide
+};
+
+const struct crts_ce_plugin * crts_ce_plugin_entry(void)
+{
+    return &examplePlugin;
+} // End crts_ce_plugin_entry()
@@ -0,0 +1,411 @@
+// crts-analyze -- Summarize the binary logs written by 'crts -l'.
+//
+// Every log is memory-mapped and read in a single pass, one thread per log.
+// The totals of all logs are then merged by CE and scenario, so repeated
+// experiments can be analyzed together.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sysexits.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "crts_log.h"
+
+void usage() {
+    printf("crts-analyze -- Summarize binary crts logs (crts -l) by CE and scenario.\n");
+    printf("usage: crts-analyze [options] log...\n");
+    printf("  -h     :   usage/help\n");
+    printf("  -w     :   print a time series of every cell, averaged over windows of this many frames\n");
+    printf("  -j     :   number of threads (default: one per log, up to the number of CPUs)\n");
+}
+
+// Totals of one CE/scenario cell, or of several
+struct cellTotals {
+    unsigned long long frames;
+    unsigned long long valid_headers;
+    unsigned long long valid_payloads;
+    unsigned long long bits;
+    unsigned long long bit_errors;
+    double EVM;                         // Sums over the frames
+    double RSSI;
+    double throughput;
+    double goodput;                     // Throughput of the frames whose payload was valid
+    double time;                        // Seconds on the test clock, summed over the runs
+    unsigned int runs;                  // Cells that ran to the end
+};
+
+// One cell of a log while it is read
+struct cellState {
+    int i_CE;
+    int i_Sc;
+    int repetition;
+    struct cellTotals totals;
+    unsigned int window_frames;         // Frames since the last time series line
+    double window_throughput;           // Sums over those frames
+    double window_payload_valid;
+    double window_evm;
+};
+
+// Analysis of one log
+struct logAnalysis {
+    const char * filename;
+    int window;                         // Frames per time series line, 0 for none
+    int status;                         // EX_OK, or why the log could not be read
+    unsigned long long records;
+    int num_cells;
+    int max_cells;
+    struct cellState * cells;
+    char * series;                      // Time series text
+    size_t series_len;
+};
+
+struct analysisPool {
+    int num_logs;
+    int next;                           // Next log to analyze, taken with an atomic add
+    struct logAnalysis * logs;
+};
+
+// A row of a summary table
+struct summaryRow {
+    int i_CE;                           // -1 in per-scenario rows
+    int i_Sc;                           // -1 in per-CE rows
+    struct cellTotals totals;
+    double goodput_sum;                 // Sum of the mean goodput of each cell, for the ranking
+    int num_cells;
+};
+
+void addTotals(struct cellTotals * dst, const struct cellTotals * src)
+{
+    dst->frames += src->frames;
+    dst->valid_headers += src->valid_headers;
+    dst->valid_payloads += src->valid_payloads;
+    dst->bits += src->bits;
+    dst->bit_errors += src->bit_errors;
+    dst->EVM += src->EVM;
+    dst->RSSI += src->RSSI;
+    dst->throughput += src->throughput;
+    dst->goodput += src->goodput;
+    dst->time += src->time;
+    dst->runs += src->runs;
+} // End addTotals()
+
+// The state of a cell, created the first time the cell is seen
+struct cellState * findCell(struct logAnalysis * a, int i_CE, int i_Sc, int repetition)
+{
+    for (int i=0; i<a->num_cells; i++)
+    {
+        struct cellState * c = &a->cells[i];
+        if (c->i_CE == i_CE && c->i_Sc == i_Sc && c->repetition == repetition)
+            return c;
+    }
+    if (a->num_cells == a->max_cells)
+    {
+        a->max_cells = a->max_cells ? 2*a->max_cells : 16;
+        a->cells = (struct cellState *) realloc(a->cells, a->max_cells*sizeof(struct cellState));
+    }
+    struct cellState * c = &a->cells[a->num_cells++];
+    memset(c, 0, sizeof(struct cellState));
+    c->i_CE = i_CE;
+    c->i_Sc = i_Sc;
+    c->repetition = repetition;
+    return c;
+} // End findCell()
+
+// Read one log from start to end
+void analyzeLog(struct logAnalysis * a)
+{
+    int fd = open(a->filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0)
+    {
+        fprintf(stderr, "ERROR: Could not open %s: %s\n", a->filename, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        a->status = EX_NOINPUT;
+        return;
+    }
+    size_t size = st.st_size;
+    if (size < sizeof(struct crts_log_file_header))
+    {
+        fprintf(stderr, "ERROR: %s is not a binary crts log\n", a->filename);
+        close(fd);
+        a->status = EX_DATAERR;
+        return;
+    }
+    const unsigned char * base = (const unsigned char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Could not map %s: %s\n", a->filename, strerror(errno));
+        a->status = EX_IOERR;
+        return;
+    }
+    madvise((void *) base, size, MADV_SEQUENTIAL);
+
+    const struct crts_log_file_header * h = (const struct crts_log_file_header *) base;
+    if (h->magic != CRTS_LOG_MAGIC || h->version != CRTS_LOG_VERSION || h->record_size != sizeof(struct crts_log_record))
+    {
+        fprintf(stderr, "ERROR: %s is not a binary log of this version of crts\n", a->filename);
+        munmap((void *) base, size);
+        a->status = EX_DATAERR;
+        return;
+    }
+    const struct crts_log_record * records = (const struct crts_log_record *) (base + sizeof(struct crts_log_file_header));
+    size_t n = (size - sizeof(struct crts_log_file_header))/sizeof(struct crts_log_record);
+    if (n*sizeof(struct crts_log_record) != size - sizeof(struct crts_log_file_header))
+        fprintf(stderr, "WARNING: %s ends with a partial record\n", a->filename);
+
+    FILE * series = NULL;
+    if (a->window > 0)
+        series = open_memstream(&a->series, &a->series_len);
+
+    // Records of one cell mostly follow each other
+    struct cellState * c = NULL;
+    for (size_t i=0; i<n; i++)
+    {
+        const struct crts_log_record * r = &records[i];
+        if (c == NULL || c->i_CE != r->i_CE || c->i_Sc != r->i_Sc || c->repetition != r->repetition)
+            c = findCell(a, r->i_CE, r->i_Sc, r->repetition);
+
+        if (r->type == CRTS_LOG_FRAME)
+        {
+            const struct crts_log_frame * f = &r->u.frame;
+            struct cellTotals * t = &c->totals;
+            t->frames++;
+            t->valid_headers += f->header_valid;
+            t->valid_payloads += f->payload_valid;
+            t->bits += 8ull*f->payload_len;
+            t->bit_errors += f->bit_errors;
+            t->EVM += f->evm;
+            t->RSSI += f->rssi;
+            t->throughput += f->throughput;
+            if (f->payload_valid)
+                t->goodput += f->throughput;
+
+            if (series != NULL)
+            {
+                c->window_throughput += f->throughput;
+                c->window_payload_valid += f->payload_valid;
+                c->window_evm += f->evm;
+                if (++c->window_frames == (unsigned int) a->window)
+                {
+                    fprintf(series, "%-10s%-5i%-9i%-5i%-10u%-12.4f%-12.2f%-15.3f%-10.2f\n", "series",
+                        c->i_CE+1, c->i_Sc+1, c->repetition+1, f->iteration, f->ce_time,
+                        c->window_throughput/a->window, c->window_payload_valid/a->window, c->window_evm/a->window);
+                    c->window_frames = 0;
+                    c->window_throughput = c->window_payload_valid = c->window_evm = 0.0;
+                }
+            }
+        }
+        else if (r->type == CRTS_LOG_CELL_END)
+        {
+            c->totals.time += r->u.cell.time;
+            c->totals.runs++;
+        }
+    }
+    a->records = n;
+
+    if (series != NULL)
+        fclose(series);
+    munmap((void *) base, size);
+    a->status = EX_OK;
+} // End analyzeLog()
+
+void * analysisThread(void * _pool)
+{
+    struct analysisPool * pool = (struct analysisPool *) _pool;
+    int i;
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->num_logs)
+        analyzeLog(&pool->logs[i]);
+    return NULL;
+} // End analysisThread()
+
+// The row for a CE and scenario (-1 for any), created if there is none yet
+struct summaryRow * findRow(struct summaryRow * rows, int * num_rows, int i_CE, int i_Sc)
+{
+    for (int i=0; i<*num_rows; i++)
+        if (rows[i].i_CE == i_CE && rows[i].i_Sc == i_Sc)
+            return &rows[i];
+    struct summaryRow * row = &rows[(*num_rows)++];
+    memset(row, 0, sizeof(struct summaryRow));
+    row->i_CE = i_CE;
+    row->i_Sc = i_Sc;
+    return row;
+} // End findRow()
+
+bool rowBefore(const struct summaryRow & a, const struct summaryRow & b)
+{
+    if (a.i_CE != b.i_CE)
+        return a.i_CE < b.i_CE;
+    return a.i_Sc < b.i_Sc;
+} // End rowBefore()
+
+bool rowRanksBefore(const struct summaryRow & a, const struct summaryRow & b)
+{
+    return a.goodput_sum/a.num_cells > b.goodput_sum/b.num_cells;
+} // End rowRanksBefore()
+
+void printSummaryHeader()
+{
+    printf("%-5s%-10s%-6s%-12s%-15s%-16s%-11s%-10s%-11s%-13s%-13s%-10s\n", "CE", "Scenario", "Runs", "Frames",
+        "Valid Headers", "Valid Payloads", "BER", "EVM (dB)", "RSSI (dB)", "Throughput", "Goodput", "Time (s)");
+} // End printSummaryHeader()
+
+void printSummaryRow(const struct summaryRow * row)
+{
+    const struct cellTotals * t = &row->totals;
+    double frames = t->frames > 0 ? (double) t->frames : 1.0;
+    char ce[16], sc[16];
+    if (row->i_CE >= 0) snprintf(ce, sizeof(ce), "%d", row->i_CE+1); else strcpy(ce, "all");
+    if (row->i_Sc >= 0) snprintf(sc, sizeof(sc), "%d", row->i_Sc+1); else strcpy(sc, "all");
+    printf("%-5s%-10s%-6u%-12llu%-15.4f%-16.4f%-11.2e%-10.2f%-11.2f%-13.2f%-13.2f%-10.2f\n", ce, sc, t->runs, t->frames,
+        t->valid_headers/frames, t->valid_payloads/frames, t->bits > 0 ? (double) t->bit_errors/t->bits : 0.0,
+        t->EVM/frames, t->RSSI/frames, t->throughput/frames, t->goodput/frames, t->time);
+} // End printSummaryRow()
+
+int main(int argc, char ** argv)
+{
+    int window = 0;
+    int numThreads = 0;
+
+    int d;
+    while ((d = getopt(argc, argv, "hw:j:")) != EOF) {
+        switch (d) {
+        case 'h':   usage();                                return 0;
+        case 'w':   window = atoi(optarg);                  break;
+        case 'j':   numThreads = atoi(optarg);              break;
+        default:    usage();                                return EX_USAGE;
+        }
+    }
+    if (optind >= argc || window < 0 || numThreads < 0)
+    {
+        usage();
+        return EX_USAGE;
+    }
+
+    struct analysisPool pool;
+    pool.num_logs = argc - optind;
+    pool.next = 0;
+    pool.logs = (struct logAnalysis *) calloc(pool.num_logs, sizeof(struct logAnalysis));
+    for (int i=0; i<pool.num_logs; i++)
+    {
+        pool.logs[i].filename = argv[optind+i];
+        pool.logs[i].window = window;
+    }
+
+    if (numThreads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        numThreads = cpus > 0 ? (int) cpus : 1;
+    }
+    if (numThreads > pool.num_logs)
+        numThreads = pool.num_logs;
+    pthread_t * threads = (pthread_t *) calloc(numThreads, sizeof(pthread_t));
+    for (int i=0; i<numThreads; i++)
+        pthread_create(&threads[i], NULL, analysisThread, (void *) &pool);
+    for (int i=0; i<numThreads; i++)
+        pthread_join(threads[i], NULL);
+
+    // Merge the cells of every log by CE and scenario
+    int status = EX_OK;
+    int num_cells = 0;
+    for (int i=0; i<pool.num_logs; i++)
+        num_cells += pool.logs[i].num_cells;
+    struct summaryRow * cells = (struct summaryRow *) calloc(num_cells+1, sizeof(struct summaryRow));
+    int num_rows = 0;
+    for (int i=0; i<pool.num_logs; i++)
+    {
+        struct logAnalysis * a = &pool.logs[i];
+        if (a->status != EX_OK)
+        {
+            status = a->status;
+            continue;
+        }
+        for (int k=0; k<a->num_cells; k++)
+        {
+            struct summaryRow * row = findRow(cells, &num_rows, a->cells[k].i_CE, a->cells[k].i_Sc);
+            addTotals(&row->totals, &a->cells[k].totals);
+        }
+    }
+    std::sort(cells, cells+num_rows, rowBefore);
+
+    // Sums by CE and by scenario. Every scenario counts the same in the
+    // ranking, however many frames it took.
+    struct summaryRow * byCE = (struct summaryRow *) calloc(num_rows+1, sizeof(struct summaryRow));
+    struct summaryRow * bySc = (struct summaryRow *) calloc(num_rows+1, sizeof(struct summaryRow));
+    int num_CE = 0, num_Sc = 0;
+    for (int i=0; i<num_rows; i++)
+    {
+        const struct cellTotals * t = &cells[i].totals;
+        double goodput = t->frames > 0 ? t->goodput/t->frames : 0.0;
+        struct summaryRow * ce = findRow(byCE, &num_CE, cells[i].i_CE, -1);
+        addTotals(&ce->totals, t);
+        ce->goodput_sum += goodput;
+        ce->num_cells++;
+        struct summaryRow * sc = findRow(bySc, &num_Sc, -1, cells[i].i_Sc);
+        addTotals(&sc->totals, t);
+        sc->goodput_sum += goodput;
+        sc->num_cells++;
+    }
+    std::sort(byCE, byCE+num_CE, rowBefore);
+    std::sort(bySc, bySc+num_Sc, rowBefore);
+
+    unsigned long long records = 0;
+    for (int i=0; i<pool.num_logs; i++)
+        records += pool.logs[i].records;
+    printf("%d log(s), %llu records\n\n", pool.num_logs, records);
+
+    if (window > 0)
+    {
+        printf("Time series, averaged over %d frames\n", window);
+        printf("%-10s%-5s%-9s%-5s%-10s%-12s%-12s%-15s%-10s\n", "Linetype", "CE", "Scenario", "Run", "Frame",
+            "Time (s)", "Throughput", "Valid Payloads", "EVM (dB)");
+        for (int i=0; i<pool.num_logs; i++)
+        {
+            if (pool.logs[i].series != NULL)
+                fwrite(pool.logs[i].series, 1, pool.logs[i].series_len, stdout);
+            free(pool.logs[i].series);
+        }
+        printf("\n");
+    }
+
+    printf("By CE and scenario\n");
+    printSummaryHeader();
+    for (int i=0; i<num_rows; i++)
+        printSummaryRow(&cells[i]);
+    printf("\nBy CE\n");
+    printSummaryHeader();
+    for (int i=0; i<num_CE; i++)
+        printSummaryRow(&byCE[i]);
+    printf("\nBy scenario\n");
+    printSummaryHeader();
+    for (int i=0; i<num_Sc; i++)
+        printSummaryRow(&bySc[i]);
+
+    printf("\nCE ranking by goodput, averaged over scenarios\n");
+    printf("%-6s%-5s%-13s%-16s\n", "Rank", "CE", "Goodput", "Valid Payloads");
+    std::stable_sort(byCE, byCE+num_CE, rowRanksBefore);
+    for (int i=0; i<num_CE; i++)
+    {
+        const struct cellTotals * t = &byCE[i].totals;
+        printf("%-6d%-5d%-13.2f%-16.4f\n", i+1, byCE[i].i_CE+1, byCE[i].goodput_sum/byCE[i].num_cells,
+            t->frames > 0 ? (double) t->valid_payloads/t->frames : 0.0);
+    }
+
+    for (int i=0; i<pool.num_logs; i++)
+        free(pool.logs[i].cells);
+    free(pool.logs);
+    free(cells);
+    free(byCE);
+    free(bySc);
+    free(threads);
+    return status;
+} // End main()
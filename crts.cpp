@@ -2,7 +2,9 @@
 #include <stdlib.h>
 #include <sysexits.h>
 #include <math.h>
+#include <stdint.h>
 #include <complex>
+#include <algorithm>
 #include <liquid/liquid.h>
 // Definition of liquid_float_complex changes depending on
 // whether <complex> is included before or after liquid.h
@@ -27,7 +29,28 @@
 #include <uhd/usrp/multi_usrp.hpp>
 #include <uhd/utils/msg.hpp>
 #include <getopt.h>     // For command line options
-#define MAXPENDING 5
+#include <sys/stat.h>
+#include <sys/inotify.h>  // For reloading userEngine.txt
+#include <sys/epoll.h>    // For the controller's TCP server
+#include <sys/eventfd.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <dlfcn.h>        // For CE plugins
+#include "crts_ce_plugin.h"
+#include "windowed_stats.h"
+#include "crts_log.h"
+#include "stage_profile.h"
+#include <sched.h>
+// For the vectorized channel kernels
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRTS_X86_SIMD 1
+#endif
+
+// Largest payload a CE may use [bytes]
+#define PN_MAX_PAYLOAD_LEN 1000
 
 // SO_REUSEPORT is defined only defined with linux 3.10+.
 // Makes compatible with earlier kernels.
@@ -52,6 +75,11 @@ void usage() {
     printf("  -M     :   number of subcarriers (when not controller. default: 64)\n");
     printf("  -C     :   cyclic prefix length (when not controller. default: 16)\n");
     printf("  -T     :   taper length (when not controller. default: 4)\n");
+    printf("  -j     :   simulate the CE/scenario cells in parallel on this many threads\n");
+    printf("  -n     :   number of repetitions of each cell (implies -j 1 unless -j given)\n");
+    printf("  -e     :   write bit errors by decoded payload byte to the data file after each scenario (simulation mode)\n");
+    printf("  -l     :   write the data as a binary log (see crts_log.h) instead of text\n");
+    printf("  -L     :   print a binary log as a text data file and exit\n");
     //printf("  f     :   center frequency [Hz], default: 462 MHz\n");
     //printf("  b     :   bandwidth [Hz], default: 250 kHz\n");
     //printf("  G     :   uhd rx gain [dB] (default: 20dB)\n");
@@ -59,48 +87,215 @@ void usage() {
     //printf("  z     :   number of subcarriers to notch in the center band, default: 0\n");
 }
 
-// Class to create running average objects
-template <class T>
-class running_avg{
-	public:
-	// Variables
-	int avg_len;
-	int position;
-	float avg;
-	T *memory;
-
-	// Constructor
-	running_avg(int length){
-		avg_len = length;
-		position = 0;
-		avg = (T) 0;
-		memory = new T[avg_len]();
-	}
+// Windows of up to this many values are kept inside the CE struct
+#define CE_STATS_INLINE_LEN 128
 
-	// Destructor
-	~running_avg(){
-		delete memory;
-	}
+// Top of the range of the BER quantiles. Worse BERs count as this one.
+#define CE_BER_STATS_MAX 0.25f
 
-	// Function to update the running average
-	float update(T input){
-		avg -= (float)*(memory+position)/(float)avg_len;
-		*(memory+position) = input;
-		avg += (float)input/(float)avg_len;
-		position++;
-		if(position == avg_len) position = 0;
-		return avg;
-	}
+// Most frames that may await feedback at once ('framesInFlight' option)
+#define MAX_FRAMES_IN_FLIGHT 64
+
+// Goals a CE can be given ('goal' option)
+enum ceGoalType {
+    CE_GOAL_PAYLOAD_VALID = 0,
+    CE_GOAL_X_VALID_PAYLOADS,
+    CE_GOAL_X_ERROR_FREE_PAYLOADS,
+    CE_GOAL_X_FRAMES,
+    CE_GOAL_X_SECONDS,
+    NUM_CE_GOALS
+};
+static const char * ceGoalNames[NUM_CE_GOALS] = {
+    "payload_valid", "X_valid_payloads", "X_errorFreePayloads", "X_frames", "X_seconds"};
+
+// Conditions under which a CE adapts ('adaptationCondition' option)
+enum ceConditionType {
+    CE_CONDITION_NONE = 0,                  // Never adapt
+    CE_CONDITION_USER_SPECIFIED,            // Read userEngine.txt and adapt every frame
+    CE_CONDITION_LAST_PAYLOAD_INVALID,
+    CE_CONDITION_WEIGHTED_AVG_PAYLOAD_VALID_LT,
+    CE_CONDITION_WEIGHTED_AVG_PAYLOAD_VALID_GT,
+    CE_CONDITION_PER_LT,
+    CE_CONDITION_PER_GT,
+    CE_CONDITION_BER_LAST_PACKET_LT,
+    CE_CONDITION_BER_LAST_PACKET_GT,
+    CE_CONDITION_LAST_PACKET_ERROR_FREE,
+    CE_CONDITION_PER_VARIANCE_LT,           // Over the last PER_averaging frames
+    CE_CONDITION_PER_VARIANCE_GT,
+    CE_CONDITION_BER_QUANTILE_LT,           // Over the last BER_averaging frames
+    CE_CONDITION_BER_QUANTILE_GT,
+    NUM_CE_CONDITIONS
+};
+static const char * ceConditionNames[NUM_CE_CONDITIONS] = {
+    "none", "user_specified", "last_payload_invalid", "weighted_avg_payload_valid<X",
+    "weighted_avg_payload_valid>X", "PER<X", "PER>X", "BER_lastPacket<X", "BER_lastPacket>X",
+    "last_packet_error_free", "PER_variance<X", "PER_variance>X", "BER_quantile<X", "BER_quantile>X"};
+
+// Adaptations a CE can make ('adaptation' option)
+enum ceAdaptationType {
+    CE_ADAPT_NONE = 0,
+    CE_ADAPT_INCREASE_PAYLOAD_LEN,
+    CE_ADAPT_DECREASE_PAYLOAD_LEN,
+    CE_ADAPT_DECREASE_MOD_SCHEME_PSK,
+    CE_ADAPT_DECREASE_MOD_SCHEME_ASK,
+    CE_ADAPT_OUTER_FEC_ON_OFF,
+    CE_ADAPT_NO_FEC,
+    CE_ADAPT_INCREASE_FEC,
+    CE_ADAPT_DECREASE_FEC,
+    CE_ADAPT_SET_MOD_SCHEME,                // "mod_scheme->" followed by a modulation name
+    CE_ADAPT_INCREASE_MCS,                  // Next entry of the MCS table
+    CE_ADAPT_DECREASE_MCS,                  // Previous entry of the MCS table
+    CE_ADAPT_SET_MCS_EFFICIENCY,            // "mcs->" followed by a target spectral efficiency
+    NUM_CE_ADAPTATIONS
+};
+static const char * ceAdaptationNames[NUM_CE_ADAPTATIONS] = {
+    "None", "increase_payload_len", "decrease_payload_len", "decrease_mod_scheme_PSK",
+    "decrease_mod_scheme_ASK", "Outer FEC On/Off", "no_fec", "increase_fec", "decrease_fec",
+    "mod_scheme->", "increase_mcs", "decrease_mcs", "mcs->"};
+
+// How the feedback of several receivers is combined ('feedbackAggregation' option)
+enum feedbackAggregationType {
+    FB_AGGREGATE_WORST_NODE = 0,    // Use the feedback of the receiver that did worst
+    FB_AGGREGATE_MEAN,              // Average the feedback of all receivers
+    FB_AGGREGATE_PER_NODE,          // Run a copy of the CE for each receiver, sending to them in turn
+    NUM_FB_AGGREGATIONS
+};
+static const char * feedbackAggregationNames[NUM_FB_AGGREGATIONS] = {"worst_node", "mean", "per_node"};
+
+// Names of the liquid schemes used in CE config files
+struct schemeName {
+    const char * name;
+    int scheme;
+    unsigned int bps;           // Bits per symbol (modulation schemes only)
+};
+
+static const struct schemeName modSchemeNames[] = {
+    {"BPSK",   LIQUID_MODEM_BPSK,   1},
+    {"QPSK",   LIQUID_MODEM_QPSK,   2},
+    {"OOK",    LIQUID_MODEM_OOK,    1},
+    {"8PSK",   LIQUID_MODEM_PSK8,   3},
+    {"16PSK",  LIQUID_MODEM_PSK16,  4},
+    {"32PSK",  LIQUID_MODEM_PSK32,  5},
+    {"64PSK",  LIQUID_MODEM_PSK64,  6},
+    {"128PSK", LIQUID_MODEM_PSK128, 7},
+    {"8QAM",   LIQUID_MODEM_QAM8,   3},
+    {"16QAM",  LIQUID_MODEM_QAM16,  4},
+    {"32QAM",  LIQUID_MODEM_QAM32,  5},
+    {"64QAM",  LIQUID_MODEM_QAM64,  6},
+    {"BASK",   LIQUID_MODEM_ASK2,   1},
+    {"4ASK",   LIQUID_MODEM_ASK4,   2},
+    {"8ASK",   LIQUID_MODEM_ASK8,   3},
+    {"16ASK",  LIQUID_MODEM_ASK16,  4},
+    {"32ASK",  LIQUID_MODEM_ASK32,  5},
+    {"64ASK",  LIQUID_MODEM_ASK64,  6},
+    {"128ASK", LIQUID_MODEM_ASK128, 7},
+};
+#define NUM_MOD_SCHEME_NAMES (sizeof(modSchemeNames)/sizeof(modSchemeNames[0]))
+
+static const struct schemeName crcSchemeNames[] = {
+    {"none",     LIQUID_CRC_NONE,     0},
+    {"checksum", LIQUID_CRC_CHECKSUM, 0},
+    {"8",        LIQUID_CRC_8,        0},
+    {"16",       LIQUID_CRC_16,       0},
+    {"24",       LIQUID_CRC_24,       0},
+    {"32",       LIQUID_CRC_32,       0},
+};
+#define NUM_CRC_SCHEME_NAMES (sizeof(crcSchemeNames)/sizeof(crcSchemeNames[0]))
+
+// In order of increasing protection
+static const struct schemeName fecSchemeNames[] = {
+    {"none",        LIQUID_FEC_NONE,       0},
+    {"Hamming74",   LIQUID_FEC_HAMMING74,  0},
+    {"Hamming128",  LIQUID_FEC_HAMMING128, 0},
+    {"Golay2412",   LIQUID_FEC_GOLAY2412,  0},
+    {"SEC-DED2216", LIQUID_FEC_SECDED2216, 0},
+    {"SEC-DED3932", LIQUID_FEC_SECDED3932, 0},
+    {"SEC-DED7264", LIQUID_FEC_SECDED7264, 0},
+};
+#define NUM_FEC_SCHEME_NAMES (sizeof(fecSchemeNames)/sizeof(fecSchemeNames[0]))
+
+// A modulation and coding scheme. mod, fec0 and fec1 index modSchemeNames
+// and fecSchemeNames.
+struct mcsEntry {
+    unsigned char mod;
+    unsigned char fec0;         // Inner FEC
+    unsigned char fec1;         // Outer FEC
+    unsigned char bitsPerSymbol;
+    float rate;                 // Combined code rate of both FECs
+    float efficiency;           // Information bits per symbol
+};
+
+// Every combination of the CE's modulation and FEC options, sorted by
+// increasing spectral efficiency. Built by initMCSTable().
+#define NUM_MCS (NUM_MOD_SCHEME_NAMES*NUM_FEC_SCHEME_NAMES*NUM_FEC_SCHEME_NAMES)
+struct mcsEntry mcsTable[NUM_MCS];
+// Index in mcsTable of each [mod][fec0][fec1]
+unsigned short mcsIndexTable[NUM_MOD_SCHEME_NAMES][NUM_FEC_SCHEME_NAMES][NUM_FEC_SCHEME_NAMES];
+
+// The schemes that stepwise MCS adaptations move along, in order of strictly
+// increasing efficiency and decreasing robustness: BPSK, QPSK, 16QAM and
+// 64QAM with inner codes of rate 1/2 (Golay2412), 2/3 (Hamming128) and
+// 8/9 (SEC-DED7264), leaving out rungs that would not raise the efficiency,
+// and uncoded 64QAM at the top.
+struct mcsRung {
+    int mod;                    // liquid modulation_scheme
+    int fec0;                   // liquid fec_scheme of the inner code, no outer code
+};
+static const struct mcsRung mcsLadderRungs[] = {
+    {LIQUID_MODEM_BPSK,  LIQUID_FEC_GOLAY2412},      // 0.50 bits/symbol
+    {LIQUID_MODEM_BPSK,  LIQUID_FEC_HAMMING128},     // 0.67
+    {LIQUID_MODEM_QPSK,  LIQUID_FEC_GOLAY2412},      // 1.00
+    {LIQUID_MODEM_QPSK,  LIQUID_FEC_HAMMING128},     // 1.33
+    {LIQUID_MODEM_QPSK,  LIQUID_FEC_SECDED7264},     // 1.78
+    {LIQUID_MODEM_QAM16, LIQUID_FEC_GOLAY2412},      // 2.00
+    {LIQUID_MODEM_QAM16, LIQUID_FEC_HAMMING128},     // 2.67
+    {LIQUID_MODEM_QAM16, LIQUID_FEC_SECDED7264},     // 3.56
+    {LIQUID_MODEM_QAM64, LIQUID_FEC_HAMMING128},     // 4.00
+    {LIQUID_MODEM_QAM64, LIQUID_FEC_SECDED7264},     // 5.33
+    {LIQUID_MODEM_QAM64, LIQUID_FEC_NONE},           // 6.00
+};
+#define NUM_MCS_LADDER (sizeof(mcsLadderRungs)/sizeof(mcsLadderRungs[0]))
+// Index in mcsTable of each rung. Built by initMCSTable().
+unsigned short mcsLadder[NUM_MCS_LADDER];
+
+// Learning engines that can choose a CE's parameters ('learningAlgorithm' option)
+enum learningAlgorithmType {
+    LEARNING_NONE = 0,
+    LEARNING_UCB1,              // Upper confidence bound bandit
+    LEARNING_THOMPSON,          // Thompson sampling with a beta prior on payload success
+    LEARNING_Q,                 // Tabular Q-learning, moving between neighbouring arms
+    NUM_LEARNING_ALGORITHMS
+};
+static const char * learningAlgorithmNames[NUM_LEARNING_ALGORITHMS] = {
+    "none", "UCB1", "Thompson", "Q-learning"};
+
+#define MAX_LEARNING_ARMS 256
+#define MAX_LEARNING_PAYLOAD_LENS 16
+
+// Configuration of a learning engine. Its arms are every combination of the
+// listed modulations, FECs and payload lengths. An empty list stands for the
+// CE's own setting when the engine is created.
+struct learningConfig {
+    int algorithm;                      // learningAlgorithmType
+    int numModSchemes;
+    unsigned char modSchemes[NUM_MOD_SCHEME_NAMES];     // Indices in modSchemeNames
+    int numInnerFECs;
+    unsigned char innerFECs[NUM_FEC_SCHEME_NAMES];      // Indices in fecSchemeNames
+    int numOuterFECs;
+    unsigned char outerFECs[NUM_FEC_SCHEME_NAMES];
+    int numPayloadLens;
+    unsigned int payloadLens[MAX_LEARNING_PAYLOAD_LENS];
+    float exploration;                  // UCB1 exploration weight
+    float epsilon;                      // Q-learning exploration probability
+    float rate;                         // Q-learning rate
+    float discount;                     // Q-learning discount factor
 };
 
 struct CognitiveEngine {
     // Modulation/coding parameters
-	char modScheme[30];
-    char crcScheme[30];
-    char innerFEC[30];
-    char outerFEC[30];
-    char outerFEC_prev[30];
-	unsigned int bitsPerSym;
+	unsigned int mcsIndex;          // Index in mcsTable
+    crc_scheme crcScheme;
+    unsigned int outerFEC_prev;     // Index in fecSchemeNames
 	unsigned int numSubcarriers;
     unsigned int CPLen;
     unsigned int taperLen;
@@ -118,11 +313,15 @@ struct CognitiveEngine {
   	// Cognitive parameters
     // TODO: For latestGoalValue, Use different type of variable depending on
     //  what its being compared to
-    char adaptationCondition[30];
-    char adaptation[30];
-    char goal[30];
+    // Resolved from the config file's names when it is read
+    enum ceConditionType adaptationCondition;
+    enum ceAdaptationType adaptation;
+    unsigned int adaptationModScheme;       // Target of CE_ADAPT_SET_MOD_SCHEME, index in modSchemeNames
+    unsigned int adaptationMCSIndex;        // Target of CE_ADAPT_SET_MCS_EFFICIENCY
+    enum ceGoalType goal;
+    enum feedbackAggregationType feedbackAggregation;   // When there are several receivers
 	int goal_averaging;	
-	float goal_mem[100];
+	windowed_stats<float, CE_STATS_INLINE_LEN> goal_stats;
 	float averagedGoalValue;
     float threshold;
 	float latestGoalValue;
@@ -130,6 +329,8 @@ struct CognitiveEngine {
     float weighted_avg_payload_valid_threshold;
     float PER_threshold;
     float BER_threshold;
+    float PER_variance_threshold;
+    float BER_quantile;             // Which quantile the BER_quantile conditions compare
     float FECswitch;
     unsigned int payloadLenIncrement;
     unsigned int payloadLenMax;
@@ -137,6 +338,7 @@ struct CognitiveEngine {
    	
 	// Control variables
 	float delay_us;
+    unsigned int framesInFlight;    // Frames sent before the feedback of the first is needed (USRP mode)
     double startTime;
     double runningTime;
     int iteration;
@@ -146,32 +348,224 @@ struct CognitiveEngine {
     float PER;
     float PER_avg;
 	int PER_averaging;
-	running_avg<float> *PER_RA_ptr;
+	windowed_stats<float, CE_STATS_INLINE_LEN> PER_stats;
 
 	float BER;
 	float BER_avg;
 	int BER_averaging;
-	running_avg<float> *BER_RA_ptr;
+	windowed_stats<float, CE_STATS_INLINE_LEN> BER_stats;
 
 	unsigned int validPayloads;
     float validPayloads_avg;
 	int validPayloads_averaging;
-	running_avg<float> *validPayloads_RA_ptr;
+	windowed_stats<float, CE_STATS_INLINE_LEN> validPayloads_stats;
 	
 	unsigned int errorFreePayloads;
 	float errorFreePayloads_avg;
 	int errorFreePayloads_averaging;
-	running_avg<float> *errorFreePayloads_RA_ptr;
+	windowed_stats<float, CE_STATS_INLINE_LEN> errorFreePayloads_stats;
 	
     unsigned int lastReceivedFrame;
+
+    // Shared object that makes the CE's adaptation decisions, if any.
+    // See crts_ce_plugin.h
+    char pluginPath[100];
+    char pluginArgs[100];
+    struct cePlugin * plugin_ptr;
+
+    // Learning engine that chooses the CE's parameters, if any
+    struct learningConfig learning;
+    struct learningEngine * learning_ptr;
+    float regret;                   // Reported by the learning engine
+
+    unsigned int frameLen;          // OFDM symbols in the last frame sent
+};
+
+// Options that can be given in a CE config file
+enum ceOptionType {
+    CE_OPTION_ADAPTATION = 0,
+    CE_OPTION_GOAL,
+    CE_OPTION_ADAPTATION_CONDITION,
+    CE_OPTION_MOD_SCHEME,
+    CE_OPTION_CRC_SCHEME,
+    CE_OPTION_INNER_FEC,
+    CE_OPTION_OUTER_FEC,
+    CE_OPTION_PAYLOAD_LEN,
+    CE_OPTION_PAYLOAD_LEN_INCREMENT,
+    CE_OPTION_PAYLOAD_LEN_MAX,
+    CE_OPTION_PAYLOAD_LEN_MIN,
+    CE_OPTION_NUM_SUBCARRIERS,
+    CE_OPTION_CP_LEN,
+    CE_OPTION_TAPER_LEN,
+    CE_OPTION_DELAY_US,
+    CE_OPTION_DEFAULT_TX_POWER,
+    CE_OPTION_LATEST_GOAL_VALUE,
+    CE_OPTION_THRESHOLD,
+    CE_OPTION_FREQUENCY_TX,
+    CE_OPTION_FREQUENCY_RX,
+    CE_OPTION_TXGAIN_DB,
+    CE_OPTION_BANDWIDTH,
+    CE_OPTION_UHD_TXGAIN_DB,
+    CE_OPTION_WEIGHTED_AVG_PAYLOAD_VALID_THRESHOLD,
+    CE_OPTION_PER_THRESHOLD,
+    CE_OPTION_BER_THRESHOLD,
+    CE_OPTION_PER_VARIANCE_THRESHOLD,
+    CE_OPTION_BER_QUANTILE,
+    CE_OPTION_GOAL_AVERAGING,
+    CE_OPTION_BER_AVERAGING,
+    CE_OPTION_PER_AVERAGING,
+    CE_OPTION_VALID_PAYLOADS_AVERAGING,
+    CE_OPTION_ERROR_FREE_PAYLOADS_AVERAGING,
+    CE_OPTION_PLUGIN,
+    CE_OPTION_PLUGIN_ARGS,
+    CE_OPTION_LEARNING,             // Any of the learning* options
+    CE_OPTION_FEEDBACK_AGGREGATION,
+    CE_OPTION_FRAMES_IN_FLIGHT
+};
+#define CE_OPTION(name) ((uint64_t) 1 << CE_OPTION_##name)
+
+// A parsed CE config file: the values of the options it sets, and which
+// options those are. Can be applied to a CE any number of times.
+struct ceConfigOptions {
+    uint64_t set;               // CE_OPTION() bits
+    struct CognitiveEngine values;
+    unsigned int mod;           // Index in modSchemeNames
+    unsigned int fec0;          // Index in fecSchemeNames
+    unsigned int fec1;          // Index in fecSchemeNames
+};
+
+// Kernels that can be used to add AWGN and carrier frequency offset.
+// Selected per scenario with the 'noiseKernel' option.
+enum awgnKernelType {
+    AWGN_KERNEL_LIQUID = 0,     // std::exp() and one Gaussian draw for every sample
+    AWGN_KERNEL_AUTO,           // Fastest kernel supported by this CPU
+    AWGN_KERNEL_SCALAR,         // Block noise generation and phasor recurrence
+    AWGN_KERNEL_SSE2,           // Same as scalar, 4 lanes at a time
+    AWGN_KERNEL_AVX2            // Same as scalar, 8 lanes at a time
+};
+
+// State of the fast AWGN kernels.
+// Keeps the carrier phase and the noise generator running across calls.
+// Only holds plain data so it can be copied along with its Scenario.
+struct awgnChannel {
+    int kernel;                 // awgnKernelType actually used
+    uint64_t rng0[4];           // xorshift128+ state, one stream per 64-bit lane
+    uint64_t rng1[4];
+    float phasor[2];            // Carrier phasor for the next sample (re, im)
+    float step[2];              // Per-sample rotation exp(j*dphi) (re, im)
+    float phi;                  // Carrier phase for the next sample of the liquid kernel
+};
+
+// State of the Rice-K fading channel.
+// Created once per scenario so that the fading process and carrier phase
+// are continuous from one call (OFDM symbol) to the next.
+struct ricianChannel {
+    firfilt_crcf fdoppler;      // Doppler filter, NULL when fading is disabled
+    unsigned int h_len;         // Doppler filter length
+    float s;                    // Amplitude of the line-of-sight component
+    float sig;                  // Standard deviation of the scattered component
+    float phasor[2];            // Carrier phasor for the next sample (re, im)
+    float step[2];              // Per-sample rotation exp(j*dphi) (re, im)
+    uint64_t rng0, rng1;        // xorshift128+ state of the scattered component
+};
+
+// Number of samples that go through every stage of an impairment chain
+// before moving on. Small enough for the block to stay in L1 cache.
+#define IMPAIRMENT_BLOCK_LEN 256
+
+// Limits of the tapped-delay-line multipath channel
+#define MAX_MULTIPATH_TAPS 32
+#define MULTIPATH_NUM_SINUSOIDS 8   // Sinusoids per Doppler process
+#define MULTIPATH_UPDATE_LEN IMPAIRMENT_BLOCK_LEN  // Samples between tap updates
+
+// Tapped-delay-line channel with an independent Rayleigh Doppler process per tap.
+// The taps are updated every MULTIPATH_UPDATE_LEN samples. Each block is
+// convolved directly over the non-zero taps, or with zero-latency overlap-save
+// FFT convolution when the delay spread is long and that takes fewer operations.
+// The sample-rate dependent parts are built on first use.
+struct multipathChannel {
+    // Power-delay profile
+    int num_taps;
+    float tap_delay_ns[MAX_MULTIPATH_TAPS];
+    float tap_power_dB[MAX_MULTIPATH_TAPS];
+    float fd;                       // Maximum Doppler frequency (relative to sample rate)
+    unsigned int fft_threshold;     // Consider FFT convolution above this delay spread [samples]
+
+    // Sum-of-sinusoids Doppler process of each tap (Zheng & Xiao)
+    float sos_freq_i[MAX_MULTIPATH_TAPS][MULTIPATH_NUM_SINUSOIDS];
+    float sos_freq_q[MAX_MULTIPATH_TAPS][MULTIPATH_NUM_SINUSOIDS];
+    float sos_phase_i[MAX_MULTIPATH_TAPS][MULTIPATH_NUM_SINUSOIDS];
+    float sos_phase_q[MAX_MULTIPATH_TAPS][MULTIPATH_NUM_SINUSOIDS];
+    double t;                       // Time of the next sample [samples]
+    unsigned int update_left;       // Samples until the taps are next updated
+
+    // Built for sample rate fs
+    float fs;
+    unsigned int tap_delay[MAX_MULTIPATH_TAPS]; // [samples]
+    float tap_gain[MAX_MULTIPATH_TAPS];         // Amplitude, normalized to unit total power
+    unsigned int h_len;                         // Delay spread + 1 [samples]
+    unsigned int direct_taps;                   // Non-zero entries of h
+    std::complex<float> * h;                    // Impulse response of the current taps
+    std::complex<float> * history;              // Last h_len-1 input samples
+    std::complex<float> * work;                 // History followed by the current block (direct form)
+    unsigned int nfft;                          // FFT length (0: direct form only)
+    int H_valid;                                // fft_H is the transform of the current h
+    std::complex<float> * fft_x;                // Overlap-save buffers
+    std::complex<float> * fft_X;
+    std::complex<float> * fft_h;
+    std::complex<float> * fft_H;
+    std::complex<float> * fft_y;
+    fftplan plan_x;
+    fftplan plan_h;
+    fftplan plan_y;
+};
+
+// Maximum number of simultaneous CW interferer tones
+#define MAX_CW_TONES 16
+
+// Numerically controlled oscillator for one CW interferer tone.
+// The phase carries over from one buffer to the next.
+struct cwTone {
+    float pow;                  // Power relative to the desired carrier [dB]
+    float freq;                 // Baseband frequency [Hz]
+    float amp;                  // Amplitude derived from pow
+    float fs;                   // Sample rate that step was computed for
+    float phasor[2];            // Oscillator phasor for the next sample (re, im)
+    float step[2];              // Per-sample rotation exp(j*2*pi*freq/fs) (re, im)
+};
+
+// Impairments that a scenario can apply to the baseband samples.
+// Listed in the default order of application.
+enum impairmentType {
+    IMPAIRMENT_MULTIPATH = 0,   // Frequency-selective fading (enactMultipathBaseband())
+    IMPAIRMENT_FADING,          // Rice-K fading (enactRicianFadingBaseband())
+    IMPAIRMENT_CW,              // CW interferer (enactCWInterfererBaseband())
+    IMPAIRMENT_AWGN,            // AWGN and carrier offset (enactAWGNBaseband())
+    NUM_IMPAIRMENTS
+};
+
+// Names of the impairments in the 'impairmentOrder' option, indexed by impairmentType
+static const char * impairmentNames[] = {"multipath", "fading", "cw", "awgn"};
+
+// Enabled impairments of one direction (Tx or Rx), in the order they are applied.
+// Built once when the scenario is loaded.
+struct impairmentChain {
+    int num_stages;
+    int stage[NUM_IMPAIRMENTS];
 };
 
 struct Scenario {
+    int addMultipathBasebandTx; // Does the Scenario have frequency-selective fading?
+    int addMultipathBasebandRx; // Does the Scenario have frequency-selective fading?
+    struct multipathChannel multipath;
+
     int addAWGNBasebandTx; //Does the Scenario have noise?
     int addAWGNBasebandRx; //Does the Scenario have noise?
     float noiseSNR;
     float noiseDPhi;
-    
+    int noiseKernel;                // Requested awgnKernelType
+    struct awgnChannel awgn;        // State of the fast AWGN kernels
+
     int addInterference; // Does the Scenario have interference?
     
     int addRicianFadingBasebandTx; // Does the Secenario have fading?
@@ -179,11 +573,26 @@ struct Scenario {
     float fadeK;
     float fadeFd;
     float fadeDPhi;
+    int fadeFilterLen;              // Doppler filter length (0: derive from fadeFd)
+    struct ricianChannel fading;    // State of the fading channel
 
 	int addCWInterfererBasebandTx; // Does the Scenario have a CW interferer?
 	int addCWInterfererBasebandRx; // Does the Scenario have a CW interferer?
 	float cw_pow;
 	float cw_freq;
+	int num_cw_tones;                       // Number of tones in cw_tones (0: single tone from cw_pow/cw_freq)
+	struct cwTone cw_tones[MAX_CW_TONES];   // Oscillators of the CW interferer
+
+    int impairmentOrder[NUM_IMPAIRMENTS];   // Order in which the impairments are applied
+    struct impairmentChain txChain;         // Impairments applied by enactScenarioBasebandTx()
+    struct impairmentChain rxChain;         // Impairments applied by enactScenarioBasebandRx()
+};
+
+// Positions of the bit errors in the decoded payloads, summed over the frames of a run
+struct errorHistogram {
+    unsigned int num_frames;
+    unsigned int num_bytes;                             // Longest payload seen [bytes]
+    unsigned int byte_errors[PN_MAX_PAYLOAD_LEN];       // Bit errors at each byte position
 };
 
 struct rxCBstruct {
@@ -191,7 +600,6 @@ struct rxCBstruct {
     int verbose;
     float bandwidth;
     char * serverAddr;
-	msequence * rx_ms_ptr;
     int frameNum;
 	int client;
 	int isController;
@@ -200,6 +608,11 @@ struct rxCBstruct {
 	struct CognitiveEngine * ce_ptr;
 	struct Scenario * sc_ptr;
 	struct feedbackStruct *fb_ptr;
+	struct otaFeedbackTable *ota_ptr;   // Feedback heard over the air is kept here by frame if not NULL
+	struct errorHistogram *hist_ptr;    // Error positions are added here if not NULL
+#ifdef CRTS_PROFILE
+	struct stageProfile *profile_ptr;   // rxCallback() latency is recorded here if not NULL
+#endif
 };
 
 struct feedbackStruct {
@@ -213,23 +626,240 @@ struct feedbackStruct {
     float           rssi;
     float           cfo;
 	int 			block_flag;
+    unsigned int    updates;        // Counts feedback arrivals so waits cannot miss one. Guarded by fb_mutex.
     pthread_mutex_t fb_mutex;
     pthread_cond_t fb_cond;
 };
 
-struct serverThreadStruct {
-    unsigned int serverPort;
-	int OTA;
-	int usingUSRPs;
+// Feedback the controller heard over the air, kept by frame number until
+// it is sorted out to the frames in flight, so that feedback on several
+// frames may arrive between two looks. Frame n is kept in
+// fb[n % MAX_FRAMES_IN_FLIGHT]. Guarded by the fb_mutex of the
+// feedbackStruct whose condition signals its arrival.
+struct otaFeedbackTable {
+    int received[MAX_FRAMES_IN_FLIGHT];
+    struct feedbackStruct fb[MAX_FRAMES_IN_FLIGHT];
+};
+
+// Messages exchanged by the controller and the receivers, over TCP and in the
+// payload of the feedback frames sent over the air. Structs are never sent as
+// they are in memory. Every message is a header followed by a body:
+//   byte 0     CRTS_WIRE_MAGIC
+//   byte 1     CRTS_WIRE_VERSION
+//   byte 2     Message type (wireMessageType)
+//   bytes 3-4  Length of the body in bytes
+// Integers are little-endian and floats are IEEE 754 single precision,
+// sent as little-endian 32 bit integers.
+#define CRTS_WIRE_MAGIC 0xC7
+#define CRTS_WIRE_VERSION 1
+#define WIRE_HEADER_LEN 5
+#define WIRE_MAX_BODY_LEN 1024
+
+enum wireMessageType {
+    WIRE_MSG_FEEDBACK = 1,      // feedbackStruct, from a receiver
+    WIRE_MSG_CE_CONFIG,         // Transmit parameters of the CE under test, from the controller
+    WIRE_MSG_SCENARIO_CONFIG    // Scenario under test, from the controller
+};
+
+// Length of a feedback message body: flags, payload_len, payloadByteErrors,
+// payloadBitErrors, iteration, evm, rssi and cfo
+#define WIRE_FEEDBACK_LEN (1 + 3*2 + 4 + 3*4)
+
+struct wireHeader {
+    unsigned int type;
+    unsigned int length;
+};
+
+// Cursors over a message being written or read. Running past the end sets
+// 'error' instead of touching memory outside the buffer.
+struct wireWriter {
+    unsigned char * p;
+    unsigned char * end;
+    int error;
+};
+
+struct wireReader {
+    const unsigned char * p;
+    const unsigned char * end;
+    int error;
+};
+
+// CE plugins are handed the feedback struct itself as a crts_ce_feedback
+typedef char feedbackLayoutMatchesPlugin[
+    (offsetof(struct feedbackStruct, header_valid) == offsetof(struct crts_ce_feedback, header_valid) &&
+     offsetof(struct feedbackStruct, iteration) == offsetof(struct crts_ce_feedback, iteration) &&
+     offsetof(struct feedbackStruct, cfo) == offsetof(struct crts_ce_feedback, cfo)) ? 1 : -1];
+
+// A loaded CE plugin and the state of one CE using it
+struct cePlugin {
+    void * handle;
+    const struct crts_ce_plugin * desc;
+    void * state;
+};
+
+// Limits of the controller's TCP server
+#define MAX_RECEIVER_NODES 64
+#define NODE_FEEDBACK_QUEUE_LEN 64      // Oldest feedback is dropped when a queue is full
+#define NODE_SEND_BUFFER_LEN (8*(WIRE_HEADER_LEN + WIRE_MAX_BODY_LEN))  // Messages not yet sent to a node
+#define TCP_SERVER_MAX_EVENTS 32
+
+// A receiver connected to the controller
+struct receiverNode {
+    int fd;                             // -1 when the slot is free
+    struct sockaddr_in addr;
+    unsigned char rxbuf[WIRE_HEADER_LEN + WIRE_MAX_BODY_LEN];  // Start of a partly received message
+    unsigned int rxlen;
+    unsigned char txbuf[NODE_SEND_BUFFER_LEN];                  // Messages the socket did not take yet
+    unsigned int txlen;
+    int overflowed;                     // txbuf could not take a message. Shut down for the server thread to close.
+    struct feedbackStruct queue[NODE_FEEDBACK_QUEUE_LEN];       // Feedback not yet taken by the controller
+    unsigned int head;
+    unsigned int count;
+    unsigned int dropped;               // Feedback lost because the queue was full
+};
+
+// Feedback of every receiver on one frame
+struct receiverFeedback {
+    int num_nodes;                              // Receivers connected
+    int reports;                                // Receivers that reported on the frame
+    int connected[MAX_RECEIVER_NODES];
+    int received[MAX_RECEIVER_NODES];           // fb[] is valid
+    struct feedbackStruct fb[MAX_RECEIVER_NODES];
+};
+
+// The controller's TCP server. A single thread waits on all receiver
+// connections with epoll and parses the feedback they send into a queue
+// per node. Messages to the nodes are written as far as the sockets take
+// them and the rest is left in a buffer per node, which the same thread
+// writes out when the socket can take more. The mutex guards the nodes,
+// and only the server thread closes them. fb_ptr's condition is signalled
+// whenever feedback arrives, so the controller can wait for feedback from
+// the air and from the TCP links at once.
+struct tcpServer {
+    int listenFD;
+    int epollFD;
+    int wakeFD;                         // eventfd that stops the server thread
+    pthread_t thread;
+    pthread_mutex_t mutex;
     struct feedbackStruct * fb_ptr;
-    int * client_ptr;
+    int verbose;
+    int num_nodes;
+    struct receiverNode nodes[MAX_RECEIVER_NODES];
 };
 
-struct serveClientStruct {
-	int client;
-	int OTA;
-	int usingUSRPs;
-	struct feedbackStruct * fb_ptr;
+// How long the controller waits for feedback on a frame after sending it
+#define FEEDBACK_TIMEOUT_NS 20000000
+
+// The arm a learning engine chose for a frame, and the Q-learning state
+// and action that led to it. -1 for what was not chosen.
+struct learningChoice {
+    int arm;
+    int state;
+    int action;
+};
+
+// What a frame was sent with. Its feedback is judged against these rather
+// than the CE's current parameters, which may have changed since.
+struct txFrameParams {
+    unsigned int mcsIndex;
+    unsigned int payloadLen;
+    unsigned int frameLen;              // OFDM symbols
+    struct learningChoice learning;     // Of the CE's learning engine, if it has one
+};
+
+// A frame sent by the controller whose feedback is still awaited
+struct inFlightFrame {
+    unsigned int frameNumber;
+    int target;                         // Receiver it was sent to with per_node aggregation, else -1
+    struct CognitiveEngine * ce;        // CE that chose its parameters
+    struct txFrameParams sent;
+    float throughput;                   // Of the parameters it was sent with
+    struct timespec deadline;           // CLOCK_MONOTONIC time after which missing feedback counts as lost
+    int otaReceived;                    // ota holds feedback heard over the air
+    struct feedbackStruct ota;
+    struct receiverFeedback rf;         // What the receivers reported over TCP so far
+};
+
+// Time as the CEs see it. USRP runs use the monotonic wall clock.
+// Simulations use virtual time, the air time of the samples sent so far,
+// so they run as fast as the CPU allows.
+enum crtsClockType {
+    CRTS_CLOCK_WALL,
+    CRTS_CLOCK_VIRTUAL
+};
+
+struct crtsClock {
+    enum crtsClockType type;
+    struct timespec start;              // CLOCK_MONOTONIC when a wall clock was started
+    double sampleRate;                  // Of a virtual clock [samples/s]
+    unsigned long long samples;         // Sent since a virtual clock was started
+};
+
+// Frames closer to their deadline than this are released by spinning on the
+// clock, since a sleep can overshoot by the timer slack of some tens of
+// microseconds
+#define PACER_SPIN_NS 100000
+
+// Releases frames on a fixed grid of CLOCK_MONOTONIC deadlines,
+// start + n*interval, so that errors in one wait do not add up.
+// Records how late each frame was released.
+struct framePacer {
+    struct timespec next;               // Deadline of the next frame
+    long long interval_ns;
+    unsigned int frames;
+    unsigned int overruns;              // Frames released more than an interval late
+    double sum_ns;                      // Of the lateness
+    double sumsq_ns;
+    long long max_ns;
+};
+
+// The frames in flight are the 'count' frames starting at frame number
+// 'oldest'. Frame n is kept in frames[n % MAX_FRAMES_IN_FLIGHT].
+struct inFlightTable {
+    unsigned int oldest;
+    unsigned int count;
+    struct inFlightFrame frames[MAX_FRAMES_IN_FLIGHT];
+};
+
+// Number of frame generators kept alive by a frameGeneratorPool
+#define FG_POOL_SIZE 8
+
+// A frame generator and the parameters it was configured with
+struct frameGeneratorEntry {
+    ofdmflexframegen fg;
+    unsigned int numSubcarriers;
+    unsigned int CPLen;
+    unsigned int taperLen;
+    ofdmflexframegenprops_s props;
+    unsigned long lastUsed;
+};
+
+// Frame generators reused across frames instead of being created for each one
+struct frameGeneratorPool {
+    int num_entries;
+    unsigned long uses;
+    struct frameGeneratorEntry entries[FG_POOL_SIZE];
+};
+
+// Number of frame synchronizers kept alive by a frameSynchronizerBank
+#define FS_BANK_SIZE 16
+
+// A frame synchronizer and the OFDM geometry it was built for.
+// All synchronizers share the default subcarrier allocation and rxCallback().
+struct frameSynchronizerEntry {
+    ofdmflexframesync fs;
+    unsigned int numSubcarriers;
+    unsigned int CPLen;
+    unsigned int taperLen;
+    void * userdata;
+    unsigned long lastUsed;
+};
+
+// Frame synchronizers reused across CEs and scenarios instead of being created for each one
+struct frameSynchronizerBank {
+    int num_entries;
+    unsigned long uses;
+    struct frameSynchronizerEntry entries[FS_BANK_SIZE];
 };
 
 struct enactScenarioBasebandRxStruct {
@@ -238,6 +868,139 @@ struct enactScenarioBasebandRxStruct {
     struct Scenario * sc_ptr;
 };
 
+// Columns written to the data file for every frame
+struct dataFileColumns {
+    bool frame_info;
+    bool validity_metrics;
+    bool error_metrics;
+    bool signal_quality_metrics;
+    bool spectral_metrics;
+    bool goal_metrics;
+    bool learning_metrics;
+    bool receiver_metrics;      // Receivers that reported, and the frame's target receiver (USRP controller)
+    bool error_histograms;      // Bit errors by payload position after each scenario
+};
+
+// Records in the ring of a crtsLog. Must be a power of 2.
+#define CRTS_LOG_RING_LEN 8192
+// The log writer waits until it has this many records to write,
+// or until its last write is this long ago [ms]
+#define CRTS_LOG_BATCH 512
+#define CRTS_LOG_MAX_DELAY_MS 100
+
+// A binary experiment log (crts_log.h). Any thread can add records without
+// taking a lock. A writer thread moves them to the file in large sequential
+// writes. Slot i of the ring holds the record at position p when
+// seq[i] == p+1, and is free for position p when seq[i] == p.
+// The writer sleeps on a condition until a batch is ready or its time is
+// up. The mutex is only taken to wake it, which producers do once a batch
+// is ready or the ring is full while it sleeps.
+struct crtsLog {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;                // On CLOCK_MONOTONIC
+    int sleeping;                       // The writer is waiting on cond, or about to
+    unsigned int enqueue_pos;           // Next position to fill, claimed with compare-and-swap
+    unsigned int dequeue_pos;           // Next position to write out. Only the writer changes it.
+    int stop;
+    unsigned int stalls;                // Times a record had to wait for room in the ring
+    int write_errno;                    // Of the first failed write, or 0
+    unsigned int * seq;
+    struct crts_log_record * records;
+};
+
+// Where the data of one CE/scenario cell goes
+struct dataCell {
+    FILE * file;                        // Text table
+    struct crtsLog * log;               // Binary records instead, if not NULL
+    struct dataFileColumns * columns;
+    int i_CE;
+    int i_Sc;
+    int repetition;
+    int num_repetitions;
+};
+
+// Metrics summed over the frames of one CE/scenario run
+struct cellSummary {
+    int total_frames;
+    int valid_headers;
+    int valid_payloads;
+    int total_bits;
+    int bit_errors;
+    float EVM;
+    float RSSI;
+    float PER;
+};
+
+// Objects needed to simulate frames in software. Each worker thread of a
+// parallel run has its own.
+struct simulationState {
+    struct frameGeneratorPool fgPool;
+    struct frameSynchronizerBank fsBank;
+    ofdmflexframesync fs;
+    struct feedbackStruct fb;
+    struct rxCBstruct rxCBs;
+    struct errorHistogram * hist;
+#ifdef CRTS_PROFILE
+    struct stageProfile profile;                // Stage latencies of the current cell
+#endif
+    unsigned char header[8];                    // Must always be 8 bytes for ofdmflexframe
+    unsigned char payload[PN_MAX_PAYLOAD_LEN];
+    std::complex<float> frameSamples[10000];
+};
+
+// One repetition of one CE/scenario cell in a parallel run
+struct simulationTask {
+    int i_CE;
+    int i_Sc;
+    int repetition;
+    unsigned int seed;              // Seed of the worker's PRNG while running the task
+    struct cellSummary cell;
+    char * data;                    // Data file text of the task
+    size_t data_len;
+#ifdef CRTS_PROFILE
+    struct stageProfile * profile;  // Stage latencies of the task
+#endif
+};
+
+// Tasks owned by one worker. The owner takes from the tail and
+// idle workers steal from the head.
+struct taskQueue {
+    pthread_mutex_t mutex;
+    int head;
+    int tail;
+    int * tasks;
+};
+
+struct simulationPool {
+    int num_workers;
+    int num_repetitions;
+    struct taskQueue * queues;
+    struct simulationTask * tasks;
+    struct CognitiveEngine * ce_list;
+    struct Scenario * sc_list;
+    struct dataFileColumns columns;
+    struct crtsLog * log;           // Binary log, or NULL to write text
+};
+
+struct simulationWorker {
+    struct simulationPool * pool;
+    int id;
+};
+
+// Totals of one receiver over a CE/scenario run with USRPs
+struct nodeSummary {
+	int frames;                 // Frames sent while it was connected (to it, with per_node aggregation)
+	int reports;                // Frames it reported on in time
+	int valid_headers;
+	int valid_payloads;
+	int total_bits;
+	int bit_errors;
+	float EVM;                  // Sums over its reports
+	float RSSI;
+};
+
 struct scenarioSummaryInfo{
 	int total_frames[60][60];
 	int valid_headers[60][60];
@@ -247,6 +1010,7 @@ struct scenarioSummaryInfo{
 	float EVM[60][60];
 	float RSSI[60][60];
 	float PER[60][60];
+	struct nodeSummary nodes[MAX_RECEIVER_NODES];   // Of the run in progress. Cleared when it starts.
 };
 
 struct cognitiveEngineSummaryInfo{
@@ -265,12 +1029,10 @@ struct CognitiveEngine CreateCognitiveEngine() {
     struct CognitiveEngine ce = {};
 
 	// Modulation/coding parameters
-    strcpy(ce.modScheme, "QPSK");
-    strcpy(ce.crcScheme, "none");
-    strcpy(ce.innerFEC, "none");
-    strcpy(ce.outerFEC, "Hamming74");
-    strcpy(ce.outerFEC_prev, "Hamming74");
-	ce.bitsPerSym = 1;
+    // QPSK, no inner FEC, Hamming(7,4) outer FEC
+    ce.mcsIndex = mcsIndexTable[1][0][1];
+    ce.crcScheme = LIQUID_CRC_NONE;
+    ce.outerFEC_prev = 1;
 	ce.numSubcarriers = 64;
     ce.CPLen = 16;         
     ce.taperLen = 4;       
@@ -283,9 +1045,11 @@ struct CognitiveEngine CreateCognitiveEngine() {
 	ce.bandwidth = 1.0e6;
     
 	// Cognitive parameters
-	strcpy(ce.adaptationCondition, "packet_error_rate"); 
-    strcpy(ce.adaptation, "mod_scheme->BPSK");
-    strcpy(ce.goal, "payload_valid");
+	ce.adaptationCondition = CE_CONDITION_NONE;
+    ce.adaptation = CE_ADAPT_SET_MOD_SCHEME;
+    ce.adaptationModScheme = 0;
+    ce.adaptationMCSIndex = 0;
+    ce.goal = CE_GOAL_PAYLOAD_VALID;
     ce.goal_averaging = 1;
 	ce.averagedGoalValue = 0;
 	ce.threshold = 1.0;        
@@ -293,6 +1057,8 @@ struct CognitiveEngine CreateCognitiveEngine() {
     ce.weightedAvg = 0.0;
     ce.PER_threshold = 0.5;
     ce.BER_threshold = 0.5;
+    ce.PER_variance_threshold = 0.01;
+    ce.BER_quantile = 0.9;
     ce.FECswitch = 1;
 	ce.payloadLenIncrement = 2;
     ce.payloadLenMax = 500;
@@ -301,6 +1067,7 @@ struct CognitiveEngine CreateCognitiveEngine() {
     
 	// Control variables
 	ce.delay_us = 1000000.0;
+    ce.framesInFlight = 1;
     ce.startTime = 0.0;
     ce.runningTime = 0.0; 
     ce.iteration = 1;          
@@ -320,8 +1087,15 @@ struct CognitiveEngine CreateCognitiveEngine() {
 	ce.validPayloads_averaging = 1;
 	
 	ce.errorFreePayloads = 0;
-	ce.errorFreePayloads = 0;
+	ce.errorFreePayloads_avg = 0;
 	ce.errorFreePayloads_averaging = 1;
+
+    // Only the mean of the goal is used, whatever its range
+    ce.goal_stats.init(ce.goal_averaging, 0.0f, 1.0f);
+    ce.PER_stats.init(ce.PER_averaging, 0.0f, 1.0f);
+    ce.BER_stats.init(ce.BER_averaging, 0.0f, CE_BER_STATS_MAX);
+    ce.validPayloads_stats.init(ce.validPayloads_averaging, 0.0f, 1.0f);
+    ce.errorFreePayloads_stats.init(ce.errorFreePayloads_averaging, 0.0f, 1.0f);
     
 	//memset(ce.metric_mem,0,100*sizeof(float));
 	 
@@ -333,10 +1107,17 @@ struct CognitiveEngine CreateCognitiveEngine() {
 // Default parameter for Scenario
 struct Scenario CreateScenario() {
     struct Scenario sc = {};
+    sc.addMultipathBasebandTx = 0;
+    sc.addMultipathBasebandRx = 0;
+    sc.multipath.num_taps = 0;
+    sc.multipath.fd = 0.001f;
+    sc.multipath.fft_threshold = 32;
+
     sc.addAWGNBasebandTx = 0,
     sc.addAWGNBasebandRx = 0,
     sc.noiseSNR = 7.0f, // in dB
     sc.noiseDPhi = 0.001f,
+    sc.noiseKernel = AWGN_KERNEL_LIQUID,
 
     sc.addInterference = 0,
 
@@ -345,11 +1126,17 @@ struct Scenario CreateScenario() {
     sc.fadeK = 30.0f,
     sc.fadeFd = 0.2f,
     sc.fadeDPhi = 0.001f;
+    sc.fadeFilterLen = 0;
 
 	sc.addCWInterfererBasebandTx = 0;
 	sc.addCWInterfererBasebandRx = 0;
 	sc.cw_pow = 0;
 	sc.cw_freq = 0;
+	sc.num_cw_tones = 0;
+
+    // Multipath, fading, then interference, then noise
+    for (int i=0; i<NUM_IMPAIRMENTS; i++)
+        sc.impairmentOrder[i] = i;
 
     return sc;
 } // End CreateScenario()
@@ -364,21 +1151,19 @@ struct rxCBstruct CreaterxCBStruct() {
     return rxCB;
 } // End CreaterxCBStruct()
 
-// Defaults for struct that is sent to server thread
-struct serverThreadStruct CreateServerStruct() {
-    struct serverThreadStruct ss = {};
-    ss.serverPort = 1402;
-    ss.fb_ptr = NULL;
-    return ss;
-} // End CreateServerStruct()
-
-//Defaults for struct that is sent to client threads
-struct serveClientStruct CreateServeClientStruct() {
-	struct serveClientStruct sc = {};
-	sc.client = 0;
-	sc.fb_ptr = NULL;
-	return sc;
-}; // End CreateServeClientStruct
+// Copy the values of a feedback struct, leaving its mutex and condition alone
+void feedbackStruct_copy(struct feedbackStruct * dst, const struct feedbackStruct * src)
+{
+    dst->header_valid = src->header_valid;
+    dst->payload_valid = src->payload_valid;
+    dst->payload_len = src->payload_len;
+    dst->payloadByteErrors = src->payloadByteErrors;
+    dst->payloadBitErrors = src->payloadBitErrors;
+    dst->iteration = src->iteration;
+    dst->evm = src->evm;
+    dst->rssi = src->rssi;
+    dst->cfo = src->cfo;
+} // End feedbackStruct_copy()
 
 void feedbackStruct_print(feedbackStruct * fb_ptr)
 {
@@ -448,6 +1233,257 @@ int readScMasterFile(char scenario_list[30][60], int verbose )
     return no_of_scenarios;
 } // End readScMasterFile()
 
+// Creating and destroying liquid objects may plan FFTs, which is not
+// thread safe when liquid is built on FFTW. Parallel runs serialize it.
+pthread_mutex_t liquidCreateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Worker threads of a parallel run draw the channels' random parameters from
+// their own seeded generator so that a task does not depend on scheduling.
+static __thread int crtsRandSeeded = 0;
+static __thread unsigned int crtsRandState;
+
+void crtsSeedThreadRand(unsigned int seed)
+{
+    crtsRandState = seed;
+    crtsRandSeeded = 1;
+} // End crtsSeedThreadRand()
+
+int crtsRand()
+{
+    if (crtsRandSeeded)
+        return rand_r(&crtsRandState);
+    return rand();
+} // End crtsRand()
+
+// Index of a name in a table of names, or -1
+int lookupName(const char * const * names, int n, const char * name)
+{
+    for (int i=0; i<n; i++)
+        if (strcmp(names[i], name) == 0)
+            return i;
+    return -1;
+} // End lookupName()
+
+// Entry of a scheme table with the given name, or NULL
+const struct schemeName * lookupSchemeName(const struct schemeName * table, unsigned int n, const char * name)
+{
+    for (unsigned int i=0; i<n; i++)
+        if (strcmp(table[i].name, name) == 0)
+            return &table[i];
+    return NULL;
+} // End lookupSchemeName()
+
+// Entry of a scheme table with the given liquid scheme, or NULL
+const struct schemeName * lookupScheme(const struct schemeName * table, unsigned int n, int scheme)
+{
+    for (unsigned int i=0; i<n; i++)
+        if (table[i].scheme == scheme)
+            return &table[i];
+    return NULL;
+} // End lookupScheme()
+
+const char * modSchemeName(int ms)
+{
+    const struct schemeName * s = lookupScheme(modSchemeNames, NUM_MOD_SCHEME_NAMES, ms);
+    return s ? s->name : "unknown";
+} // End modSchemeName()
+
+const char * fecSchemeName(int fec)
+{
+    const struct schemeName * s = lookupScheme(fecSchemeNames, NUM_FEC_SCHEME_NAMES, fec);
+    return s ? s->name : "unknown";
+} // End fecSchemeName()
+
+// Resolve a name from a CE config file, so that unknown names are caught
+// while the file is read rather than while the CE is running.
+// Reports unknown names and returns -1.
+int parseCEName(const char * const * names, int n, const char * name, const char * option, const char * file)
+{
+    int i = lookupName(names, n, name);
+    if (i < 0)
+        fprintf(stderr, "ERROR: Unknown %s \"%s\" in %s\n", option, name, file);
+    return i;
+} // End parseCEName()
+
+// Reports unknown names and returns NULL
+const struct schemeName * parseSchemeName(const struct schemeName * table, unsigned int n, const char * name,
+    const char * option, const char * file)
+{
+    const struct schemeName * s = lookupSchemeName(table, n, name);
+    if (s == NULL)
+        fprintf(stderr, "ERROR: Unknown %s \"%s\" in %s\n", option, name, file);
+    return s;
+} // End parseSchemeName()
+
+// Steps that the stepwise modulation adaptations move along
+static const int pskLadder[] = {LIQUID_MODEM_BPSK, LIQUID_MODEM_QPSK, LIQUID_MODEM_PSK8, LIQUID_MODEM_PSK16,
+    LIQUID_MODEM_PSK32, LIQUID_MODEM_PSK64, LIQUID_MODEM_PSK128};
+static const int askLadder[] = {LIQUID_MODEM_ASK2, LIQUID_MODEM_ASK4, LIQUID_MODEM_ASK8, LIQUID_MODEM_ASK16,
+    LIQUID_MODEM_ASK32, LIQUID_MODEM_ASK64, LIQUID_MODEM_ASK128};
+
+// Index in modSchemeNames of the next lower PSK/ASK modulation, or of the
+// modulation itself when it is the lowest or not PSK/ASK. Built by initMCSTable().
+unsigned char pskDown[NUM_MOD_SCHEME_NAMES];
+unsigned char askDown[NUM_MOD_SCHEME_NAMES];
+
+// Move value step places along a ladder. Values not on the ladder, or
+// steps past either end, leave it unchanged.
+int stepLadder(const int * ladder, int n, int value, int step)
+{
+    for (int i=0; i<n; i++)
+    {
+        if (ladder[i] == value)
+            return (i+step >= 0 && i+step < n) ? ladder[i+step] : value;
+    }
+    return value;
+} // End stepLadder()
+
+int compareMCS(const void * a, const void * b)
+{
+    const struct mcsEntry * x = (const struct mcsEntry *) a;
+    const struct mcsEntry * y = (const struct mcsEntry *) b;
+    if (x->efficiency != y->efficiency)
+        return x->efficiency < y->efficiency ? -1 : 1;
+    // Prefer the lower order modulation with the weaker code
+    if (x->bitsPerSymbol != y->bitsPerSymbol)
+        return x->bitsPerSymbol < y->bitsPerSymbol ? -1 : 1;
+    if (x->mod != y->mod)
+        return x->mod < y->mod ? -1 : 1;
+    if (x->fec0 != y->fec0)
+        return x->fec0 < y->fec0 ? -1 : 1;
+    return x->fec1 < y->fec1 ? -1 : (x->fec1 > y->fec1);
+} // End compareMCS()
+
+// Build mcsTable and the tables used to move around it.
+// Must be called before any CE is created.
+void initMCSTable()
+{
+    unsigned int n = 0;
+    for (unsigned int m=0; m<NUM_MOD_SCHEME_NAMES; m++)
+    {
+        for (unsigned int f0=0; f0<NUM_FEC_SCHEME_NAMES; f0++)
+        {
+            for (unsigned int f1=0; f1<NUM_FEC_SCHEME_NAMES; f1++)
+            {
+                struct mcsEntry * e = &mcsTable[n++];
+                e->mod = m;
+                e->fec0 = f0;
+                e->fec1 = f1;
+                e->bitsPerSymbol = modSchemeNames[m].bps;
+                e->rate = fec_get_rate((fec_scheme) fecSchemeNames[f0].scheme) *
+                    fec_get_rate((fec_scheme) fecSchemeNames[f1].scheme);
+                e->efficiency = e->bitsPerSymbol*e->rate;
+            }
+        }
+    }
+    qsort(mcsTable, NUM_MCS, sizeof(struct mcsEntry), compareMCS);
+    for (unsigned int i=0; i<NUM_MCS; i++)
+        mcsIndexTable[mcsTable[i].mod][mcsTable[i].fec0][mcsTable[i].fec1] = i;
+
+    unsigned int none = lookupScheme(fecSchemeNames, NUM_FEC_SCHEME_NAMES, LIQUID_FEC_NONE) - fecSchemeNames;
+    for (unsigned int i=0; i<NUM_MCS_LADDER; i++)
+    {
+        unsigned int mod = lookupScheme(modSchemeNames, NUM_MOD_SCHEME_NAMES, mcsLadderRungs[i].mod) - modSchemeNames;
+        unsigned int fec0 = lookupScheme(fecSchemeNames, NUM_FEC_SCHEME_NAMES, mcsLadderRungs[i].fec0) - fecSchemeNames;
+        mcsLadder[i] = mcsIndexTable[mod][fec0][none];
+    }
+
+    for (unsigned int m=0; m<NUM_MOD_SCHEME_NAMES; m++)
+    {
+        int psk = stepLadder(pskLadder, sizeof(pskLadder)/sizeof(pskLadder[0]), modSchemeNames[m].scheme, -1);
+        int ask = stepLadder(askLadder, sizeof(askLadder)/sizeof(askLadder[0]), modSchemeNames[m].scheme, -1);
+        pskDown[m] = lookupScheme(modSchemeNames, NUM_MOD_SCHEME_NAMES, psk) - modSchemeNames;
+        askDown[m] = lookupScheme(modSchemeNames, NUM_MOD_SCHEME_NAMES, ask) - modSchemeNames;
+    }
+} // End initMCSTable()
+
+// Number of ladder rungs whose efficiency does not exceed the target
+unsigned int mcsLadderCount(float efficiency)
+{
+    unsigned int lo = 0, hi = NUM_MCS_LADDER;
+    while (lo < hi)
+    {
+        unsigned int mid = (lo+hi)/2;
+        if (mcsTable[mcsLadder[mid]].efficiency <= efficiency + 1e-4f)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+} // End mcsLadderCount()
+
+// Index in mcsTable of the most efficient ladder scheme whose efficiency does
+// not exceed the target, or of the least efficient one if none qualifies
+unsigned int mcsIndexForEfficiency(float efficiency)
+{
+    unsigned int n = mcsLadderCount(efficiency);
+    return mcsLadder[n > 0 ? n-1 : 0];
+} // End mcsIndexForEfficiency()
+
+// Rung of the ladder a scheme is on, or the closest rung below it if it is
+// not on the ladder (0 if there is none)
+unsigned int mcsLadderRung(unsigned int mcsIndex)
+{
+    unsigned int n = mcsLadderCount(mcsTable[mcsIndex].efficiency);
+    return n > 0 ? n-1 : 0;
+} // End mcsLadderRung()
+
+// Move step rungs up (step > 0) or down the ladder from a scheme, which need
+// not be on the ladder itself. Stops at either end of the ladder.
+unsigned int mcsLadderStep(unsigned int mcsIndex, int step)
+{
+    float efficiency = mcsTable[mcsIndex].efficiency;
+    int above = (int) mcsLadderCount(efficiency);       // First rung more efficient than the scheme
+    int below = above-1;                                // Last rung at most as efficient
+    if (below >= 0 && mcsTable[mcsLadder[below]].efficiency >= efficiency - 1e-4f)
+        below--;                                        // The scheme is on the ladder
+    int rung;
+    if (step > 0)
+        rung = std::min(above + step-1, (int) NUM_MCS_LADDER-1);
+    else if (step < 0)
+        rung = std::max(below + step+1, 0);
+    else
+        return mcsIndex;
+    // Past the end the scheme stays as it is unless the ladder leads on
+    if ((step > 0 && above >= (int) NUM_MCS_LADDER) || (step < 0 && below < 0))
+        return mcsIndex;
+    return mcsLadder[rung];
+} // End mcsLadderStep()
+
+const struct mcsEntry * ceMCS(const struct CognitiveEngine * ce)
+{
+    return &mcsTable[ce->mcsIndex];
+} // End ceMCS()
+
+void ceSetMCS(struct CognitiveEngine * ce, unsigned int mod, unsigned int fec0, unsigned int fec1)
+{
+    ce->mcsIndex = mcsIndexTable[mod][fec0][fec1];
+} // End ceSetMCS()
+
+modulation_scheme ceModScheme(const struct CognitiveEngine * ce)
+{
+    return (modulation_scheme) modSchemeNames[ceMCS(ce)->mod].scheme;
+} // End ceModScheme()
+
+fec_scheme ceInnerFEC(const struct CognitiveEngine * ce)
+{
+    return (fec_scheme) fecSchemeNames[ceMCS(ce)->fec0].scheme;
+} // End ceInnerFEC()
+
+fec_scheme ceOuterFEC(const struct CognitiveEngine * ce)
+{
+    return (fec_scheme) fecSchemeNames[ceMCS(ce)->fec1].scheme;
+} // End ceOuterFEC()
+
+// Payload bits per second when a frame of frameLen OFDM symbols, cyclic
+// prefixes included, carries the CE's payload. The modulation and coding
+// enter through frameLen, which liquid computes from them.
+float ceThroughput(const struct CognitiveEngine * ce, unsigned int frameLen)
+{
+    float frame_samples = (float)frameLen*(float)(ce->numSubcarriers + ce->CPLen);
+    return 8.0f*(float)ce->payloadLen*ce->bandwidth/frame_samples;
+} // End ceThroughput()
+
 int readCEMasterFile(char cogengine_list[30][60], int verbose, int isController)
 {
     config_t cfg;               // Returns all parameters in this structure 
@@ -508,7 +1544,109 @@ int readCEMasterFile(char cogengine_list[30][60], int verbose, int isController)
 
 ///////////////////Cognitive Engine///////////////////////////////////////////////////////////
 ////////Reading the cognitive radio parameters from the configuration file////////////////////
-int readCEConfigFile(struct CognitiveEngine * ce, char *current_cogengine_file, int verbose)
+// Read an array of names from a CE config file into indices of a scheme table
+int parseSchemeNameList(config_setting_t * setting, const char * option, const struct schemeName * table,
+    unsigned int n, unsigned char * indices, int * count, const char * file)
+{
+    config_setting_t * list = config_setting_get_member(setting, option);
+    if (list == NULL)
+        return EX_OK;
+    int len = config_setting_length(list);
+    if (len > (int) n)
+    {
+        fprintf(stderr, "ERROR: %s in %s has more than %u entries\n", option, file, n);
+        return EX_DATAERR;
+    }
+    for (int i=0; i<len; i++)
+    {
+        const char * name = config_setting_get_string_elem(list, i);
+        const struct schemeName * s = name ? parseSchemeName(table, n, name, option, file) : NULL;
+        if (s == NULL)
+            return EX_DATAERR;
+        indices[i] = s - table;
+    }
+    *count = len;
+    return EX_OK;
+} // End parseSchemeNameList()
+
+// Read the learning* options of a CE config file.
+// Returns -1 if there are none, or else EX_OK or EX_DATAERR.
+int parseLearningOptions(config_setting_t * setting, struct learningConfig * lc, const char * file, int verbose)
+{
+    static const char * keys[] = {"learningAlgorithm", "learningModSchemes", "learningInnerFECs", "learningOuterFECs",
+        "learningPayloadLens", "learningExploration", "learningEpsilon", "learningRate", "learningDiscount"};
+    int found = 0;
+    for (unsigned int i=0; i<sizeof(keys)/sizeof(keys[0]); i++)
+        if (config_setting_get_member(setting, keys[i]) != NULL)
+            found = 1;
+    if (!found)
+        return -1;
+
+    memset(lc, 0, sizeof(struct learningConfig));
+    lc->algorithm = LEARNING_UCB1;
+    lc->exploration = 1.41421356f;
+    lc->epsilon = 0.1f;
+    lc->rate = 0.1f;
+    lc->discount = 0.9f;
+
+    const char * str;
+    double tmpD;
+    if (config_setting_lookup_string(setting, "learningAlgorithm", &str))
+    {
+        lc->algorithm = parseCEName(learningAlgorithmNames, NUM_LEARNING_ALGORITHMS, str, "learningAlgorithm", file);
+        if (lc->algorithm < 0)
+            return EX_DATAERR;
+        if (verbose) printf("Learning algorithm: %s\n", str);
+    }
+    if (parseSchemeNameList(setting, "learningModSchemes", modSchemeNames, NUM_MOD_SCHEME_NAMES,
+            lc->modSchemes, &lc->numModSchemes, file) != EX_OK ||
+        parseSchemeNameList(setting, "learningInnerFECs", fecSchemeNames, NUM_FEC_SCHEME_NAMES,
+            lc->innerFECs, &lc->numInnerFECs, file) != EX_OK ||
+        parseSchemeNameList(setting, "learningOuterFECs", fecSchemeNames, NUM_FEC_SCHEME_NAMES,
+            lc->outerFECs, &lc->numOuterFECs, file) != EX_OK)
+        return EX_DATAERR;
+
+    config_setting_t * list = config_setting_get_member(setting, "learningPayloadLens");
+    if (list != NULL)
+    {
+        lc->numPayloadLens = config_setting_length(list);
+        if (lc->numPayloadLens > MAX_LEARNING_PAYLOAD_LENS)
+        {
+            fprintf(stderr, "ERROR: learningPayloadLens in %s has more than %d entries\n", file, MAX_LEARNING_PAYLOAD_LENS);
+            return EX_DATAERR;
+        }
+        for (int i=0; i<lc->numPayloadLens; i++)
+        {
+            int len = config_setting_get_int_elem(list, i);
+            if (len < 1 || len > PN_MAX_PAYLOAD_LEN)
+            {
+                fprintf(stderr, "ERROR: learningPayloadLens in %s must be between 1 and %d\n", file, PN_MAX_PAYLOAD_LEN);
+                return EX_DATAERR;
+            }
+            lc->payloadLens[i] = len;
+        }
+    }
+
+    int numArms = std::max(lc->numModSchemes, 1)*std::max(lc->numInnerFECs, 1)*
+        std::max(lc->numOuterFECs, 1)*std::max(lc->numPayloadLens, 1);
+    if (numArms > MAX_LEARNING_ARMS)
+    {
+        fprintf(stderr, "ERROR: the learning options in %s give %d arms. At most %d are supported\n", file,
+            numArms, MAX_LEARNING_ARMS);
+        return EX_DATAERR;
+    }
+
+    if (config_setting_lookup_float(setting, "learningExploration", &tmpD)) lc->exploration = tmpD;
+    if (config_setting_lookup_float(setting, "learningEpsilon", &tmpD)) lc->epsilon = tmpD;
+    if (config_setting_lookup_float(setting, "learningRate", &tmpD)) lc->rate = tmpD;
+    if (config_setting_lookup_float(setting, "learningDiscount", &tmpD)) lc->discount = tmpD;
+    return EX_OK;
+} // End parseLearningOptions()
+
+// Parse a CE config file into options without touching any CE.
+// Returns EX_OK, or EX_NOINPUT/EX_DATAERR after reporting why the file
+// could not be used.
+int parseCEConfigFile(struct ceConfigOptions * opts, const char *current_cogengine_file, int verbose)
 {
     config_t cfg;               // Returns all parameters in this structure 
     config_setting_t *setting;
@@ -516,6 +1654,10 @@ int readCEConfigFile(struct CognitiveEngine * ce, char *current_cogengine_file,
     int tmpI;                   // Stores the value of Integer Parameters from Config file
     double tmpD;                
     char ceFileLocation[60];
+    struct CognitiveEngine * ce = &opts->values;
+    int status = EX_OK;
+
+    memset(opts, 0, sizeof(struct ceConfigOptions));
 
     strcpy(ceFileLocation, "ceconfigs/");
     strcat(ceFileLocation, current_cogengine_file);
@@ -526,12 +1668,12 @@ int readCEConfigFile(struct CognitiveEngine * ce, char *current_cogengine_file,
     //Initialization
     config_init(&cfg);
 
-    // Read the file. If there is an error, report it and exit. 
+    // Read the file. If there is an error, report it. 
     if (!config_read_file(&cfg,ceFileLocation))
     {
         fprintf(stderr, "\n%s:%d - %s", config_error_file(&cfg), config_error_line(&cfg), config_error_text(&cfg));
         config_destroy(&cfg);
-        exit(EX_NOINPUT);
+        return EX_NOINPUT;
     }
 
     // Read the parameter group
@@ -541,41 +1683,167 @@ int readCEConfigFile(struct CognitiveEngine * ce, char *current_cogengine_file,
         // Read the strings
         if (config_setting_lookup_string(setting, "adaptation", &str))
         {
-            strcpy(ce->adaptation,str);
+            const char * prefix = ceAdaptationNames[CE_ADAPT_SET_MOD_SCHEME];
+            const char * mcsPrefix = ceAdaptationNames[CE_ADAPT_SET_MCS_EFFICIENCY];
+            int i = 0;
+            if (strncmp(str, prefix, strlen(prefix)) == 0)
+            {
+                const struct schemeName * s = parseSchemeName(modSchemeNames, NUM_MOD_SCHEME_NAMES,
+                    str+strlen(prefix), "adaptation modulation scheme", ceFileLocation);
+                i = CE_ADAPT_SET_MOD_SCHEME;
+                if (s == NULL)
+                    i = -1;
+                else
+                    ce->adaptationModScheme = s - modSchemeNames;
+            }
+            else if (strncmp(str, mcsPrefix, strlen(mcsPrefix)) == 0)
+            {
+                char * end;
+                float efficiency = strtof(str+strlen(mcsPrefix), &end);
+                i = CE_ADAPT_SET_MCS_EFFICIENCY;
+                if (end == str+strlen(mcsPrefix) || *end != '\0')
+                {
+                    fprintf(stderr, "ERROR: Unknown adaptation \"%s\" in %s\n", str, ceFileLocation);
+                    i = -1;
+                }
+                else
+                    ce->adaptationMCSIndex = mcsIndexForEfficiency(efficiency);
+            }
+            else if (strcmp(str, "none") == 0)
+                i = CE_ADAPT_NONE;
+            else
+                i = parseCEName(ceAdaptationNames, NUM_CE_ADAPTATIONS, str, "adaptation", ceFileLocation);
+            if (i < 0)
+                status = EX_DATAERR;
+            else
+            {
+                ce->adaptation = (enum ceAdaptationType) i;
+                opts->set |= CE_OPTION(ADAPTATION);
+            }
             if (verbose) printf("Option to adapt: %s\n",str);
         }
        
         if (config_setting_lookup_string(setting, "goal", &str))
         {
-            strcpy(ce->goal,str);
+            int i = parseCEName(ceGoalNames, NUM_CE_GOALS, str, "goal", ceFileLocation);
+            if (i < 0)
+                status = EX_DATAERR;
+            else
+            {
+                ce->goal = (enum ceGoalType) i;
+                opts->set |= CE_OPTION(GOAL);
+            }
             if (verbose) printf("Goal: %s\n",str);
         }
+        if (config_setting_lookup_string(setting, "feedbackAggregation", &str))
+        {
+            int i = parseCEName(feedbackAggregationNames, NUM_FB_AGGREGATIONS, str, "feedbackAggregation", ceFileLocation);
+            if (i < 0)
+                status = EX_DATAERR;
+            else
+            {
+                ce->feedbackAggregation = (enum feedbackAggregationType) i;
+                opts->set |= CE_OPTION(FEEDBACK_AGGREGATION);
+            }
+            if (verbose) printf("Feedback aggregation: %s\n",str);
+        }
         if (config_setting_lookup_string(setting, "adaptationCondition", &str))
         {
-            strcpy(ce->adaptationCondition,str);
+            int i = parseCEName(ceConditionNames, NUM_CE_CONDITIONS, str, "adaptationCondition", ceFileLocation);
+            if (i < 0)
+                status = EX_DATAERR;
+            else
+            {
+                ce->adaptationCondition = (enum ceConditionType) i;
+                opts->set |= CE_OPTION(ADAPTATION_CONDITION);
+            }
             if (verbose) printf("adaptationCondition: %s\n",str);
         }
         if (config_setting_lookup_string(setting, "modScheme", &str))
         {
-            strcpy(ce->modScheme,str);
+            const struct schemeName * s = parseSchemeName(modSchemeNames, NUM_MOD_SCHEME_NAMES, str, "modScheme", ceFileLocation);
+            if (s == NULL)
+                status = EX_DATAERR;
+            else
+            {
+                opts->mod = s - modSchemeNames;
+                opts->set |= CE_OPTION(MOD_SCHEME);
+            }
             if (verbose) printf("Modulation Scheme:%s\n",str);
         }
         if (config_setting_lookup_string(setting, "crcScheme", &str))
         {
-            strcpy(ce->crcScheme,str);
+            const struct schemeName * s = parseSchemeName(crcSchemeNames, NUM_CRC_SCHEME_NAMES, str, "crcScheme", ceFileLocation);
+            if (s == NULL)
+                status = EX_DATAERR;
+            else
+            {
+                ce->crcScheme = (crc_scheme) s->scheme;
+                opts->set |= CE_OPTION(CRC_SCHEME);
+            }
             if (verbose) printf("CRC Scheme:%s\n",str);
         }
         if (config_setting_lookup_string(setting, "innerFEC", &str))
         {
-            strcpy(ce->innerFEC,str);
+            const struct schemeName * s = parseSchemeName(fecSchemeNames, NUM_FEC_SCHEME_NAMES, str, "innerFEC", ceFileLocation);
+            if (s == NULL)
+                status = EX_DATAERR;
+            else
+            {
+                opts->fec0 = s - fecSchemeNames;
+                opts->set |= CE_OPTION(INNER_FEC);
+            }
             if (verbose) printf("Inner FEC Scheme:%s\n",str);
         }
+        if (config_setting_lookup_string(setting, "plugin", &str))
+        {
+            if (strlen(str) >= sizeof(ce->pluginPath))
+            {
+                fprintf(stderr, "ERROR: plugin path in %s is longer than %u characters\n", ceFileLocation,
+                    (unsigned int) sizeof(ce->pluginPath)-1);
+                status = EX_DATAERR;
+            }
+            else
+            {
+                strcpy(ce->pluginPath, str);
+                opts->set |= CE_OPTION(PLUGIN);
+            }
+            if (verbose) printf("Plugin: %s\n",str);
+        }
+        if (config_setting_lookup_string(setting, "pluginArgs", &str))
+        {
+            if (strlen(str) >= sizeof(ce->pluginArgs))
+            {
+                fprintf(stderr, "ERROR: pluginArgs in %s is longer than %u characters\n", ceFileLocation,
+                    (unsigned int) sizeof(ce->pluginArgs)-1);
+                status = EX_DATAERR;
+            }
+            else
+            {
+                strcpy(ce->pluginArgs, str);
+                opts->set |= CE_OPTION(PLUGIN_ARGS);
+            }
+            if (verbose) printf("Plugin arguments: %s\n",str);
+        }
         if (config_setting_lookup_string(setting, "outerFEC", &str))
         {
-            strcpy(ce->outerFEC,str);
+            const struct schemeName * s = parseSchemeName(fecSchemeNames, NUM_FEC_SCHEME_NAMES, str, "outerFEC", ceFileLocation);
+            if (s == NULL)
+                status = EX_DATAERR;
+            else
+            {
+                opts->fec1 = s - fecSchemeNames;
+                opts->set |= CE_OPTION(OUTER_FEC);
+            }
             if (verbose) printf("Outer FEC Scheme:%s\n",str);
         }
 
+        int learningStatus = parseLearningOptions(setting, &ce->learning, ceFileLocation, verbose);
+        if (learningStatus == EX_OK)
+            opts->set |= CE_OPTION(LEARNING);
+        else if (learningStatus > 0)
+            status = learningStatus;
+
         // Read the integers
         if (config_setting_lookup_int(setting, "iterations", &tmpI))
         {
@@ -585,377 +1853,2000 @@ int readCEConfigFile(struct CognitiveEngine * ce, char *current_cogengine_file,
         if (config_setting_lookup_int(setting, "payloadLen", &tmpI))
         {
            ce->payloadLen=tmpI; 
+           opts->set |= CE_OPTION(PAYLOAD_LEN);
            if (verbose) printf("PayloadLen: %d\n", tmpI);
         }
         if (config_setting_lookup_int(setting, "payloadLenIncrement", &tmpI))
         {
            ce->payloadLenIncrement=tmpI; 
+           opts->set |= CE_OPTION(PAYLOAD_LEN_INCREMENT);
            if (verbose) printf("PayloadLenIncrement: %d\n", tmpI);
         }
         if (config_setting_lookup_int(setting, "payloadLenMax", &tmpI))
         {
            ce->payloadLenMax=tmpI; 
+           opts->set |= CE_OPTION(PAYLOAD_LEN_MAX);
            if (verbose) printf("PayloadLenMax: %d\n", tmpI);
         }
+        if (ce->payloadLen > PN_MAX_PAYLOAD_LEN || ce->payloadLenMax > PN_MAX_PAYLOAD_LEN)
+        {
+           fprintf(stderr, "ERROR: payloadLen and payloadLenMax may not exceed %d bytes\n", PN_MAX_PAYLOAD_LEN);
+           status = EX_DATAERR;
+        }
         if (config_setting_lookup_int(setting, "payloadLenMin", &tmpI))
         {
            ce->payloadLenMin=tmpI; 
+           opts->set |= CE_OPTION(PAYLOAD_LEN_MIN);
            if (verbose) printf("PayloadLenMin: %d\n", tmpI);
         }
         if (config_setting_lookup_int(setting, "numSubcarriers", &tmpI))
         {
            ce->numSubcarriers=tmpI; 
+           opts->set |= CE_OPTION(NUM_SUBCARRIERS);
            if (verbose) printf("Number of Subcarriers: %d\n", tmpI);
         }
         if (config_setting_lookup_int(setting, "CPLen", &tmpI))
         {
            ce->CPLen=tmpI; 
+           opts->set |= CE_OPTION(CP_LEN);
            if (verbose) printf("CPLen: %d\n", tmpI);
         }
         if (config_setting_lookup_int(setting, "taperLen", &tmpI))
         {
            ce->taperLen=tmpI; 
+           opts->set |= CE_OPTION(TAPER_LEN);
            if (verbose) printf("taperLen: %d\n", tmpI);
         }
         if (config_setting_lookup_int(setting, "delay_us", &tmpI))
         {
            ce->delay_us=tmpI; 
+           opts->set |= CE_OPTION(DELAY_US);
            if (verbose) printf("delay_us: %d\n", tmpI);
         }
-        // Read the floats
-        if (config_setting_lookup_float(setting, "default_tx_power", &tmpD))
+        if (config_setting_lookup_int(setting, "framesInFlight", &tmpI))
         {
-           ce->default_tx_power=tmpD; 
+           if (tmpI < 1 || tmpI > MAX_FRAMES_IN_FLIGHT)
+           {
+               fprintf(stderr, "ERROR: framesInFlight in %s must be between 1 and %d\n", ceFileLocation, MAX_FRAMES_IN_FLIGHT);
+               status = EX_DATAERR;
+           }
+           else
+           {
+               ce->framesInFlight=tmpI;
+               opts->set |= CE_OPTION(FRAMES_IN_FLIGHT);
+           }
+           if (verbose) printf("framesInFlight: %d\n", tmpI);
+        }
+        // Read the floats
+        if (config_setting_lookup_float(setting, "default_tx_power", &tmpD))
+        {
+           ce->default_tx_power=tmpD; 
+           opts->set |= CE_OPTION(DEFAULT_TX_POWER);
            if (verbose) printf("Default Tx Power: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "latestGoalValue", &tmpD))
         {
            ce->latestGoalValue=tmpD; 
+           opts->set |= CE_OPTION(LATEST_GOAL_VALUE);
            if (verbose) printf("Latest Goal Value: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "threshold", &tmpD))
         {
            ce->threshold=tmpD; 
+           opts->set |= CE_OPTION(THRESHOLD);
            if (verbose) printf("Threshold: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "frequency_tx", &tmpD))
         {
            ce->frequency_tx=tmpD; 
+           opts->set |= CE_OPTION(FREQUENCY_TX);
            if (verbose) printf("Transmit frequency: %f\n", tmpD);
         }
 		if (config_setting_lookup_float(setting, "frequency_rx", &tmpD))
         {
            ce->frequency_rx=tmpD; 
+           opts->set |= CE_OPTION(FREQUENCY_RX);
            if (verbose) printf("Receive frequency: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "txgain_dB", &tmpD))
         {
            ce->txgain_dB=tmpD; 
+           opts->set |= CE_OPTION(TXGAIN_DB);
            if (verbose) printf("txgain_dB: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "bandwidth", &tmpD))
         {
            ce->bandwidth=tmpD; 
+           opts->set |= CE_OPTION(BANDWIDTH);
            if (verbose) printf("bandwidth: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "uhd_txgain_dB", &tmpD))
         {
            ce->uhd_txgain_dB=tmpD; 
+           opts->set |= CE_OPTION(UHD_TXGAIN_DB);
            if (verbose) printf("uhd_txgain_dB: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "weighted_avg_payload_valid_threshold", &tmpD))
         {
            ce->weighted_avg_payload_valid_threshold=tmpD; 
+           opts->set |= CE_OPTION(WEIGHTED_AVG_PAYLOAD_VALID_THRESHOLD);
            if (verbose) printf("weighted_avg_payload_valid_threshold: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "PER_threshold", &tmpD))
         {
            ce->PER_threshold=tmpD; 
+           opts->set |= CE_OPTION(PER_THRESHOLD);
            if (verbose) printf("PER_threshold: %f\n", tmpD);
         }
         if (config_setting_lookup_float(setting, "BER_threshold", &tmpD))
         {
            ce->BER_threshold=tmpD; 
+           opts->set |= CE_OPTION(BER_THRESHOLD);
            if (verbose) printf("BER_threshold: %f\n", tmpD);
+        }
+        if (config_setting_lookup_float(setting, "PER_variance_threshold", &tmpD))
+        {
+           ce->PER_variance_threshold=tmpD;
+           opts->set |= CE_OPTION(PER_VARIANCE_THRESHOLD);
+           if (verbose) printf("PER_variance_threshold: %f\n", tmpD);
+        }
+        if (config_setting_lookup_float(setting, "BER_quantile", &tmpD))
+        {
+           ce->BER_quantile=tmpD;
+           opts->set |= CE_OPTION(BER_QUANTILE);
+           if (tmpD < 0.0 || tmpD > 1.0)
+           {
+               fprintf(stderr, "ERROR: BER_quantile in %s must be between 0 and 1\n", ceFileLocation);
+               status = EX_DATAERR;
+           }
+           if (verbose) printf("BER_quantile: %f\n", tmpD);
         }
 		if (config_setting_lookup_float(setting, "goal_averaging", &tmpD))
         {
            ce->goal_averaging=tmpD; 
+           opts->set |= CE_OPTION(GOAL_AVERAGING);
+           if (ce->goal_averaging < 1)
+           {
+               fprintf(stderr, "ERROR: goal_averaging in %s must be at least 1\n", ceFileLocation);
+               status = EX_DATAERR;
+           }
            if (verbose) printf("Goal averaging: %f\n", tmpD);
         }
 		if (config_setting_lookup_int(setting, "BER_averaging", &tmpI))
         {
            ce->BER_averaging=tmpI;
-		   ce->BER_RA_ptr = new running_avg<float>(tmpI);
+           opts->set |= CE_OPTION(BER_AVERAGING);
+           if (tmpI < 1)
+           {
+               fprintf(stderr, "ERROR: BER_averaging in %s must be at least 1\n", ceFileLocation);
+               status = EX_DATAERR;
+           }
            if (verbose) printf("BER averaging: %i\n", tmpI);
         }
 		if (config_setting_lookup_int(setting, "PER_averaging", &tmpI))
         {
            ce->PER_averaging=tmpI;
-		   ce->PER_RA_ptr = new running_avg<float>(tmpI);
+           opts->set |= CE_OPTION(PER_AVERAGING);
+           if (tmpI < 1)
+           {
+               fprintf(stderr, "ERROR: PER_averaging in %s must be at least 1\n", ceFileLocation);
+               status = EX_DATAERR;
+           }
            if (verbose) printf("PER averaging: %i\n", tmpI);
         }
 		if (config_setting_lookup_int(setting, "validPayloads_averaging", &tmpI))
         {
            ce->validPayloads_averaging=tmpI;
-		   ce->validPayloads_RA_ptr = new running_avg<float>(tmpI);
+           opts->set |= CE_OPTION(VALID_PAYLOADS_AVERAGING);
+           if (tmpI < 1)
+           {
+               fprintf(stderr, "ERROR: validPayloads_averaging in %s must be at least 1\n", ceFileLocation);
+               status = EX_DATAERR;
+           }
            if (verbose) printf("Valid payloads averaging: %i\n", tmpI);
         }
 		if (config_setting_lookup_int(setting, "errorFreePayloads_averaging", &tmpI))
         {
            ce->errorFreePayloads_averaging=tmpI;
-		   ce->errorFreePayloads_RA_ptr = new running_avg<float>(tmpI);
+           opts->set |= CE_OPTION(ERROR_FREE_PAYLOADS_AVERAGING);
+           if (tmpI < 1)
+           {
+               fprintf(stderr, "ERROR: errorFreePayloads_averaging in %s must be at least 1\n", ceFileLocation);
+               status = EX_DATAERR;
+           }
            if (verbose) printf("BER averaging: %i\n", tmpI);
         }
 
 	
     }
     config_destroy(&cfg);
-    return 1;
-} // End readCEConfigFile()
+    return status;
+} // End parseCEConfigFile()
+
+// One configuration a learning engine can choose. All arms live in one
+// flat array, ordered by MCS efficiency and then payload length.
+struct learningArm {
+    float rewardSum;
+    unsigned int pulls;
+    unsigned int successes;     // Frames with a valid payload
+    float goodput;              // Reward of a valid frame. 0 until the arm is played
+    unsigned short mcsIndex;
+    unsigned short payloadLen;
+};
 
-int readScConfigFile(struct Scenario * sc, char *current_scenario_file, int verbose)
+struct learningEngine {
+    int algorithm;
+    int numArms;
+    struct learningChoice chosen;   // For the next frame sent
+    int firstUnplayed;          // Arms before this one have been rewarded at least once
+    int bestArm;                // Arm with the highest mean reward, or -1
+    unsigned long t;            // Frames rewarded
+    double totalReward;
+    float goodputScale;         // Payload bytes per OFDM symbol that give a reward of 1
+    struct learningConfig config;
+    unsigned int rngState;
+    struct learningArm arms[MAX_LEARNING_ARMS];
+    unsigned char byGoodput[MAX_LEARNING_ARMS];     // Arm numbers, highest goodput first
+    float Q[MAX_LEARNING_ARMS*2][3];    // [arm*2 + last payload valid][step down, stay, step up]
+};
+
+float learningUniform(struct learningEngine * le)
 {
-    config_t cfg;               // Returns all parameters in this structure 
-    config_setting_t *setting;
-    //const char * str;
-    int tmpI;
-    double tmpD;
-    char scFileLocation[60];
+    return ((float) rand_r(&le->rngState) + 0.5f)/((float) RAND_MAX + 1.0f);
+} // End learningUniform()
 
-    // Because the file is in the folder 'scconfigs'
-    strcpy(scFileLocation, "scconfigs/");
-    strcat(scFileLocation, current_scenario_file);
+// Gamma(shape, 1) variate for shape >= 1 (Marsaglia and Tsang)
+float learningGamma(struct learningEngine * le, float shape)
+{
+    float d = shape - 1.0f/3.0f;
+    float c = 1.0f/sqrtf(9.0f*d);
+    for (;;)
+    {
+        // Standard normal from Box-Muller
+        float z = sqrtf(-2.0f*logf(learningUniform(le)))*cosf(2.0f*(float)M_PI*learningUniform(le));
+        float v = 1.0f + c*z;
+        if (v <= 0.0f)
+            continue;
+        v = v*v*v;
+        float u = learningUniform(le);
+        if (logf(u) < 0.5f*z*z + d - d*v + d*logf(v))
+            return d*v;
+    }
+} // End learningGamma()
 
-    // Initialization 
-    config_init(&cfg);
+float learningBeta(struct learningEngine * le, float a, float b)
+{
+    float x = learningGamma(le, a);
+    return x/(x + learningGamma(le, b));
+} // End learningBeta()
 
-    // Read the file. If there is an error, report it and exit. 
-    if (!config_read_file(&cfg, scFileLocation))
+// Create the learning engine described by ce->learning, or return NULL if
+// it has none. Its arms are ordered by MCS efficiency and then payload length.
+struct learningEngine * createLearningEngine(struct CognitiveEngine * ce)
+{
+    struct learningConfig * lc = &ce->learning;
+    if (lc->algorithm == LEARNING_NONE)
+        return NULL;
+
+    struct learningEngine * le = (struct learningEngine *) calloc(1, sizeof(struct learningEngine));
+    le->algorithm = lc->algorithm;
+    le->config = *lc;
+    le->chosen.arm = -1;
+    le->chosen.state = -1;
+    le->chosen.action = -1;
+    le->bestArm = -1;
+    le->rngState = (unsigned int) crtsRand();
+
+    // Empty lists stand for the CE's current setting
+    const struct mcsEntry * mcs = ceMCS(ce);
+    unsigned char mod = mcs->mod, fec0 = mcs->fec0, fec1 = mcs->fec1;
+    unsigned int payloadLen = ce->payloadLen;
+    int numMods = lc->numModSchemes ? lc->numModSchemes : 1;
+    int numFEC0 = lc->numInnerFECs ? lc->numInnerFECs : 1;
+    int numFEC1 = lc->numOuterFECs ? lc->numOuterFECs : 1;
+    int numLens = lc->numPayloadLens ? lc->numPayloadLens : 1;
+
+    unsigned int maxBps = 1;
+    for (int m=0; m<numMods; m++)
+    for (int f0=0; f0<numFEC0; f0++)
+    for (int f1=0; f1<numFEC1; f1++)
+    for (int p=0; p<numLens; p++)
     {
-        fprintf(stderr, "%s:%d - %s\n", config_error_file(&cfg), config_error_line(&cfg), config_error_text(&cfg));
-        config_destroy(&cfg);
-        exit(EX_NOINPUT);
+        struct learningArm * arm = &le->arms[le->numArms++];
+        arm->mcsIndex = mcsIndexTable[lc->numModSchemes ? lc->modSchemes[m] : mod]
+                                     [lc->numInnerFECs ? lc->innerFECs[f0] : fec0]
+                                     [lc->numOuterFECs ? lc->outerFECs[f1] : fec1];
+        arm->payloadLen = lc->numPayloadLens ? lc->payloadLens[p] : payloadLen;
+        maxBps = std::max(maxBps, (unsigned int) mcsTable[arm->mcsIndex].bitsPerSymbol);
     }
-
-    // Read the parameter group.
-    setting = config_lookup(&cfg, "params");
-    if (setting != NULL)
+    // Insertion sort: the arms are few and created once
+    for (int i=1; i<le->numArms; i++)
     {
-        // Read the integer
-        if (config_setting_lookup_int(setting, "addAWGNBasebandTx", &tmpI))
+        struct learningArm a = le->arms[i];
+        int j = i;
+        while (j > 0 && (le->arms[j-1].mcsIndex > a.mcsIndex ||
+               (le->arms[j-1].mcsIndex == a.mcsIndex && le->arms[j-1].payloadLen > a.payloadLen)))
         {
-            sc->addAWGNBasebandTx=tmpI;
-            if (verbose) printf("addAWGNBasebandTx: %d\n", tmpI);
+            le->arms[j] = le->arms[j-1];
+            j--;
         }
+        le->arms[j] = a;
+    }
+    for (int i=0; i<le->numArms; i++)
+        le->byGoodput[i] = (unsigned char) i;
 
-        // Read the integer
-        if (config_setting_lookup_int(setting, "addAWGNBasebandRx", &tmpI))
-        {
-            sc->addAWGNBasebandRx=tmpI;
-            if (verbose) printf("addAWGNBasebandRx: %d\n", tmpI);
-        }
-        // Read the double
-        if (config_setting_lookup_float(setting, "noiseSNR", &tmpD))
-        {
-            sc->noiseSNR=(float) tmpD;
-            if (verbose) printf("Noise SNR: %f\n", tmpD);
-        }
-       
-        // Read the double
-        if (config_setting_lookup_float(setting, "noiseDPhi", &tmpD))
-        {
-            sc->noiseDPhi=(float) tmpD;
-            if (verbose) printf("NoiseDPhi: %f\n", tmpD);
-        }
+    // No frame carries more payload per OFDM symbol than every subcarrier
+    // at the highest order modulation without coding
+    le->goodputScale = (float) ce->numSubcarriers*maxBps/8.0f;
+    return le;
+} // End createLearningEngine()
 
-        // Read the integer
-        if (config_setting_lookup_int(setting, "addRicianFadingBasebandTx", &tmpI))
-        {
-            sc->addRicianFadingBasebandTx=tmpI;
-            if (verbose) printf("addRicianFadingBasebandTx: %d\n", tmpI);
-        }
-        if (config_setting_lookup_int(setting, "addRicianFadingBasebandRx", &tmpI))
-        {
-            sc->addRicianFadingBasebandRx=tmpI;
-            if (verbose) printf("addRicianFadingBasebandRx: %d\n", tmpI);
-        }
+void destroyLearningEngine(struct learningEngine * le)
+{
+    free(le);
+} // End destroyLearningEngine()
 
-		// Read the double
-        if (config_setting_lookup_float(setting, "fadeK", &tmpD))
-        {
-            sc->fadeK=(float)tmpD;
-            if (verbose) printf("fadeK: %f\n", tmpD);
-        }
-       
-        // Read the double
-        if (config_setting_lookup_float(setting, "fadeFd", &tmpD))
-        {
-            sc->fadeFd=(float)tmpD;
-            if (verbose) printf("fadeFd: %f\n", tmpD);
-        }
-        
-        // Read the double
-        if (config_setting_lookup_float(setting, "fadeDPhi", &tmpD))
-        {
-            sc->fadeDPhi=(float)tmpD;
-            if (verbose) printf("fadeDPhi: %f\n", tmpD);
-        }
+// The parameters of the frame a CE has just assembled
+struct txFrameParams txFrameParamsOf(const struct CognitiveEngine * ce)
+{
+    struct txFrameParams sent;
+    sent.mcsIndex = ce->mcsIndex;
+    sent.payloadLen = ce->payloadLen;
+    sent.frameLen = ce->frameLen;
+    sent.learning.arm = sent.learning.state = sent.learning.action = -1;
+    if (ce->learning_ptr != NULL)
+        sent.learning = ce->learning_ptr->chosen;
+    return sent;
+} // End txFrameParamsOf()
+
+// Set the goodput of an arm and move it to its place in le->byGoodput.
+// The goodput of an arm only changes with the frame length, so this is rare.
+void learningSetGoodput(struct learningEngine * le, int a, float goodput)
+{
+    if (le->arms[a].goodput == goodput)
+        return;
+    le->arms[a].goodput = goodput;
+    int k = 0;
+    while (le->byGoodput[k] != a)
+        k++;
+    while (k > 0 && le->arms[le->byGoodput[k-1]].goodput < goodput)
+    {
+        le->byGoodput[k] = le->byGoodput[k-1];
+        k--;
+    }
+    while (k < le->numArms-1 && le->arms[le->byGoodput[k+1]].goodput > goodput)
+    {
+        le->byGoodput[k] = le->byGoodput[k+1];
+        k++;
+    }
+    le->byGoodput[k] = (unsigned char) a;
+} // End learningSetGoodput()
 
-		// Read the integer
-		if (config_setting_lookup_int(setting, "addCWInterfererBasebandTx", &tmpI))
+float learningMeanReward(const struct learningArm * arm)
+{
+    return arm->pulls > 0 ? arm->rewardSum/arm->pulls : 0.0f;
+} // End learningMeanReward()
+
+// Index of the largest of n values
+int learningArgmax(const float * x, int n)
+{
+    int best = 0;
+    for (int i=1; i<n; i++)
+        if (x[i] > x[best])
+            best = i;
+    return best;
+} // End learningArgmax()
+
+// Credit a frame to the arm it was sent with, choose the next arm and set
+// the CE's parameters from it.
+int learningModifyTxParams(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr,
+    const struct txFrameParams * sent, int verbose)
+{
+    struct learningEngine * le = ce->learning_ptr;
+    const struct learningChoice * last = &sent->learning;
+    int valid = fbPtr->payload_valid ? 1 : 0;
+
+    // Reward: normalized goodput of the frame
+    if (last->arm >= 0)
+    {
+        struct learningArm * arm = &le->arms[last->arm];
+        float reward = 0.0f;
+        if (sent->frameLen > 0)
+            learningSetGoodput(le, last->arm, (float) arm->payloadLen/(float) sent->frameLen/le->goodputScale);
+        if (valid)
+            reward = arm->goodput;
+        arm->rewardSum += reward;
+        arm->pulls++;
+        arm->successes += valid;
+        le->t++;
+        le->totalReward += reward;
+
+        if (le->algorithm == LEARNING_Q && last->state >= 0)
         {
-            sc->addCWInterfererBasebandTx=(float)tmpI;
-            if (verbose) printf("addCWIntefererBasebandTx: %d\n", tmpI);
+            float * q = le->Q[last->state];
+            const float * next = le->Q[last->arm*2 + valid];
+            float target = reward + le->config.discount*next[learningArgmax(next, 3)];
+            q[last->action] += le->config.rate*(target - q[last->action]);
         }
-		// Read the integer
-		if (config_setting_lookup_int(setting, "addCWInterfererBasebandRx", &tmpI))
+
+        // Regret against the best arm in hindsight. Only the arm just
+        // rewarded has changed, so all arms are only looked at again when
+        // the best one got worse.
+        if (le->bestArm < 0 || learningMeanReward(arm) > learningMeanReward(&le->arms[le->bestArm]))
+            le->bestArm = last->arm;
+        else if (le->bestArm == last->arm)
         {
-            sc->addCWInterfererBasebandRx=(float)tmpI;
-            if (verbose) printf("addCWIntefererBasebandRx: %d\n", tmpI);
+            for (int i=0; i<le->numArms; i++)
+                if (learningMeanReward(&le->arms[i]) > learningMeanReward(&le->arms[le->bestArm]))
+                    le->bestArm = i;
         }
+        ce->regret = (float) (learningMeanReward(&le->arms[le->bestArm])*le->t - le->totalReward);
+    }
 
-		// Read the double
-		if (config_setting_lookup_float(setting, "cw_pow", &tmpD))
+    // Choose the next arm
+    int next = 0;
+    le->chosen.state = -1;
+    le->chosen.action = -1;
+    if (le->algorithm == LEARNING_Q)
+    {
+        // Step from the arm the feedback is about
+        int from = last->arm >= 0 ? last->arm : 0;
+        int state = from*2 + valid;
+        int action = learningUniform(le) < le->config.epsilon ?
+            (int) (learningUniform(le)*3.0f) % 3 : learningArgmax(le->Q[state], 3);
+        next = std::max(0, std::min(from + action - 1, le->numArms-1));
+        le->chosen.state = state;
+        le->chosen.action = action;
+    }
+    else
+    {
+        // Play every arm once first
+        while (le->firstUnplayed < le->numArms && le->arms[le->firstUnplayed].pulls > 0)
+            le->firstUnplayed++;
+        if (le->firstUnplayed < le->numArms)
+            next = le->firstUnplayed;
+        else if (le->algorithm == LEARNING_UCB1)
         {
-            sc->cw_pow=(float)tmpD;
-            if (verbose) printf("cw_pow: %f\n", tmpD);
+            float logt = logf((float) le->t + 1.0f);
+            float bestValue = -1.0f;
+            for (int i=0; i<le->numArms; i++)
+            {
+                const struct learningArm * arm = &le->arms[i];
+                float value = arm->rewardSum/arm->pulls + le->config.exploration*sqrtf(logt/arm->pulls);
+                if (value > bestValue)
+                {
+                    bestValue = value;
+                    next = i;
+                }
+            }
         }
-
-		// Read the double
-		if (config_setting_lookup_float(setting, "cw_freq", &tmpD))
+        else
         {
-            sc->cw_freq=(float)tmpD;
-            if (verbose) printf("cw_freq: %f\n", tmpD);
+            // A sample is the goodput times a beta variate, so it never
+            // exceeds the goodput. Drawing in order of goodput can stop at
+            // the first arm that cannot beat the best sample so far, which
+            // gives the same choice as drawing for every arm.
+            float bestValue = -1.0f;
+            for (int k=0; k<le->numArms; k++)
+            {
+                int i = le->byGoodput[k];
+                const struct learningArm * arm = &le->arms[i];
+                if (arm->goodput <= bestValue)
+                    break;
+                float value = arm->goodput*learningBeta(le, arm->successes + 1.0f, arm->pulls - arm->successes + 1.0f);
+                if (value > bestValue)
+                {
+                    bestValue = value;
+                    next = i;
+                }
+            }
         }
     }
 
-    config_destroy(&cfg);
-
+    le->chosen.arm = next;
+    ce->mcsIndex = le->arms[next].mcsIndex;
+    ce->payloadLen = le->arms[next].payloadLen;
+    if (verbose)
+        printf("%s chose arm %d: modulation %s, inner FEC %s, outer FEC %s, payloadLen %u. Regret %f\n",
+            learningAlgorithmNames[le->algorithm], next, modSchemeName(ceModScheme(ce)),
+            fecSchemeName(ceInnerFEC(ce)), fecSchemeName(ceOuterFEC(ce)), ce->payloadLen, ce->regret);
     return 1;
-} // End readScConfigFile()
+} // End learningModifyTxParams()
 
-// Add AWGN
-void enactAWGNBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+// Load a CE plugin and create its state for one CE.
+// Reports why it cannot be loaded and returns NULL.
+struct cePlugin * loadCEPlugin(const char * path, const char * args)
 {
-    //options
-    float dphi  = sc_ptr->noiseDPhi;                              // carrier frequency offset
-    float SNRdB = sc_ptr->noiseSNR;                               // signal-to-noise ratio [dB]
-    // noise parameters
-    float nstd = powf(10.0f, -SNRdB/20.0f); // noise standard deviation
-    float phi = 0.0f;                       // channel phase
-   
-    std::complex<float> tmp (0, 1); 
-    unsigned int i;
+    void * handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not load CE plugin: %s\n", dlerror());
+        return NULL;
+    }
 
-    // noise mixing
-    for (i=0; i<buffer_len; i++) {
-        transmit_buffer[i] = std::exp(tmp*phi) * transmit_buffer[i]; // apply carrier offset
-        phi += dphi;                                 // update carrier phase
-        cawgn(&transmit_buffer[i], nstd);            // add noise
+    crts_ce_plugin_entry_t entry;
+    *(void **) &entry = dlsym(handle, CRTS_CE_PLUGIN_ENTRY);
+    const struct crts_ce_plugin * desc = entry ? entry() : NULL;
+    if (desc == NULL || desc->decide == NULL)
+    {
+        fprintf(stderr, "ERROR: %s is not a CE plugin\n", path);
+        dlclose(handle);
+        return NULL;
+    }
+    if (desc->abi_version != CRTS_CE_PLUGIN_ABI_VERSION)
+    {
+        fprintf(stderr, "ERROR: CE plugin %s was built for ABI version %u, not %u\n", path,
+            desc->abi_version, CRTS_CE_PLUGIN_ABI_VERSION);
+        dlclose(handle);
+        return NULL;
     }
-} // End enactAWGNBaseband()
 
-void enactCWInterfererBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
-{
-	float fs = ce_ptr->bandwidth; // Sample rate of the transmit buffer
-	float k = pow(10.0, sc_ptr->cw_pow/20.0); // Coefficient to set the interferer power correctly
-	for(unsigned int i=0; i<buffer_len; i++)
-	{
-		transmit_buffer[i] += k*sin(6.283*sc_ptr->cw_freq*i/fs); // Add CW tone
-	}
-} // End enactCWInterfererBaseband()
+    struct cePlugin * plugin = (struct cePlugin *) malloc(sizeof(struct cePlugin));
+    plugin->handle = handle;
+    plugin->desc = desc;
+    plugin->state = desc->create ? desc->create(args) : NULL;
+    return plugin;
+} // End loadCEPlugin()
 
-// Add Rice-K Fading
-void enactRicianFadingBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+void unloadCEPlugin(struct cePlugin * plugin)
 {
-    unsigned int h_len;                                     // doppler filter length
-    if (buffer_len > 94){
-        h_len = 0.0425*buffer_len;
-    }
-    else {
-        h_len = 4;
+    if (plugin == NULL)
+        return;
+    if (plugin->desc->destroy)
+        plugin->desc->destroy(plugin->state);
+    dlclose(plugin->handle);
+    free(plugin);
+} // End unloadCEPlugin()
+
+// Restart a metric's window when its length is set by an option, keeping its
+// range and EWMA weight.
+// Leaves it alone when the length has not changed, so that its history is kept.
+void applyStatsLength(windowed_stats<float, CE_STATS_INLINE_LEN> * stats, int * length, int newLength)
+{
+    if (*length == newLength)
+        return;
+    stats->release();
+    stats->init(newLength, stats->lo, stats->hi, stats->alpha);
+    *length = newLength;
+} // End applyStatsLength()
+
+// Copy the options that were set in a config file to a CE
+void applyCEConfigOptions(struct CognitiveEngine * ce, const struct ceConfigOptions * opts)
+{
+    const struct CognitiveEngine * v = &opts->values;
+    const struct mcsEntry * mcs = ceMCS(ce);
+
+#define CE_APPLY(opt, field) if (opts->set & CE_OPTION(opt)) ce->field = v->field
+    CE_APPLY(ADAPTATION, adaptation);
+    CE_APPLY(ADAPTATION, adaptationModScheme);
+    CE_APPLY(ADAPTATION, adaptationMCSIndex);
+    CE_APPLY(GOAL, goal);
+    CE_APPLY(FEEDBACK_AGGREGATION, feedbackAggregation);
+    CE_APPLY(ADAPTATION_CONDITION, adaptationCondition);
+    CE_APPLY(CRC_SCHEME, crcScheme);
+    CE_APPLY(PAYLOAD_LEN, payloadLen);
+    CE_APPLY(PAYLOAD_LEN_INCREMENT, payloadLenIncrement);
+    CE_APPLY(PAYLOAD_LEN_MAX, payloadLenMax);
+    CE_APPLY(PAYLOAD_LEN_MIN, payloadLenMin);
+    CE_APPLY(NUM_SUBCARRIERS, numSubcarriers);
+    CE_APPLY(CP_LEN, CPLen);
+    CE_APPLY(TAPER_LEN, taperLen);
+    CE_APPLY(DELAY_US, delay_us);
+    CE_APPLY(FRAMES_IN_FLIGHT, framesInFlight);
+    CE_APPLY(DEFAULT_TX_POWER, default_tx_power);
+    CE_APPLY(LATEST_GOAL_VALUE, latestGoalValue);
+    CE_APPLY(THRESHOLD, threshold);
+    CE_APPLY(FREQUENCY_TX, frequency_tx);
+    CE_APPLY(FREQUENCY_RX, frequency_rx);
+    CE_APPLY(TXGAIN_DB, txgain_dB);
+    CE_APPLY(BANDWIDTH, bandwidth);
+    CE_APPLY(UHD_TXGAIN_DB, uhd_txgain_dB);
+    CE_APPLY(WEIGHTED_AVG_PAYLOAD_VALID_THRESHOLD, weighted_avg_payload_valid_threshold);
+    CE_APPLY(PER_THRESHOLD, PER_threshold);
+    CE_APPLY(BER_THRESHOLD, BER_threshold);
+    CE_APPLY(PER_VARIANCE_THRESHOLD, PER_variance_threshold);
+    CE_APPLY(BER_QUANTILE, BER_quantile);
+#undef CE_APPLY
+
+    ceSetMCS(ce,
+        (opts->set & CE_OPTION(MOD_SCHEME)) ? opts->mod : mcs->mod,
+        (opts->set & CE_OPTION(INNER_FEC)) ? opts->fec0 : mcs->fec0,
+        (opts->set & CE_OPTION(OUTER_FEC)) ? opts->fec1 : mcs->fec1);
+
+    if (opts->set & CE_OPTION(GOAL_AVERAGING))
+        applyStatsLength(&ce->goal_stats, &ce->goal_averaging, v->goal_averaging);
+    if (opts->set & CE_OPTION(BER_AVERAGING))
+        applyStatsLength(&ce->BER_stats, &ce->BER_averaging, v->BER_averaging);
+    if (opts->set & CE_OPTION(PER_AVERAGING))
+        applyStatsLength(&ce->PER_stats, &ce->PER_averaging, v->PER_averaging);
+    if (opts->set & CE_OPTION(VALID_PAYLOADS_AVERAGING))
+        applyStatsLength(&ce->validPayloads_stats, &ce->validPayloads_averaging, v->validPayloads_averaging);
+    if (opts->set & CE_OPTION(ERROR_FREE_PAYLOADS_AVERAGING))
+        applyStatsLength(&ce->errorFreePayloads_stats, &ce->errorFreePayloads_averaging,
+            v->errorFreePayloads_averaging);
+
+    // Only (re)load the plugin when it changes, so that it keeps its state
+    if (opts->set & (CE_OPTION(PLUGIN) | CE_OPTION(PLUGIN_ARGS)))
+    {
+        const char * path = (opts->set & CE_OPTION(PLUGIN)) ? v->pluginPath : ce->pluginPath;
+        const char * args = (opts->set & CE_OPTION(PLUGIN_ARGS)) ? v->pluginArgs : ce->pluginArgs;
+        if (ce->plugin_ptr == NULL || strcmp(path, ce->pluginPath) != 0 || strcmp(args, ce->pluginArgs) != 0)
+        {
+            unloadCEPlugin(ce->plugin_ptr);
+            ce->plugin_ptr = NULL;
+            strcpy(ce->pluginPath, path);
+            strcpy(ce->pluginArgs, args);
+            if (ce->pluginPath[0] != '\0')
+            {
+                ce->plugin_ptr = loadCEPlugin(ce->pluginPath, ce->pluginArgs);
+                if (ce->plugin_ptr == NULL)
+                    exit(EX_UNAVAILABLE);
+            }
+        }
     }
-    float fd           = sc_ptr->fadeFd; // maximum doppler frequency
-    float K            = sc_ptr->fadeK;  // Rice fading factor
-    float omega        = 1.0f;      // mean power
-    float theta        = 0.0f;      // angle of arrival
-    float dphi 		   = sc_ptr->fadeDPhi;       // carrier frequency offset
-    float phi          = 0.0f;               // channel phase
 
-    // validate input
-    if (K < 1.5f) {
-        fprintf(stderr, "error: fading factor K must be greater than 1.5\n");
-        exit(1);
-    } else if (omega < 0.0f) {
-        fprintf(stderr, "error: signal power Omega must be greater than zero\n");
-        exit(1);
-    } else if (fd <= 0.0f || fd >= 0.5f) {
-        fprintf(stderr, "error: Doppler frequency must be in (0,0.5)\n");
-        exit(1);
-    //} else if (symbol_len== 0) {
-    } else if (buffer_len== 0) {
-        fprintf(stderr, "error: number of samples must be greater than zero\n");
-        exit(1);
+    // Likewise, only restart the learning engine when its configuration changes
+    if ((opts->set & CE_OPTION(LEARNING)) &&
+        (ce->learning_ptr == NULL || memcmp(&ce->learning, &v->learning, sizeof(struct learningConfig)) != 0))
+    {
+        destroyLearningEngine(ce->learning_ptr);
+        ce->learning = v->learning;
+        ce->learning_ptr = createLearningEngine(ce);
     }
- 
-    unsigned int i;
+} // End applyCEConfigOptions()
 
-    // allocate array for output samples
-    std::complex<float> * y = (std::complex<float> *) malloc(buffer_len*sizeof(std::complex<float>));
-    // generate Doppler filter coefficients
-    float h[h_len];
-    liquid_firdes_doppler(h_len, fd, K, theta, h);
+int readCEConfigFile(struct CognitiveEngine * ce, char *current_cogengine_file, int verbose)
+{
+    struct ceConfigOptions opts;
+    int status = parseCEConfigFile(&opts, current_cogengine_file, verbose);
+    if (status != EX_OK)
+        exit(status);
+    applyCEConfigOptions(ce, &opts);
+    return 1;
+} // End readCEConfigFile()
 
-    // normalize filter coefficients such that output Gauss random
-    // variables have unity variance
-    float std = 0.0f;
-    for (i=0; i<h_len; i++)
-        std += h[i]*h[i];
-    std = sqrtf(std);
-    for (i=0; i<h_len; i++)
-        h[i] /= std;
+// The user engine file is parsed once and then only when it changes on disk.
+// Changes are noticed with inotify, or by polling the file's modification
+// time where inotify is not available.
+#define USER_ENGINE_FILE "userEngine.txt"
+
+struct userEngineCache {
+    int watching;                   // The watch below has been set up
+    int loaded;                     // options holds a valid version of the file
+    int inotifyFD;                  // -1 when polling the modification time. Set up with the watch.
+    struct timespec mtime;
+    struct ceConfigOptions options;
+};
 
-    // create Doppler filter from coefficients
-    firfilt_crcf fdoppler = firfilt_crcf_create(h,h_len);
+struct userEngineCache userEngine = {};
+pthread_mutex_t userEngineMutex = PTHREAD_MUTEX_INITIALIZER;
 
-    // generate complex circular Gauss random variables
-    std::complex<float> v;    // circular Gauss random variable (uncorrelated)
-    std::complex<float> x;    // circular Gauss random variable (correlated w/ Doppler filter)
-    float s   = sqrtf((omega*K)/(K+1.0));
-    float sig = sqrtf(0.5f*omega/(K+1.0));
-        
-    std::complex<float> tmp(0, 1);
-    for (i=0; i<buffer_len; i++) {
-        // generate complex Gauss random variable
-        crandnf(&v);
+// Modification time of the user engine file, or zero if it cannot be read
+struct timespec userEngineMTime()
+{
+    struct timespec t = {0, 0};
+    struct stat st;
+    if (stat("ceconfigs/" USER_ENGINE_FILE, &st) == 0)
+        t = st.st_mtim;
+    return t;
+} // End userEngineMTime()
+
+// Whether the user engine file has been written or replaced since the last call
+int userEngineChanged(struct userEngineCache * cache)
+{
+    if (cache->inotifyFD >= 0)
+    {
+        char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        int changed = 0;
+        ssize_t len;
+        while ((len = read(cache->inotifyFD, buf, sizeof(buf))) > 0)
+        {
+            for (char * p = buf; p < buf+len; p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len)
+            {
+                struct inotify_event * event = (struct inotify_event *) p;
+                if (event->len > 0 && strcmp(event->name, USER_ENGINE_FILE) == 0)
+                    changed = 1;
+            }
+        }
+        return changed;
+    }
+
+    struct timespec t = userEngineMTime();
+    if (t.tv_sec == cache->mtime.tv_sec && t.tv_nsec == cache->mtime.tv_nsec)
+        return 0;
+    cache->mtime = t;
+    return 1;
+} // End userEngineChanged()
+
+// Apply the current user engine options to a CE.
+// A new version of the file is parsed aside and only replaces the cached
+// options if it is valid, so a CE never sees a half written file. A version
+// that does not parse is reported and the last good options stay in use; if
+// there are none yet the CE keeps its current settings.
+void applyUserEngine(struct CognitiveEngine * ce, int verbose)
+{
+    pthread_mutex_lock(&userEngineMutex);
+    int reload = 0;
+    if (!userEngine.watching)
+    {
+        // Watch the directory, since editors often save by replacing the file
+        userEngine.inotifyFD = -1;
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd >= 0 && inotify_add_watch(fd, "ceconfigs", IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+            close(fd);
+        else
+            userEngine.inotifyFD = fd;
+        if (userEngine.inotifyFD < 0 && verbose)
+            printf("inotify unavailable. Polling %s for changes\n", USER_ENGINE_FILE);
+        userEngine.mtime = userEngineMTime();
+        userEngine.watching = 1;
+        reload = 1;
+    }
+    else if (userEngineChanged(&userEngine))
+        reload = 1;
+
+    if (reload)
+    {
+        struct ceConfigOptions options;
+        if (parseCEConfigFile(&options, USER_ENGINE_FILE, verbose) == EX_OK)
+        {
+            if (userEngine.loaded && verbose) printf("Reloaded %s\n", USER_ENGINE_FILE);
+            userEngine.options = options;
+            userEngine.loaded = 1;
+        }
+        else if (userEngine.loaded)
+            fprintf(stderr, "Warning: Keeping the previous settings from %s\n", USER_ENGINE_FILE);
+        else
+            fprintf(stderr, "Warning: No valid settings in %s yet. Keeping the current settings until it changes\n", USER_ENGINE_FILE);
+    }
+    if (userEngine.loaded)
+        applyCEConfigOptions(ce, &userEngine.options);
+    pthread_mutex_unlock(&userEngineMutex);
+} // End applyUserEngine()
+
+// Stop watching the user engine file and forget its options. The next CE
+// that uses it starts over with a fresh watch.
+void releaseUserEngine()
+{
+    pthread_mutex_lock(&userEngineMutex);
+    if (userEngine.watching && userEngine.inotifyFD >= 0)
+        close(userEngine.inotifyFD);
+    userEngine.inotifyFD = -1;
+    userEngine.watching = 0;
+    userEngine.loaded = 0;
+    pthread_mutex_unlock(&userEngineMutex);
+} // End releaseUserEngine()
+
+/////////////////////////////// Channel Models ///////////////////////////////////////////////
+
+// Advance one xorshift128+ stream
+static inline uint64_t xorshift128plus(uint64_t * s0, uint64_t * s1)
+{
+    uint64_t x = *s0;
+    uint64_t y = *s1;
+    *s0 = y;
+    x ^= x << 23;
+    *s1 = x ^ y ^ (x >> 17) ^ (y >> 26);
+    return *s1 + y;
+}
 
-        // push through Doppler filter
-        firfilt_crcf_push(fdoppler, v);
-        firfilt_crcf_execute(fdoppler, &x);
+// SplitMix64. Used to expand a single seed into generator state.
+static inline uint64_t splitmix64(uint64_t * x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
 
-        // convert result to random variable with Rice-K distribution
-        y[i] = tmp*( std::imag(x)*sig + s ) +
-                          ( std::real(x)*sig     );
+// Complex Gaussian sample with unit variance from one xorshift128+ stream.
+// Box-Muller from 24-bit uniforms u1 in (0,1] and u2 in [0,1).
+static inline std::complex<float> xorshiftCrandnf(uint64_t * s0, uint64_t * s1)
+{
+    uint64_t r = xorshift128plus(s0, s1);
+    float u1 = (float)((r >> 40) + 1) * (1.0f/16777216.0f);
+    float u2 = (float)((r >> 8) & 0xffffff) * (1.0f/16777216.0f);
+    float mag = sqrtf(-logf(u1));
+    float theta = 2.0f*(float)M_PI*u2;
+    return std::complex<float>(mag*cosf(theta), mag*sinf(theta));
+}
+
+void awgnChannel_init(struct awgnChannel * q, int kernel, float dphi)
+{
+    if (kernel == AWGN_KERNEL_AUTO)
+    {
+        kernel = AWGN_KERNEL_SCALAR;
+#ifdef CRTS_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            kernel = AWGN_KERNEL_AVX2;
+        else if (__builtin_cpu_supports("sse2"))
+            kernel = AWGN_KERNEL_SSE2;
+#endif
     }
-    for (i=0; i<buffer_len; i++) {
-        transmit_buffer[i] *= std::exp(tmp*phi);  // apply carrier offset
-        phi += dphi;                                  // update carrier phase
-        transmit_buffer[i] *= y[i];                   // apply Rice-K distribution
+#ifdef CRTS_X86_SIMD
+    __builtin_cpu_init();
+    if ((kernel == AWGN_KERNEL_AVX2 && !__builtin_cpu_supports("avx2")) ||
+        (kernel == AWGN_KERNEL_SSE2 && !__builtin_cpu_supports("sse2")))
+#else
+    if (kernel == AWGN_KERNEL_AVX2 || kernel == AWGN_KERNEL_SSE2)
+#endif
+    {
+        fprintf(stderr, "WARNING: Requested noiseKernel is not supported on this CPU. Using scalar kernel.\n");
+        kernel = AWGN_KERNEL_SCALAR;
     }
+    q->kernel = kernel;
 
-    // destroy filter object
-    firfilt_crcf_destroy(fdoppler);
+    // Seed every lane from the C PRNG so that runs still follow srand()
+    // (or the worker's seed in a parallel run)
+    uint64_t seed = ((uint64_t)crtsRand() << 32) ^ (uint64_t)crtsRand();
+    for (int i=0; i<4; i++)
+    {
+        q->rng0[i] = splitmix64(&seed);
+        q->rng1[i] = splitmix64(&seed);
+    }
 
-    // clean up allocated array
-    free(y);
-} // End enactRicianFadingBaseband()
+    q->phasor[0] = 1.0f;
+    q->phasor[1] = 0.0f;
+    q->step[0] = (float)cos((double)dphi);
+    q->step[1] = (float)sin((double)dphi);
+    q->phi = 0.0f;
+} // End awgnChannel_init()
 
-//TODO: enable starting of this thread when a new scenario begins
-// This function runs in its own thread waiting to modify the samples every time
-// they are recieve by the ofdmtxrx object, but before they are sent to the
-// synchronizer. 
-void * enactScenarioBasebandRx( void * _arg)
+// Rotate by the carrier phasor and add complex Gaussian noise with standard
+// deviation nstd, one sample at a time. Also finishes the tails of the SIMD kernels.
+void awgnChannel_executeScalar(struct awgnChannel * q, std::complex<float> * x, unsigned int n, float nstd)
+{
+    float k  = nstd*(float)M_SQRT1_2;
+    float pr = q->phasor[0], pi = q->phasor[1];
+    float wr = q->step[0],   wi = q->step[1];
+
+    for (unsigned int i=0; i<n; i++)
+    {
+        // Box-Muller from 24-bit uniforms u1 in (0,1] and u2 in [0,1)
+        uint64_t r = xorshift128plus(&q->rng0[0], &q->rng1[0]);
+        float u1 = (float)((r >> 40) + 1) * (1.0f/16777216.0f);
+        float u2 = (float)((r >> 8) & 0xffffff) * (1.0f/16777216.0f);
+        float mag = k*sqrtf(-2.0f*logf(u1));
+        float theta = 2.0f*(float)M_PI*u2;
+
+        float xr = x[i].real(), xi = x[i].imag();
+        x[i] = std::complex<float>(xr*pr - xi*pi + mag*cosf(theta),
+                                   xr*pi + xi*pr + mag*sinf(theta));
+
+        // Advance the carrier phasor and periodically pull it back onto the unit circle
+        float t = pr*wr - pi*wi;
+        pi = pr*wi + pi*wr;
+        pr = t;
+        if ((i & 63) == 63)
+        {
+            float g = 1.5f - 0.5f*(pr*pr + pi*pi);
+            pr *= g;
+            pi *= g;
+        }
+    }
+
+    float g = 1.5f - 0.5f*(pr*pr + pi*pi);
+    q->phasor[0] = pr*g;
+    q->phasor[1] = pi*g;
+} // End awgnChannel_executeScalar()
+
+#ifdef CRTS_X86_SIMD
+// The SIMD kernels generate noise with the Box-Muller transform on a reduced
+// angle in [-pi/4,pi/4) followed by a random signed permutation of (cos,sin),
+// which is uniform over the circle. This keeps sin/cos and log down to short
+// polynomials (cephes logf) without any range reduction.
+#define AWGN_LOG_P0  7.0376836292E-2f
+#define AWGN_LOG_P1 -1.1514610310E-1f
+#define AWGN_LOG_P2  1.1676998740E-1f
+#define AWGN_LOG_P3 -1.2420140846E-1f
+#define AWGN_LOG_P4  1.4249322787E-1f
+#define AWGN_LOG_P5 -1.6668057665E-1f
+#define AWGN_LOG_P6  2.0000714765E-1f
+#define AWGN_LOG_P7 -2.4999993993E-1f
+#define AWGN_LOG_P8  3.3333331174E-1f
+#define AWGN_LOG_Q1 -2.12194440E-4f
+#define AWGN_LOG_Q2  0.693359375f
+
+__attribute__((target("sse2")))
+static inline __m128i xorshift128plus_sse2(__m128i * s0, __m128i * s1)
+{
+    __m128i x = *s0;
+    __m128i y = *s1;
+    *s0 = y;
+    x = _mm_xor_si128(x, _mm_slli_epi64(x, 23));
+    *s1 = _mm_xor_si128(_mm_xor_si128(x, y), _mm_xor_si128(_mm_srli_epi64(x, 17), _mm_srli_epi64(y, 26)));
+    return _mm_add_epi64(*s1, y);
+}
+
+// Natural log of normalized, positive floats
+__attribute__((target("sse2")))
+static inline __m128 log_sse2(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128i xi = _mm_castps_si128(x);
+    __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(xi, 23), _mm_set1_epi32(126)));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(xi, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f000000)));
+    __m128 mask = _mm_cmplt_ps(m, _mm_set1_ps((float)M_SQRT1_2));
+    __m128 tmp = _mm_and_ps(m, mask);
+    m = _mm_sub_ps(m, one);
+    e = _mm_sub_ps(e, _mm_and_ps(one, mask));
+    m = _mm_add_ps(m, tmp);
+    __m128 z = _mm_mul_ps(m, m);
+    __m128 y = _mm_set1_ps(AWGN_LOG_P0);
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P1));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P2));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P3));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P4));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P5));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P6));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P7));
+    y = _mm_add_ps(_mm_mul_ps(y, m), _mm_set1_ps(AWGN_LOG_P8));
+    y = _mm_mul_ps(_mm_mul_ps(y, m), z);
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(AWGN_LOG_Q1)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    return _mm_add_ps(_mm_add_ps(m, y), _mm_mul_ps(e, _mm_set1_ps(AWGN_LOG_Q2)));
+}
+
+// Four complex Gaussian samples (two per register) scaled by k
+__attribute__((target("sse2")))
+static inline void cgauss_sse2(__m128i * s0, __m128i * s1, __m128 k, __m128 * lo, __m128 * hi)
+{
+    const __m128i exp_one = _mm_set1_epi32(0x3f800000);
+    __m128i a = xorshift128plus_sse2(s0, s1);
+    __m128i b = xorshift128plus_sse2(s0, s1);
+
+    // u1 in (0,1] and phi in [-pi/4,pi/4)
+    __m128 u1  = _mm_sub_ps(_mm_set1_ps(2.0f), _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(a, 9), exp_one)));
+    __m128 phi = _mm_mul_ps(_mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(b, 9), exp_one)), _mm_set1_ps(1.5f)),
+                            _mm_set1_ps((float)M_PI_2));
+    __m128 r = _mm_mul_ps(k, _mm_sqrt_ps(_mm_max_ps(_mm_mul_ps(_mm_set1_ps(-2.0f), log_sse2(u1)), _mm_setzero_ps())));
+
+    __m128 p2 = _mm_mul_ps(phi, phi);
+    __m128 s = _mm_set1_ps(-1.0f/5040.0f);
+    s = _mm_add_ps(_mm_mul_ps(s, p2), _mm_set1_ps(1.0f/120.0f));
+    s = _mm_add_ps(_mm_mul_ps(s, p2), _mm_set1_ps(-1.0f/6.0f));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, p2), phi), phi);
+    __m128 c = _mm_set1_ps(1.0f/40320.0f);
+    c = _mm_add_ps(_mm_mul_ps(c, p2), _mm_set1_ps(-1.0f/720.0f));
+    c = _mm_add_ps(_mm_mul_ps(c, p2), _mm_set1_ps(1.0f/24.0f));
+    c = _mm_add_ps(_mm_mul_ps(c, p2), _mm_set1_ps(-0.5f));
+    c = _mm_add_ps(_mm_mul_ps(c, p2), _mm_set1_ps(1.0f));
+
+    // Random signed permutation from the low bits of b
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(b, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 re = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+    __m128 im = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+    re = _mm_xor_ps(re, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(b, _mm_set1_epi32(2)), 30)));
+    im = _mm_xor_ps(im, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(b, _mm_set1_epi32(4)), 29)));
+    re = _mm_mul_ps(re, r);
+    im = _mm_mul_ps(im, r);
+
+    *lo = _mm_unpacklo_ps(re, im);
+    *hi = _mm_unpackhi_ps(re, im);
+}
+
+// Multiply interleaved complex values
+__attribute__((target("sse2")))
+static inline __m128 cmul_sse2(__m128 a, __m128 b)
+{
+    const __m128 sign_even = _mm_set_ps(0.0f, -0.0f, 0.0f, -0.0f);
+    __m128 b_re = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,2,0,0));
+    __m128 b_im = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3,3,1,1));
+    __m128 a_sw = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+    return _mm_add_ps(_mm_mul_ps(a, b_re), _mm_xor_ps(_mm_mul_ps(a_sw, b_im), sign_even));
+}
+
+// Scale interleaved complex values back to unit magnitude (one Newton step)
+__attribute__((target("sse2")))
+static inline __m128 cnormalize_sse2(__m128 p)
+{
+    __m128 sq = _mm_mul_ps(p, p);
+    __m128 m2 = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2,3,0,1)));
+    return _mm_mul_ps(p, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_set1_ps(0.5f), m2)));
+}
+
+__attribute__((target("sse2")))
+void awgnChannel_executeSSE2(struct awgnChannel * q, std::complex<float> * x, unsigned int n, float nstd)
+{
+    std::complex<float> p(q->phasor[0], q->phasor[1]);
+    std::complex<float> w(q->step[0], q->step[1]);
+    std::complex<float> pw = p*w;
+    std::complex<float> w2 = w*w;
+
+    __m128 P  = _mm_set_ps(pw.imag(), pw.real(), p.imag(), p.real());
+    __m128 W2 = _mm_set_ps(w2.imag(), w2.real(), w2.imag(), w2.real());
+    __m128 k  = _mm_set1_ps(nstd*(float)M_SQRT1_2);
+    __m128i s0 = _mm_loadu_si128((__m128i *)q->rng0);
+    __m128i s1 = _mm_loadu_si128((__m128i *)q->rng1);
+    __m128 lo, hi;
+
+    unsigned int i;
+    for (i=0; i+4<=n; i+=4)
+    {
+        cgauss_sse2(&s0, &s1, k, &lo, &hi);
+        float * xf = (float *)&x[i];
+        _mm_storeu_ps(xf,   _mm_add_ps(cmul_sse2(_mm_loadu_ps(xf),   P), lo));
+        P = cmul_sse2(P, W2);
+        _mm_storeu_ps(xf+4, _mm_add_ps(cmul_sse2(_mm_loadu_ps(xf+4), P), hi));
+        P = cmul_sse2(P, W2);
+        if ((i & 63) == 60)
+            P = cnormalize_sse2(P);
+    }
+    P = cnormalize_sse2(P);
+
+    _mm_storeu_si128((__m128i *)q->rng0, s0);
+    _mm_storeu_si128((__m128i *)q->rng1, s1);
+    _mm_storel_pi((__m64 *)q->phasor, P);
+
+    awgnChannel_executeScalar(q, x+i, n-i, nstd);
+} // End awgnChannel_executeSSE2()
+
+__attribute__((target("avx2")))
+static inline __m256i xorshift128plus_avx2(__m256i * s0, __m256i * s1)
+{
+    __m256i x = *s0;
+    __m256i y = *s1;
+    *s0 = y;
+    x = _mm256_xor_si256(x, _mm256_slli_epi64(x, 23));
+    *s1 = _mm256_xor_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(_mm256_srli_epi64(x, 17), _mm256_srli_epi64(y, 26)));
+    return _mm256_add_epi64(*s1, y);
+}
+
+// Natural log of normalized, positive floats
+__attribute__((target("avx2")))
+static inline __m256 log_avx2(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256i xi = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(xi, 23), _mm256_set1_epi32(126)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(xi, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f000000)));
+    __m256 mask = _mm256_cmp_ps(m, _mm256_set1_ps((float)M_SQRT1_2), _CMP_LT_OQ);
+    __m256 tmp = _mm256_and_ps(m, mask);
+    m = _mm256_sub_ps(m, one);
+    e = _mm256_sub_ps(e, _mm256_and_ps(one, mask));
+    m = _mm256_add_ps(m, tmp);
+    __m256 z = _mm256_mul_ps(m, m);
+    __m256 y = _mm256_set1_ps(AWGN_LOG_P0);
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P1));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P2));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P3));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P4));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P5));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P6));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P7));
+    y = _mm256_add_ps(_mm256_mul_ps(y, m), _mm256_set1_ps(AWGN_LOG_P8));
+    y = _mm256_mul_ps(_mm256_mul_ps(y, m), z);
+    y = _mm256_add_ps(y, _mm256_mul_ps(e, _mm256_set1_ps(AWGN_LOG_Q1)));
+    y = _mm256_sub_ps(y, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+    return _mm256_add_ps(_mm256_add_ps(m, y), _mm256_mul_ps(e, _mm256_set1_ps(AWGN_LOG_Q2)));
+}
+
+// Eight complex Gaussian samples (four per register) scaled by k
+__attribute__((target("avx2")))
+static inline void cgauss_avx2(__m256i * s0, __m256i * s1, __m256 k, __m256 * lo, __m256 * hi)
+{
+    const __m256i exp_one = _mm256_set1_epi32(0x3f800000);
+    __m256i a = xorshift128plus_avx2(s0, s1);
+    __m256i b = xorshift128plus_avx2(s0, s1);
+
+    // u1 in (0,1] and phi in [-pi/4,pi/4)
+    __m256 u1  = _mm256_sub_ps(_mm256_set1_ps(2.0f), _mm256_castsi256_ps(_mm256_or_si256(_mm256_srli_epi32(a, 9), exp_one)));
+    __m256 phi = _mm256_mul_ps(_mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_srli_epi32(b, 9), exp_one)), _mm256_set1_ps(1.5f)),
+                               _mm256_set1_ps((float)M_PI_2));
+    __m256 r = _mm256_mul_ps(k, _mm256_sqrt_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), log_avx2(u1)), _mm256_setzero_ps())));
+
+    __m256 p2 = _mm256_mul_ps(phi, phi);
+    __m256 s = _mm256_set1_ps(-1.0f/5040.0f);
+    s = _mm256_add_ps(_mm256_mul_ps(s, p2), _mm256_set1_ps(1.0f/120.0f));
+    s = _mm256_add_ps(_mm256_mul_ps(s, p2), _mm256_set1_ps(-1.0f/6.0f));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, p2), phi), phi);
+    __m256 c = _mm256_set1_ps(1.0f/40320.0f);
+    c = _mm256_add_ps(_mm256_mul_ps(c, p2), _mm256_set1_ps(-1.0f/720.0f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, p2), _mm256_set1_ps(1.0f/24.0f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, p2), _mm256_set1_ps(-0.5f));
+    c = _mm256_add_ps(_mm256_mul_ps(c, p2), _mm256_set1_ps(1.0f));
+
+    // Random signed permutation from the low bits of b
+    __m256 swap = _mm256_castsi256_ps(_mm256_slli_epi32(b, 31));
+    __m256 re = _mm256_blendv_ps(c, s, swap);
+    __m256 im = _mm256_blendv_ps(s, c, swap);
+    re = _mm256_xor_ps(re, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(b, _mm256_set1_epi32(2)), 30)));
+    im = _mm256_xor_ps(im, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(b, _mm256_set1_epi32(4)), 29)));
+    re = _mm256_mul_ps(re, r);
+    im = _mm256_mul_ps(im, r);
+
+    *lo = _mm256_unpacklo_ps(re, im);
+    *hi = _mm256_unpackhi_ps(re, im);
+}
+
+// Multiply interleaved complex values
+__attribute__((target("avx2")))
+static inline __m256 cmul_avx2(__m256 a, __m256 b)
+{
+    __m256 a_sw = _mm256_permute_ps(a, 0xB1);
+    return _mm256_addsub_ps(_mm256_mul_ps(a, _mm256_moveldup_ps(b)), _mm256_mul_ps(a_sw, _mm256_movehdup_ps(b)));
+}
+
+// Scale interleaved complex values back to unit magnitude (one Newton step)
+__attribute__((target("avx2")))
+static inline __m256 cnormalize_avx2(__m256 p)
+{
+    __m256 sq = _mm256_mul_ps(p, p);
+    __m256 m2 = _mm256_add_ps(sq, _mm256_permute_ps(sq, 0xB1));
+    return _mm256_mul_ps(p, _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_set1_ps(0.5f), m2)));
+}
+
+__attribute__((target("avx2")))
+void awgnChannel_executeAVX2(struct awgnChannel * q, std::complex<float> * x, unsigned int n, float nstd)
+{
+    std::complex<float> p0(q->phasor[0], q->phasor[1]);
+    std::complex<float> w(q->step[0], q->step[1]);
+    std::complex<float> p1 = p0*w;
+    std::complex<float> p2 = p1*w;
+    std::complex<float> p3 = p2*w;
+    std::complex<float> w4 = (w*w)*(w*w);
+
+    __m256 P  = _mm256_set_ps(p3.imag(), p3.real(), p2.imag(), p2.real(), p1.imag(), p1.real(), p0.imag(), p0.real());
+    __m256 W4 = _mm256_set_ps(w4.imag(), w4.real(), w4.imag(), w4.real(), w4.imag(), w4.real(), w4.imag(), w4.real());
+    __m256 k  = _mm256_set1_ps(nstd*(float)M_SQRT1_2);
+    __m256i s0 = _mm256_loadu_si256((__m256i *)q->rng0);
+    __m256i s1 = _mm256_loadu_si256((__m256i *)q->rng1);
+    __m256 lo, hi;
+
+    unsigned int i;
+    for (i=0; i+8<=n; i+=8)
+    {
+        cgauss_avx2(&s0, &s1, k, &lo, &hi);
+        float * xf = (float *)&x[i];
+        _mm256_storeu_ps(xf,   _mm256_add_ps(cmul_avx2(_mm256_loadu_ps(xf),   P), lo));
+        P = cmul_avx2(P, W4);
+        _mm256_storeu_ps(xf+8, _mm256_add_ps(cmul_avx2(_mm256_loadu_ps(xf+8), P), hi));
+        P = cmul_avx2(P, W4);
+        if ((i & 63) == 56)
+            P = cnormalize_avx2(P);
+    }
+    P = cnormalize_avx2(P);
+
+    _mm256_storeu_si256((__m256i *)q->rng0, s0);
+    _mm256_storeu_si256((__m256i *)q->rng1, s1);
+    _mm_storel_pi((__m64 *)q->phasor, _mm256_castps256_ps128(P));
+
+    awgnChannel_executeScalar(q, x+i, n-i, nstd);
+} // End awgnChannel_executeAVX2()
+#endif
+
+void awgnChannel_execute(struct awgnChannel * q, std::complex<float> * x, unsigned int n, float nstd)
+{
+    switch (q->kernel)
+    {
+#ifdef CRTS_X86_SIMD
+    case AWGN_KERNEL_AVX2:  awgnChannel_executeAVX2(q, x, n, nstd);     break;
+    case AWGN_KERNEL_SSE2:  awgnChannel_executeSSE2(q, x, n, nstd);     break;
+#endif
+    default:                awgnChannel_executeScalar(q, x, n, nstd);   break;
+    }
+} // End awgnChannel_execute()
+
+void ricianChannel_init(struct ricianChannel * q, float K, float fd, float dphi, int h_len)
+{
+    float omega = 1.0f;         // mean power
+    float theta = 0.0f;         // angle of arrival
+    unsigned int i;
+
+    // validate input
+    if (K < 1.5f) {
+        fprintf(stderr, "error: fading factor K must be greater than 1.5\n");
+        exit(1);
+    } else if (fd <= 0.0f || fd >= 0.5f) {
+        fprintf(stderr, "error: Doppler frequency must be in (0,0.5)\n");
+        exit(1);
+    } else if (h_len < 0) {
+        fprintf(stderr, "error: Doppler filter length must not be negative\n");
+        exit(1);
+    }
+
+    // The filter has to span a few periods of the maximum Doppler frequency
+    // to shape the spectrum, independent of how many samples are processed per call.
+    if (h_len == 0)
+    {
+        h_len = (int)ceilf(3.0f/fd);
+        if (h_len < 16)   h_len = 16;
+        if (h_len > 1024) h_len = 1024;
+    }
+
+    // The scattered component comes from the channel's own generator so that
+    // parallel runs neither share the C PRNG nor depend on scheduling
+    uint64_t seed = ((uint64_t)crtsRand() << 32) ^ (uint64_t)crtsRand();
+    q->rng0 = splitmix64(&seed);
+    q->rng1 = splitmix64(&seed);
+    q->h_len = h_len;
+
+    // generate Doppler filter coefficients
+    float * h = (float *) malloc(q->h_len*sizeof(float));
+    liquid_firdes_doppler(q->h_len, fd, K, theta, h);
+
+    // normalize filter coefficients such that output Gauss random
+    // variables have unity variance
+    float std = 0.0f;
+    for (i=0; i<q->h_len; i++)
+        std += h[i]*h[i];
+    std = sqrtf(std);
+    for (i=0; i<q->h_len; i++)
+        h[i] /= std;
+
+    // create Doppler filter from coefficients
+    q->fdoppler = firfilt_crcf_create(h, q->h_len);
+    free(h);
+
+    // Fill the filter so the first samples already see a stationary process
+    std::complex<float> v;
+    for (i=0; i<q->h_len; i++)
+    {
+        v = xorshiftCrandnf(&q->rng0, &q->rng1);
+        firfilt_crcf_push(q->fdoppler, v);
+    }
+
+    q->s   = sqrtf((omega*K)/(K+1.0));
+    q->sig = sqrtf(0.5f*omega/(K+1.0));
+    q->phasor[0] = 1.0f;
+    q->phasor[1] = 0.0f;
+    q->step[0] = (float)cos((double)dphi);
+    q->step[1] = (float)sin((double)dphi);
+} // End ricianChannel_init()
+
+void ricianChannel_destroy(struct ricianChannel * q)
+{
+    if (q->fdoppler != NULL)
+        firfilt_crcf_destroy(q->fdoppler);
+    q->fdoppler = NULL;
+} // End ricianChannel_destroy()
+
+// Apply the carrier offset and Rice-K fading to n samples in place
+void ricianChannel_execute(struct ricianChannel * q, std::complex<float> * x, unsigned int n)
+{
+    std::complex<float> v;    // circular Gauss random variable (uncorrelated)
+    std::complex<float> g;    // circular Gauss random variable (correlated w/ Doppler filter)
+    float pr = q->phasor[0], pi = q->phasor[1];
+    float wr = q->step[0],   wi = q->step[1];
+
+    for (unsigned int i=0; i<n; i++)
+    {
+        // generate complex Gauss random variable and push through Doppler filter
+        v = xorshiftCrandnf(&q->rng0, &q->rng1);
+        firfilt_crcf_push(q->fdoppler, v);
+        firfilt_crcf_execute(q->fdoppler, &g);
+
+        // convert result to random variable with Rice-K distribution
+        std::complex<float> h(std::real(g)*q->sig, std::imag(g)*q->sig + q->s);
+
+        // apply carrier offset and fading
+        x[i] *= std::complex<float>(pr, pi)*h;
+
+        // update carrier phase
+        float t = pr*wr - pi*wi;
+        pi = pr*wi + pi*wr;
+        pr = t;
+    }
+
+    float m = 1.5f - 0.5f*(pr*pr + pi*pi);
+    q->phasor[0] = pr*m;
+    q->phasor[1] = pi*m;
+} // End ricianChannel_execute()
+
+void cwTone_init(struct cwTone * q, float pow, float freq)
+{
+    q->pow  = pow;
+    q->freq = freq;
+    q->amp  = powf(10.0f, pow/20.0f);
+    q->fs   = 0.0f;
+    q->phasor[0] = 1.0f;
+    q->phasor[1] = 0.0f;
+    q->step[0] = 1.0f;
+    q->step[1] = 0.0f;
+} // End cwTone_init()
+
+// Add the tone to n samples taken at rate fs.
+// Four phasors are advanced in parallel so the loop has no serial dependency.
+void cwTone_execute(struct cwTone * q, std::complex<float> * x, unsigned int n, float fs)
+{
+    unsigned int i, j;
+
+    // The step only changes with the sample rate; the phase is kept
+    if (fs != q->fs)
+    {
+        double dphi = 2.0*M_PI*(double)q->freq/(double)fs;
+        q->step[0] = (float)cos(dphi);
+        q->step[1] = (float)sin(dphi);
+        q->fs = fs;
+    }
+
+    std::complex<float> w(q->step[0], q->step[1]);
+    std::complex<float> w4 = (w*w)*(w*w);
+    std::complex<float> p[4];
+    float amp = q->amp;
+    p[0] = std::complex<float>(q->phasor[0], q->phasor[1]);
+    for (j=1; j<4; j++)
+        p[j] = p[j-1]*w;
+
+    for (i=0; i+4<=n; i+=4)
+    {
+        for (j=0; j<4; j++)
+        {
+            x[i+j] += amp*p[j];
+            p[j] *= w4;
+        }
+    }
+    std::complex<float> pn = p[0];
+    for (j=0; i<n; i++, j++)
+    {
+        x[i] += amp*p[j];
+        pn = p[j]*w;
+    }
+
+    // Pull the phasor back onto the unit circle
+    float m = 1.5f - 0.5f*std::norm(pn);
+    q->phasor[0] = pn.real()*m;
+    q->phasor[1] = pn.imag()*m;
+} // End cwTone_execute()
+
+// Standard power-delay profiles (3GPP TS 36.104 Annex B.2)
+struct multipathProfile {
+    const char * name;
+    int num_taps;
+    float delay_ns[9];
+    float power_dB[9];
+};
+
+static const struct multipathProfile multipathProfiles[] = {
+    {"EPA", 7, {0, 30, 70, 90, 110, 190, 410},
+               {0.0f, -1.0f, -2.0f, -3.0f, -8.0f, -17.2f, -20.8f}},
+    {"EVA", 9, {0, 30, 150, 310, 370, 710, 1090, 1730, 2510},
+               {0.0f, -1.5f, -1.4f, -3.6f, -0.6f, -9.1f, -7.0f, -12.0f, -16.9f}},
+    {"ETU", 9, {0, 50, 120, 200, 230, 500, 1600, 2300, 5000},
+               {-1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 0.0f, -3.0f, -5.0f, -7.0f}},
+};
+
+// Load a standard power-delay profile by name. Returns 0 if the name is unknown.
+int multipathChannel_setProfile(struct multipathChannel * q, const char * name)
+{
+    for (unsigned int p=0; p<sizeof(multipathProfiles)/sizeof(multipathProfiles[0]); p++)
+    {
+        if (strcmp(name, multipathProfiles[p].name) == 0)
+        {
+            q->num_taps = multipathProfiles[p].num_taps;
+            for (int i=0; i<q->num_taps; i++)
+            {
+                q->tap_delay_ns[i] = multipathProfiles[p].delay_ns[i];
+                q->tap_power_dB[i] = multipathProfiles[p].power_dB[i];
+            }
+            return 1;
+        }
+    }
+    return 0;
+} // End multipathChannel_setProfile()
+
+void multipathChannel_init(struct multipathChannel * q)
+{
+    int M = MULTIPATH_NUM_SINUSOIDS;
+
+    // validate input
+    if (q->num_taps < 1) {
+        fprintf(stderr, "error: multipath channel needs a multipathProfile\n");
+        exit(1);
+    } else if (q->fd < 0.0f || q->fd >= 0.5f) {
+        fprintf(stderr, "error: multipath Doppler frequency must be in [0,0.5)\n");
+        exit(1);
+    }
+
+    // Random angles of arrival and phases for each tap's Doppler process
+    for (int k=0; k<q->num_taps; k++)
+    {
+        float theta = 2.0f*(float)M_PI*((float)crtsRand()/(float)RAND_MAX) - (float)M_PI;
+        for (int n=0; n<M; n++)
+        {
+            float alpha = (2.0f*(float)M_PI*(n+1) - (float)M_PI + theta)/(4.0f*M);
+            q->sos_freq_i[k][n]  = 2.0f*(float)M_PI*q->fd*cosf(alpha);
+            q->sos_freq_q[k][n]  = 2.0f*(float)M_PI*q->fd*sinf(alpha);
+            q->sos_phase_i[k][n] = 2.0f*(float)M_PI*((float)crtsRand()/(float)RAND_MAX);
+            q->sos_phase_q[k][n] = 2.0f*(float)M_PI*((float)crtsRand()/(float)RAND_MAX);
+        }
+    }
+    q->t = 0.0;
+    q->update_left = 0;
+
+    // Everything that depends on the sample rate is built on first use
+    q->fs = 0.0f;
+    q->h_len = 0;
+    q->h = q->history = q->work = NULL;
+    q->nfft = 0;
+    q->fft_x = q->fft_X = q->fft_h = q->fft_H = q->fft_y = NULL;
+    q->plan_x = q->plan_h = q->plan_y = NULL;
+} // End multipathChannel_init()
+
+// Release the buffers that were built for a sample rate
+void multipathChannel_destroy(struct multipathChannel * q)
+{
+    if (q->nfft > 0)
+    {
+        pthread_mutex_lock(&liquidCreateMutex);
+        fft_destroy_plan(q->plan_x);
+        fft_destroy_plan(q->plan_h);
+        fft_destroy_plan(q->plan_y);
+        pthread_mutex_unlock(&liquidCreateMutex);
+        free(q->fft_x);
+        free(q->fft_X);
+        free(q->fft_h);
+        free(q->fft_H);
+        free(q->fft_y);
+    }
+    free(q->h);
+    free(q->history);
+    free(q->work);
+    q->h = q->history = q->work = NULL;
+    q->fft_x = q->fft_X = q->fft_h = q->fft_H = q->fft_y = NULL;
+    q->nfft = 0;
+    q->h_len = 0;
+    q->fs = 0.0f;
+    q->update_left = 0;
+} // End multipathChannel_destroy()
+
+// Estimated operations to convolve a block of len samples with an nfft point
+// overlap-save FFT. The transform of the response is counted as spread over
+// the samples between tap updates.
+static inline float multipathFFTCost(unsigned int nfft, unsigned int len)
+{
+    float fft = 5.0f*nfft*log2f((float)nfft);
+    return (2.0f + (float)len/MULTIPATH_UPDATE_LEN)*fft + 6.0f*nfft;
+}
+
+// Convert the profile to sample delays and allocate the convolution buffers for rate fs
+void multipathChannel_build(struct multipathChannel * q, float fs)
+{
+    multipathChannel_destroy(q);
+    q->fs = fs;
+
+    float total = 0.0f;
+    unsigned int max_delay = 0;
+    for (int k=0; k<q->num_taps; k++)
+    {
+        q->tap_delay[k] = (unsigned int)lroundf(q->tap_delay_ns[k]*1e-9f*fs);
+        q->tap_gain[k] = powf(10.0f, q->tap_power_dB[k]/10.0f);
+        total += q->tap_gain[k];
+        if (q->tap_delay[k] > max_delay) max_delay = q->tap_delay[k];
+    }
+    for (int k=0; k<q->num_taps; k++)
+        q->tap_gain[k] = sqrtf(q->tap_gain[k]/total);
+
+    // Taps that share a delay are one term of the direct form
+    q->direct_taps = 0;
+    for (int k=0; k<q->num_taps; k++)
+    {
+        int seen = 0;
+        for (int j=0; j<k; j++)
+            seen |= q->tap_delay[j] == q->tap_delay[k];
+        q->direct_taps += !seen;
+    }
+
+    q->h_len = max_delay + 1;
+    q->h = (std::complex<float> *) calloc(q->h_len, sizeof(std::complex<float>));
+    q->history = (std::complex<float> *) calloc(q->h_len, sizeof(std::complex<float>));
+    q->work = (std::complex<float> *) calloc(q->h_len-1 + IMPAIRMENT_BLOCK_LEN, sizeof(std::complex<float>));
+
+    // A whole block and the history fit into one FFT. Its plans are only
+    // built if a full block would be cheaper through them than directly.
+    unsigned int nfft = 64;
+    while (nfft < max_delay + IMPAIRMENT_BLOCK_LEN)
+        nfft *= 2;
+    if (max_delay > q->fft_threshold &&
+        multipathFFTCost(nfft, IMPAIRMENT_BLOCK_LEN) < 8.0f*q->direct_taps*IMPAIRMENT_BLOCK_LEN)
+    {
+        q->nfft = nfft;
+        q->fft_x = (std::complex<float> *) calloc(q->nfft, sizeof(std::complex<float>));
+        q->fft_X = (std::complex<float> *) calloc(q->nfft, sizeof(std::complex<float>));
+        q->fft_h = (std::complex<float> *) calloc(q->nfft, sizeof(std::complex<float>));
+        q->fft_H = (std::complex<float> *) calloc(q->nfft, sizeof(std::complex<float>));
+        q->fft_y = (std::complex<float> *) calloc(q->nfft, sizeof(std::complex<float>));
+        pthread_mutex_lock(&liquidCreateMutex);
+        q->plan_x = fft_create_plan(q->nfft, q->fft_x, q->fft_X, LIQUID_FFT_FORWARD, 0);
+        q->plan_h = fft_create_plan(q->nfft, q->fft_h, q->fft_H, LIQUID_FFT_FORWARD, 0);
+        q->plan_y = fft_create_plan(q->nfft, q->fft_X, q->fft_y, LIQUID_FFT_BACKWARD, 0);
+        pthread_mutex_unlock(&liquidCreateMutex);
+    }
+    q->H_valid = 0;
+} // End multipathChannel_build()
+
+// Evaluate every tap's Doppler process at time t and form the impulse response
+void multipathChannel_updateTaps(struct multipathChannel * q, double t)
+{
+    float scale = sqrtf(1.0f/MULTIPATH_NUM_SINUSOIDS);
+    std::fill(q->h, q->h+q->h_len, std::complex<float>(0.0f, 0.0f));
+    for (int k=0; k<q->num_taps; k++)
+    {
+        float gi = 0.0f, gq = 0.0f;
+        for (int n=0; n<MULTIPATH_NUM_SINUSOIDS; n++)
+        {
+            gi += cosf((float)fmod(q->sos_freq_i[k][n]*t, 2.0*M_PI) + q->sos_phase_i[k][n]);
+            gq += cosf((float)fmod(q->sos_freq_q[k][n]*t, 2.0*M_PI) + q->sos_phase_q[k][n]);
+        }
+        q->h[q->tap_delay[k]] += q->tap_gain[k]*scale*std::complex<float>(gi, gq);
+    }
+} // End multipathChannel_updateTaps()
+
+// Whether FFT convolution of a block of len samples takes fewer operations
+// than the direct form, which costs 8 flops per non-zero tap and sample
+static inline int multipathChannel_useFFT(const struct multipathChannel * q, unsigned int len)
+{
+    return q->nfft > 0 && multipathFFTCost(q->nfft, len) < 8.0f*q->direct_taps*len;
+}
+
+// Pass n samples through the channel in place. The taps are held constant
+// between updates, which happen every MULTIPATH_UPDATE_LEN samples however
+// the samples are split into calls.
+void multipathChannel_execute(struct multipathChannel * q, std::complex<float> * x, unsigned int n, float fs)
+{
+    if (fs != q->fs)
+        multipathChannel_build(q, fs);
+
+    unsigned int mem = q->h_len-1;
+
+    for (unsigned int i=0, len; i<n; i+=len)
+    {
+        if (q->update_left == 0)
+        {
+            multipathChannel_updateTaps(q, q->t + 0.5*MULTIPATH_UPDATE_LEN);
+            q->update_left = MULTIPATH_UPDATE_LEN;
+            q->H_valid = 0;
+        }
+        len = n-i < q->update_left ? n-i : q->update_left;
+        std::complex<float> * xc = x+i;
+        q->t += len;
+        q->update_left -= len;
+
+        if (multipathChannel_useFFT(q, len))
+        {
+            // Overlap-save: [history, block, zeros] -> the valid outputs start at index mem
+            memcpy(q->fft_x, q->history, mem*sizeof(std::complex<float>));
+            memcpy(q->fft_x+mem, xc, len*sizeof(std::complex<float>));
+            std::fill(q->fft_x+mem+len, q->fft_x+q->nfft, std::complex<float>(0.0f, 0.0f));
+
+            // Keep the tail of the input for the next block
+            memcpy(q->history, q->fft_x+len, mem*sizeof(std::complex<float>));
+
+            // The response is transformed once per tap update
+            if (!q->H_valid)
+            {
+                memcpy(q->fft_h, q->h, q->h_len*sizeof(std::complex<float>));
+                std::fill(q->fft_h+q->h_len, q->fft_h+q->nfft, std::complex<float>(0.0f, 0.0f));
+                fft_execute(q->plan_h);
+                float norm = 1.0f/(float)q->nfft;
+                for (unsigned int k=0; k<q->nfft; k++)
+                    q->fft_H[k] *= norm;
+                q->H_valid = 1;
+            }
+
+            fft_execute(q->plan_x);
+            for (unsigned int k=0; k<q->nfft; k++)
+                q->fft_X[k] *= q->fft_H[k];
+            fft_execute(q->plan_y);
+
+            memcpy(xc, q->fft_y+mem, len*sizeof(std::complex<float>));
+        }
+        else
+        {
+            // Direct form over the non-zero taps only
+            memcpy(q->work, q->history, mem*sizeof(std::complex<float>));
+            memcpy(q->work+mem, xc, len*sizeof(std::complex<float>));
+            memcpy(q->history, q->work+len, mem*sizeof(std::complex<float>));
+
+            for (unsigned int j=0; j<len; j++)
+                xc[j] = 0.0f;
+            for (unsigned int d=0; d<q->h_len; d++)
+            {
+                if (q->h[d] == 0.0f)
+                    continue;
+                std::complex<float> hd = q->h[d];
+                std::complex<float> * w = q->work+mem-d;
+                for (unsigned int j=0; j<len; j++)
+                    xc[j] += hd*w[j];
+            }
+        }
+    }
+} // End multipathChannel_execute()
+
+// Collect the enabled impairments of one direction in the scenario's order
+void impairmentChain_build(struct impairmentChain * chain, int * order, int * enabled)
+{
+    chain->num_stages = 0;
+    for (int i=0; i<NUM_IMPAIRMENTS; i++)
+    {
+        if (enabled[order[i]] == 1)
+            chain->stage[chain->num_stages++] = order[i];
+    }
+} // End impairmentChain_build()
+
+// (Re)create the per-scenario channel state.
+// Called once a scenario has been loaded or received from the controller.
+// Any handles in a received Scenario belong to the sender and are discarded.
+void initScenarioChannels(struct Scenario * sc)
+{
+    awgnChannel_init(&sc->awgn, sc->noiseKernel, sc->noiseDPhi);
+
+    // A scenario without a tone list has the single tone given by cw_pow and cw_freq
+    if (sc->num_cw_tones == 0)
+        cwTone_init(&sc->cw_tones[0], sc->cw_pow, sc->cw_freq);
+    else
+        for (int i=0; i<sc->num_cw_tones; i++)
+            cwTone_init(&sc->cw_tones[i], sc->cw_tones[i].pow, sc->cw_tones[i].freq);
+
+    sc->fading.fdoppler = NULL;
+    if (sc->addRicianFadingBasebandTx || sc->addRicianFadingBasebandRx)
+        ricianChannel_init(&sc->fading, sc->fadeK, sc->fadeFd, sc->fadeDPhi, sc->fadeFilterLen);
+
+    sc->multipath.nfft = 0;
+    sc->multipath.h = sc->multipath.history = sc->multipath.work = NULL;
+    if (sc->addMultipathBasebandTx || sc->addMultipathBasebandRx)
+        multipathChannel_init(&sc->multipath);
+
+    int enabledTx[NUM_IMPAIRMENTS], enabledRx[NUM_IMPAIRMENTS];
+    enabledTx[IMPAIRMENT_MULTIPATH] = sc->addMultipathBasebandTx;
+    enabledTx[IMPAIRMENT_FADING]    = sc->addRicianFadingBasebandTx;
+    enabledTx[IMPAIRMENT_CW]        = sc->addCWInterfererBasebandTx;
+    enabledTx[IMPAIRMENT_AWGN]      = sc->addAWGNBasebandTx;
+    enabledRx[IMPAIRMENT_MULTIPATH] = sc->addMultipathBasebandRx;
+    enabledRx[IMPAIRMENT_FADING]    = sc->addRicianFadingBasebandRx;
+    enabledRx[IMPAIRMENT_CW]        = sc->addCWInterfererBasebandRx;
+    enabledRx[IMPAIRMENT_AWGN]      = sc->addAWGNBasebandRx;
+    impairmentChain_build(&sc->txChain, sc->impairmentOrder, enabledTx);
+    impairmentChain_build(&sc->rxChain, sc->impairmentOrder, enabledRx);
+} // End initScenarioChannels()
+
+// Release the per-scenario channel state. Called when a scenario ends.
+void destroyScenarioChannels(struct Scenario * sc)
+{
+    ricianChannel_destroy(&sc->fading);
+    multipathChannel_destroy(&sc->multipath);
+} // End destroyScenarioChannels()
+
+int readScConfigFile(struct Scenario * sc, char *current_scenario_file, int verbose)
+{
+    config_t cfg;               // Returns all parameters in this structure 
+    config_setting_t *setting;
+    const char * str;
+    int tmpI;
+    double tmpD;
+    char scFileLocation[60];
+
+    // Because the file is in the folder 'scconfigs'
+    strcpy(scFileLocation, "scconfigs/");
+    strcat(scFileLocation, current_scenario_file);
+
+    // Initialization 
+    config_init(&cfg);
+
+    // Read the file. If there is an error, report it and exit. 
+    if (!config_read_file(&cfg, scFileLocation))
+    {
+        fprintf(stderr, "%s:%d - %s\n", config_error_file(&cfg), config_error_line(&cfg), config_error_text(&cfg));
+        config_destroy(&cfg);
+        exit(EX_NOINPUT);
+    }
+
+    // Read the parameter group.
+    setting = config_lookup(&cfg, "params");
+    if (setting != NULL)
+    {
+        // Read the integer
+        if (config_setting_lookup_int(setting, "addAWGNBasebandTx", &tmpI))
+        {
+            sc->addAWGNBasebandTx=tmpI;
+            if (verbose) printf("addAWGNBasebandTx: %d\n", tmpI);
+        }
+
+        // Read the integer
+        if (config_setting_lookup_int(setting, "addAWGNBasebandRx", &tmpI))
+        {
+            sc->addAWGNBasebandRx=tmpI;
+            if (verbose) printf("addAWGNBasebandRx: %d\n", tmpI);
+        }
+        // Read the double
+        if (config_setting_lookup_float(setting, "noiseSNR", &tmpD))
+        {
+            sc->noiseSNR=(float) tmpD;
+            if (verbose) printf("Noise SNR: %f\n", tmpD);
+        }
+       
+        // Read the double
+        if (config_setting_lookup_float(setting, "noiseDPhi", &tmpD))
+        {
+            sc->noiseDPhi=(float) tmpD;
+            if (verbose) printf("NoiseDPhi: %f\n", tmpD);
+        }
+
+        // Read the string
+        if (config_setting_lookup_string(setting, "noiseKernel", &str))
+        {
+            if (strcmp(str, "liquid") == 0)         sc->noiseKernel = AWGN_KERNEL_LIQUID;
+            else if (strcmp(str, "auto") == 0)      sc->noiseKernel = AWGN_KERNEL_AUTO;
+            else if (strcmp(str, "scalar") == 0)    sc->noiseKernel = AWGN_KERNEL_SCALAR;
+            else if (strcmp(str, "sse2") == 0)      sc->noiseKernel = AWGN_KERNEL_SSE2;
+            else if (strcmp(str, "avx2") == 0)      sc->noiseKernel = AWGN_KERNEL_AVX2;
+            else
+            {
+                fprintf(stderr, "ERROR: Unknown noiseKernel: %s\n", str);
+                config_destroy(&cfg);
+                exit(EXIT_FAILURE);
+            }
+            if (verbose) printf("noiseKernel: %s\n", str);
+        }
+
+        // Read the integer
+        if (config_setting_lookup_int(setting, "addRicianFadingBasebandTx", &tmpI))
+        {
+            sc->addRicianFadingBasebandTx=tmpI;
+            if (verbose) printf("addRicianFadingBasebandTx: %d\n", tmpI);
+        }
+        if (config_setting_lookup_int(setting, "addRicianFadingBasebandRx", &tmpI))
+        {
+            sc->addRicianFadingBasebandRx=tmpI;
+            if (verbose) printf("addRicianFadingBasebandRx: %d\n", tmpI);
+        }
+
+		// Read the double
+        if (config_setting_lookup_float(setting, "fadeK", &tmpD))
+        {
+            sc->fadeK=(float)tmpD;
+            if (verbose) printf("fadeK: %f\n", tmpD);
+        }
+       
+        // Read the double
+        if (config_setting_lookup_float(setting, "fadeFd", &tmpD))
+        {
+            sc->fadeFd=(float)tmpD;
+            if (verbose) printf("fadeFd: %f\n", tmpD);
+        }
+        
+        // Read the double
+        if (config_setting_lookup_float(setting, "fadeDPhi", &tmpD))
+        {
+            sc->fadeDPhi=(float)tmpD;
+            if (verbose) printf("fadeDPhi: %f\n", tmpD);
+        }
+
+        // Read the integer
+        if (config_setting_lookup_int(setting, "fadeFilterLen", &tmpI))
+        {
+            sc->fadeFilterLen=tmpI;
+            if (verbose) printf("fadeFilterLen: %d\n", tmpI);
+        }
+
+		// Read the integer
+		if (config_setting_lookup_int(setting, "addCWInterfererBasebandTx", &tmpI))
+        {
+            sc->addCWInterfererBasebandTx=(float)tmpI;
+            if (verbose) printf("addCWIntefererBasebandTx: %d\n", tmpI);
+        }
+		// Read the integer
+		if (config_setting_lookup_int(setting, "addCWInterfererBasebandRx", &tmpI))
+        {
+            sc->addCWInterfererBasebandRx=(float)tmpI;
+            if (verbose) printf("addCWIntefererBasebandRx: %d\n", tmpI);
+        }
+
+		// Read the double
+		if (config_setting_lookup_float(setting, "cw_pow", &tmpD))
+        {
+            sc->cw_pow=(float)tmpD;
+            if (verbose) printf("cw_pow: %f\n", tmpD);
+        }
+
+		// Read the double
+		if (config_setting_lookup_float(setting, "cw_freq", &tmpD))
+        {
+            sc->cw_freq=(float)tmpD;
+            if (verbose) printf("cw_freq: %f\n", tmpD);
+        }
+
+		// Read the list of tones for a multi-tone interferer
+		config_setting_t * tones = config_setting_get_member(setting, "cw_tones");
+		if (tones != NULL)
+		{
+			int n = config_setting_length(tones);
+			if (n > MAX_CW_TONES)
+			{
+				fprintf(stderr, "ERROR: At most %d CW tones are supported\n", MAX_CW_TONES);
+				config_destroy(&cfg);
+				exit(EXIT_FAILURE);
+			}
+			sc->num_cw_tones = n;
+			for (int i=0; i<n; i++)
+			{
+				config_setting_t * tone = config_setting_get_elem(tones, i);
+				sc->cw_tones[i].pow = 0.0f;
+				sc->cw_tones[i].freq = 0.0f;
+				if (config_setting_lookup_float(tone, "cw_pow", &tmpD))
+					sc->cw_tones[i].pow = (float)tmpD;
+				if (config_setting_lookup_float(tone, "cw_freq", &tmpD))
+					sc->cw_tones[i].freq = (float)tmpD;
+				if (verbose) printf("cw tone %d: cw_pow: %f cw_freq: %f\n", i+1, sc->cw_tones[i].pow, sc->cw_tones[i].freq);
+			}
+		}
+
+        // Read the order of the impairments.
+        // Impairments that are not listed follow in the default order.
+        config_setting_t * order = config_setting_get_member(setting, "impairmentOrder");
+        if (order != NULL)
+        {
+            int n = config_setting_length(order);
+            int used[NUM_IMPAIRMENTS] = {0};
+            int num_used = 0;
+            for (int i=0; i<n; i++)
+            {
+                const char * name = config_setting_get_string_elem(order, i);
+                int type;
+                for (type=0; type<NUM_IMPAIRMENTS; type++)
+                    if (name != NULL && strcmp(name, impairmentNames[type]) == 0)
+                        break;
+                if (type == NUM_IMPAIRMENTS || used[type])
+                {
+                    fprintf(stderr, "ERROR: impairmentOrder may only list \"multipath\", \"fading\", \"cw\" and \"awgn\", each at most once\n");
+                    config_destroy(&cfg);
+                    exit(EXIT_FAILURE);
+                }
+                used[type] = 1;
+                sc->impairmentOrder[num_used++] = type;
+                if (verbose) printf("Impairment %d: %s\n", num_used, name);
+            }
+            for (int type=0; type<NUM_IMPAIRMENTS; type++)
+                if (!used[type])
+                    sc->impairmentOrder[num_used++] = type;
+        }
+
+        // Read the integers
+        if (config_setting_lookup_int(setting, "addMultipathBasebandTx", &tmpI))
+        {
+            sc->addMultipathBasebandTx=tmpI;
+            if (verbose) printf("addMultipathBasebandTx: %d\n", tmpI);
+        }
+        if (config_setting_lookup_int(setting, "addMultipathBasebandRx", &tmpI))
+        {
+            sc->addMultipathBasebandRx=tmpI;
+            if (verbose) printf("addMultipathBasebandRx: %d\n", tmpI);
+        }
+        if (config_setting_lookup_int(setting, "multipathFFTThreshold", &tmpI))
+        {
+            sc->multipath.fft_threshold=tmpI;
+            if (verbose) printf("multipathFFTThreshold: %d\n", tmpI);
+        }
+
+        // Read the double
+        if (config_setting_lookup_float(setting, "multipathFd", &tmpD))
+        {
+            sc->multipath.fd=(float)tmpD;
+            if (verbose) printf("multipathFd: %f\n", tmpD);
+        }
+
+        // Read the power-delay profile. Either a standard profile or a custom tap list.
+        if (config_setting_lookup_string(setting, "multipathProfile", &str))
+        {
+            if (!multipathChannel_setProfile(&sc->multipath, str))
+            {
+                if (strcmp(str, "custom") != 0)
+                {
+                    fprintf(stderr, "ERROR: Unknown multipathProfile: %s\n", str);
+                    config_destroy(&cfg);
+                    exit(EXIT_FAILURE);
+                }
+                config_setting_t * delays = config_setting_get_member(setting, "multipathTapDelays");
+                config_setting_t * powers = config_setting_get_member(setting, "multipathTapPowers");
+                int n = delays != NULL ? config_setting_length(delays) : 0;
+                if (n == 0 || powers == NULL || config_setting_length(powers) != n || n > MAX_MULTIPATH_TAPS)
+                {
+                    fprintf(stderr, "ERROR: A custom multipathProfile needs multipathTapDelays and multipathTapPowers"
+                        " of equal length (at most %d taps)\n", MAX_MULTIPATH_TAPS);
+                    config_destroy(&cfg);
+                    exit(EXIT_FAILURE);
+                }
+                sc->multipath.num_taps = n;
+                for (int i=0; i<n; i++)
+                {
+                    sc->multipath.tap_delay_ns[i] = (float)config_setting_get_float_elem(delays, i);
+                    sc->multipath.tap_power_dB[i] = (float)config_setting_get_float_elem(powers, i);
+                }
+            }
+            if (verbose) printf("multipathProfile: %s (%d taps)\n", str, sc->multipath.num_taps);
+        }
+    }
+
+    config_destroy(&cfg);
+
+    initScenarioChannels(sc);
+
+    return 1;
+} // End readScConfigFile()
+
+// Add AWGN
+void enactAWGNBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+{
+    //options
+    float dphi  = sc_ptr->noiseDPhi;                              // carrier frequency offset
+    float SNRdB = sc_ptr->noiseSNR;                               // signal-to-noise ratio [dB]
+    // noise parameters
+    float nstd = powf(10.0f, -SNRdB/20.0f); // noise standard deviation
+    float phi = sc_ptr->awgn.phi;           // channel phase, continued from the last block
+
+    // Use the persistent block kernels unless the scenario asks for liquid
+    if (sc_ptr->awgn.kernel != AWGN_KERNEL_LIQUID)
+    {
+        awgnChannel_execute(&sc_ptr->awgn, transmit_buffer, buffer_len, nstd);
+        return;
+    }
+   
+    std::complex<float> tmp (0, 1); 
+    unsigned int i;
+
+    // noise mixing
+    for (i=0; i<buffer_len; i++) {
+        transmit_buffer[i] = std::exp(tmp*phi) * transmit_buffer[i]; // apply carrier offset
+        phi += dphi;                                 // update carrier phase
+        transmit_buffer[i] += nstd*xorshiftCrandnf(&sc_ptr->awgn.rng0[0], &sc_ptr->awgn.rng1[0]);  // add noise
+    }
+    sc_ptr->awgn.phi = fmodf(phi, 2.0f*(float)M_PI);
+} // End enactAWGNBaseband()
+
+void enactCWInterfererBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+{
+	float fs = ce_ptr->bandwidth; // Sample rate of the transmit buffer
+	int num_tones = sc_ptr->num_cw_tones > 0 ? sc_ptr->num_cw_tones : 1;
+	for (int i=0; i<num_tones; i++)
+		cwTone_execute(&sc_ptr->cw_tones[i], transmit_buffer, buffer_len, fs); // Add CW tone
+} // End enactCWInterfererBaseband()
+
+// Add frequency-selective (tapped-delay-line) fading
+void enactMultipathBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+{
+    multipathChannel_execute(&sc_ptr->multipath, transmit_buffer, buffer_len, ce_ptr->bandwidth);
+} // End enactMultipathBaseband()
+
+// Add Rice-K Fading
+void enactRicianFadingBaseband(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+{
+    // The channel is created when the scenario is loaded
+    if (sc_ptr->fading.fdoppler == NULL)
+    {
+        fprintf(stderr, "error: fading channel was not initialized for this scenario\n");
+        exit(1);
+    }
+    ricianChannel_execute(&sc_ptr->fading, transmit_buffer, buffer_len);
+} // End enactRicianFadingBaseband()
+
+
+typedef void (*impairmentFunction)(std::complex<float> *, unsigned int, struct CognitiveEngine *, struct Scenario *);
+
+// Stage functions, indexed by impairmentType
+static const impairmentFunction impairmentFunctions[NUM_IMPAIRMENTS] = {
+    enactMultipathBaseband,
+    enactRicianFadingBaseband,
+    enactCWInterfererBaseband,
+    enactAWGNBaseband
+};
+
+// Apply every stage of the chain to one block at a time, in a single pass over the buffer
+void enactImpairmentChain(struct impairmentChain * chain, std::complex<float> * buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
+{
+    for (unsigned int i=0; i<buffer_len; i+=IMPAIRMENT_BLOCK_LEN)
+    {
+        unsigned int n = buffer_len-i < IMPAIRMENT_BLOCK_LEN ? buffer_len-i : IMPAIRMENT_BLOCK_LEN;
+        for (int s=0; s<chain->num_stages; s++)
+            impairmentFunctions[chain->stage[s]](buffer+i, n, ce_ptr, sc_ptr);
+    }
+} // End enactImpairmentChain()
+
+//TODO: enable starting of this thread when a new scenario begins
+// This function runs in its own thread waiting to modify the samples every time
+// they are recieve by the ofdmtxrx object, but before they are sent to the
+// synchronizer. 
+void * enactScenarioBasebandRx( void * _arg)
 {
     enactScenarioBasebandRxStruct * esbrs = (enactScenarioBasebandRxStruct *) _arg;
     int count = 0;
@@ -968,18 +3859,7 @@ void * enactScenarioBasebandRx( void * _arg)
 		pthread_cond_wait(&esbrs->txcvr_ptr->rx_buffer_filled_cond, &esbrs->txcvr_ptr->rx_buffer_mutex);
 
         // Add appropriate RF impairments for the scenario
-        if (esbrs->sc_ptr->addRicianFadingBasebandRx == 1)
-        {
-            enactRicianFadingBaseband(esbrs->txcvr_ptr->rx_buffer->data(), esbrs->txcvr_ptr->rx_buffer->size(), esbrs->ce_ptr, esbrs->sc_ptr);
-        }
-        if (esbrs->sc_ptr->addCWInterfererBasebandRx == 1)
-        {
-            enactCWInterfererBaseband(esbrs->txcvr_ptr->rx_buffer->data(), esbrs->txcvr_ptr->rx_buffer->size(), esbrs->ce_ptr, esbrs->sc_ptr);
-        }
-        if (esbrs->sc_ptr->addAWGNBasebandRx == 1)
-        {
-            enactAWGNBaseband(esbrs->txcvr_ptr->rx_buffer->data(), esbrs->txcvr_ptr->rx_buffer->size(), esbrs->ce_ptr, esbrs->sc_ptr);
-        }
+        enactImpairmentChain(&esbrs->sc_ptr->rxChain, esbrs->txcvr_ptr->rx_buffer->data(), esbrs->txcvr_ptr->rx_buffer->size(), esbrs->ce_ptr, esbrs->sc_ptr);
 	
         // signal to txcvr rx_worker that samples are ready to be sent to synchronizer
 		pthread_cond_signal(&(esbrs->txcvr_ptr->rx_buffer_modified_cond));
@@ -993,22 +3873,7 @@ void * enactScenarioBasebandRx( void * _arg)
 void enactScenarioBasebandTx(std::complex<float> * transmit_buffer, unsigned int buffer_len, struct CognitiveEngine *ce_ptr, struct Scenario *sc_ptr)
 {
     // Add appropriate RF impairments for the scenario
-    if (sc_ptr->addRicianFadingBasebandTx == 1)
-    {
-        enactRicianFadingBaseband(transmit_buffer, buffer_len, ce_ptr, sc_ptr);
-    }
-    if (sc_ptr->addCWInterfererBasebandTx == 1)
-    {
-        enactCWInterfererBaseband(transmit_buffer, buffer_len, ce_ptr, sc_ptr);
-    }
-    if (sc_ptr->addAWGNBasebandTx == 1)
-    {
-        enactAWGNBaseband(transmit_buffer, buffer_len, ce_ptr, sc_ptr);
-    }
-    if ( (sc_ptr->addAWGNBasebandTx == 0) && (sc_ptr->addCWInterfererBasebandTx == 0) && (sc_ptr->addRicianFadingBasebandTx == 0))
-    {
-       	//fprintf(stderr, "WARNING: Nothing Added by Scenario!\n");
-    }
+    enactImpairmentChain(&sc_ptr->txChain, transmit_buffer, buffer_len, ce_ptr, sc_ptr);
 } // End enactScenarioBasebandTx()
 
 void * call_uhd_siggen(void * param)
@@ -1019,206 +3884,583 @@ void * call_uhd_siggen(void * param)
 
 modulation_scheme convertModScheme(char * modScheme, unsigned int * bps)
 {
-    modulation_scheme ms;
-    // TODO: add other liquid-supported mod schemes
-    if (strcmp(modScheme, "QPSK") == 0) {
-        ms = LIQUID_MODEM_QPSK;
-		*bps = 2;
-    }
-    else if ( strcmp(modScheme, "BPSK") ==0) {
-        ms = LIQUID_MODEM_BPSK;
-		*bps = 1;
-    }
-    else if ( strcmp(modScheme, "OOK") ==0) {
-        ms = LIQUID_MODEM_OOK;
-		*bps = 1;
-    }
-    else if ( strcmp(modScheme, "8PSK") ==0) {
-        ms = LIQUID_MODEM_PSK8;
-		*bps = 3;
-    }
-    else if ( strcmp(modScheme, "16PSK") ==0) {
-        ms = LIQUID_MODEM_PSK16;
-		*bps = 4;
-    }
-    else if ( strcmp(modScheme, "32PSK") ==0) {
-        ms = LIQUID_MODEM_PSK32;
-		*bps = 5;
-    }
-    else if ( strcmp(modScheme, "64PSK") ==0) {
-        ms = LIQUID_MODEM_PSK64;
-		*bps = 6;
-    }
-    else if ( strcmp(modScheme, "128PSK") ==0) {
-        ms = LIQUID_MODEM_PSK128;
-		*bps = 7;
-    }
-    else if ( strcmp(modScheme, "8QAM") ==0) {
-        ms = LIQUID_MODEM_QAM8;
-		*bps = 3;
-    }
-    else if ( strcmp(modScheme, "16QAM") ==0) {
-        ms = LIQUID_MODEM_QAM16;
-		*bps = 4;
-    }
-    else if ( strcmp(modScheme, "32QAM") ==0) {
-        ms = LIQUID_MODEM_QAM32;
-		*bps = 5;
-    }
-    else if ( strcmp(modScheme, "64QAM") ==0) {
-        ms = LIQUID_MODEM_QAM64;
-		*bps = 6;
-    }
-    else if ( strcmp(modScheme, "BASK") ==0) {
-        ms = LIQUID_MODEM_ASK2;
-		*bps = 1;
-    }
-    else if ( strcmp(modScheme, "4ASK") ==0) {
-        ms = LIQUID_MODEM_ASK4;
-		*bps = 2;
-    }
-    else if ( strcmp(modScheme, "8ASK") ==0) {
-        ms = LIQUID_MODEM_ASK8;
-		*bps = 3;
-    }
-    else if ( strcmp(modScheme, "16ASK") ==0) {
-        ms = LIQUID_MODEM_ASK16;
-		*bps = 4;
-    }
-    else if ( strcmp(modScheme, "32ASK") ==0) {
-        ms = LIQUID_MODEM_ASK32;
-		*bps = 5;
-    }
-    else if ( strcmp(modScheme, "64ASK") ==0) {
-        ms = LIQUID_MODEM_ASK64;
-		*bps = 6;
-    }
-    else if ( strcmp(modScheme, "128ASK") ==0) {
-        ms = LIQUID_MODEM_ASK128;
-		*bps = 7;
-    }
-    else {
+    const struct schemeName * s = lookupSchemeName(modSchemeNames, NUM_MOD_SCHEME_NAMES, modScheme);
+    if (s == NULL) {
         fprintf(stderr, "ERROR: Unknown Modulation Scheme");
         exit(EXIT_FAILURE);
-        //TODO: Rather than halt execution,
-        // Skip current test if given an unknown parameter.
     }
-
-    return ms;
+    *bps = s->bps;
+    return (modulation_scheme) s->scheme;
 } // End convertModScheme()
 
 crc_scheme convertCRCScheme(char * crcScheme, int verbose)
 {
-    crc_scheme check;
-    if (strcmp(crcScheme, "none") == 0) {
-        check = LIQUID_CRC_NONE;
-        if (verbose) printf("check = LIQUID_CRC_NONE\n");
-    }
-    else if (strcmp(crcScheme, "checksum") == 0) {
-        check = LIQUID_CRC_CHECKSUM;
-        if (verbose) printf("check = LIQUID_CRC_CHECKSUM\n");
-    }
-    else if (strcmp(crcScheme, "8") == 0) {
-        check = LIQUID_CRC_8;
-        if (verbose) printf("check = LIQUID_CRC_8\n");
-    }
-    else if (strcmp(crcScheme, "16") == 0) {
-        check = LIQUID_CRC_16;
-        if (verbose) printf("check = LIQUID_CRC_16\n");
-    }
-    else if (strcmp(crcScheme, "24") == 0) {
-        check = LIQUID_CRC_24;
-        if (verbose) printf("check = LIQUID_CRC_24\n");
-    }
-    else if (strcmp(crcScheme, "32") == 0) {
-        check = LIQUID_CRC_32;
-        if (verbose) printf("check = LIQUID_CRC_32\n");
-    }
-    else {
+    const struct schemeName * s = lookupSchemeName(crcSchemeNames, NUM_CRC_SCHEME_NAMES, crcScheme);
+    if (s == NULL) {
         fprintf(stderr, "ERROR: unknown CRC\n");
         exit(EXIT_FAILURE);
-        //TODO: Rather than halt execution,
-        // Skip current test if given an unknown parameter.
     }
-
-    return check;
+    if (verbose) printf("check = %s\n", s->name);
+    return (crc_scheme) s->scheme;
 } // End convertCRCScheme()
 
 fec_scheme convertFECScheme(char * FEC, int verbose)
 {
-    // TODO: add other liquid-supported FEC schemes
-    fec_scheme fec;
-    if (strcmp(FEC, "none") == 0) {
-        fec = LIQUID_FEC_NONE;
-        if (verbose) printf("fec = LIQUID_FEC_NONE\n");
-    }
-    else if (strcmp(FEC, "Hamming74") == 0) {
-        fec = LIQUID_FEC_HAMMING74;
-        if (verbose) printf("fec = LIQUID_FEC_HAMMING74\n");
-    }
-    else if (strcmp(FEC, "Hamming128") == 0) {
-        fec = LIQUID_FEC_HAMMING128;
-        if (verbose) printf("fec = LIQUID_FEC_HAMMING128\n");
-    }
-    else if (strcmp(FEC, "Golay2412") == 0) {
-        fec = LIQUID_FEC_GOLAY2412;
-        if (verbose) printf("fec = LIQUID_FEC_GOLAY2412\n");
-    }
-    else if (strcmp(FEC, "SEC-DED2216") == 0) {
-        fec = LIQUID_FEC_SECDED2216;
-        if (verbose) printf("fec = LIQUID_FEC_SECDED2216\n");
-    }
-    else if (strcmp(FEC, "SEC-DED3932") == 0) {
-        fec = LIQUID_FEC_SECDED3932;
-        if (verbose) printf("fec = LIQUID_FEC_SECDED3932\n");
-    }
-    else if (strcmp(FEC, "SEC-DED7264") == 0) {
-        fec = LIQUID_FEC_SECDED7264;
-        if (verbose) printf("fec = LIQUID_FEC_SECDED7264\n");
-    }
-    else {
+    const struct schemeName * s = lookupSchemeName(fecSchemeNames, NUM_FEC_SCHEME_NAMES, FEC);
+    if (s == NULL) {
         fprintf(stderr, "ERROR: unknown FEC\n");
         exit(EXIT_FAILURE);
-        //TODO: Rather than halt execution,
-        // Skip current test if given an unknown parameter.
     }
-    return fec;
+    if (verbose) printf("fec = %s\n", s->name);
+    return (fec_scheme) s->scheme;
 } // End convertFECScheme()
 
 // Create Frame generator with CE and Scenario parameters
 ofdmflexframegen CreateFG(struct CognitiveEngine ce, struct Scenario sc, int verbose) {
 
-    // Set Modulation Scheme
-    if (verbose) printf("Modulation scheme: %s\n", ce.modScheme);
-    modulation_scheme ms = convertModScheme(ce.modScheme, &ce.bitsPerSym);
-
-    // Set Cyclic Redundency Check Scheme
-    crc_scheme check = convertCRCScheme(ce.crcScheme, verbose);
-
-    // Set inner forward error correction scheme
-    if (verbose) printf("Inner FEC: ");
-    fec_scheme fec0 = convertFECScheme(ce.innerFEC, verbose);
-
-    // Set outer forward error correction scheme
-    // TODO: add other liquid-supported FEC schemes
-    if (verbose) printf("Outer FEC: ");
-    fec_scheme fec1 = convertFECScheme(ce.outerFEC, verbose);
+    if (verbose) printf("Modulation scheme: %s\n", modSchemeName(ceModScheme(&ce)));
+    if (verbose) printf("Inner FEC: %s\n", fecSchemeName(ceInnerFEC(&ce)));
+    if (verbose) printf("Outer FEC: %s\n", fecSchemeName(ceOuterFEC(&ce)));
 
     // Frame generation parameters
     ofdmflexframegenprops_s fgprops;
 
     // Initialize Frame generator and Frame Synchronizer Objects
     ofdmflexframegenprops_init_default(&fgprops);
-    fgprops.mod_scheme      = ms;
-    fgprops.check           = check;
-    fgprops.fec0            = fec0;
-    fgprops.fec1            = fec1;
+    fgprops.mod_scheme      = ceModScheme(&ce);
+    fgprops.check           = ce.crcScheme;
+    fgprops.fec0            = ceInnerFEC(&ce);
+    fgprops.fec1            = ceOuterFEC(&ce);
 
     ofdmflexframegen fg = ofdmflexframegen_create(ce.numSubcarriers, ce.CPLen, ce.taperLen, NULL, &fgprops);
 
     return fg;
 } // End CreateFG()
 
+struct frameGeneratorPool CreateFrameGeneratorPool() {
+    struct frameGeneratorPool pool = {};
+    pool.num_entries = 0;
+    pool.uses = 0;
+    return pool;
+} // End CreateFrameGeneratorPool()
+
+// Get a frame generator for the CE's current parameters.
+// An exact match is reused as is. Otherwise a free slot gets a new generator,
+// or the least recently used one is reconfigured (same geometry) or replaced.
+ofdmflexframegen getFrameGenerator(struct frameGeneratorPool * pool, struct CognitiveEngine * ce, int verbose)
+{
+    ofdmflexframegenprops_s fgprops;
+    ofdmflexframegenprops_init_default(&fgprops);
+    fgprops.mod_scheme = ceModScheme(ce);
+    fgprops.check      = ce->crcScheme;
+    fgprops.fec0       = ceInnerFEC(ce);
+    fgprops.fec1       = ceOuterFEC(ce);
+
+    pool->uses++;
+
+    struct frameGeneratorEntry * victim = NULL;
+    for (int i=0; i<pool->num_entries; i++)
+    {
+        struct frameGeneratorEntry * e = &pool->entries[i];
+        if (e->numSubcarriers == ce->numSubcarriers && e->CPLen == ce->CPLen && e->taperLen == ce->taperLen &&
+            e->props.mod_scheme == fgprops.mod_scheme && e->props.check == fgprops.check &&
+            e->props.fec0 == fgprops.fec0 && e->props.fec1 == fgprops.fec1)
+        {
+            e->lastUsed = pool->uses;
+            return e->fg;
+        }
+        if (victim == NULL || e->lastUsed < victim->lastUsed)
+            victim = e;
+    }
+
+    if (pool->num_entries < FG_POOL_SIZE)
+    {
+        victim = &pool->entries[pool->num_entries++];
+        victim->fg = NULL;
+    }
+
+    if (victim->fg != NULL && victim->numSubcarriers == ce->numSubcarriers &&
+        victim->CPLen == ce->CPLen && victim->taperLen == ce->taperLen)
+    {
+        if (verbose) printf("Reconfiguring frame generator\n");
+        ofdmflexframegen_setprops(victim->fg, &fgprops);
+    }
+    else
+    {
+        if (verbose) printf("Creating frame generator\n");
+        pthread_mutex_lock(&liquidCreateMutex);
+        if (victim->fg != NULL)
+            ofdmflexframegen_destroy(victim->fg);
+        victim->fg = ofdmflexframegen_create(ce->numSubcarriers, ce->CPLen, ce->taperLen, NULL, &fgprops);
+        pthread_mutex_unlock(&liquidCreateMutex);
+        victim->numSubcarriers = ce->numSubcarriers;
+        victim->CPLen = ce->CPLen;
+        victim->taperLen = ce->taperLen;
+    }
+    victim->props = fgprops;
+    victim->lastUsed = pool->uses;
+    return victim->fg;
+} // End getFrameGenerator()
+
+void destroyFrameGeneratorPool(struct frameGeneratorPool * pool)
+{
+    pthread_mutex_lock(&liquidCreateMutex);
+    for (int i=0; i<pool->num_entries; i++)
+        ofdmflexframegen_destroy(pool->entries[i].fg);
+    pthread_mutex_unlock(&liquidCreateMutex);
+    pool->num_entries = 0;
+} // End destroyFrameGeneratorPool()
+
+// Payloads carry the degree-9 m-sequence taken 8 bits at a time, which
+// repeats every 511 bytes. Frame n starts at byte (n*PN_FRAME_STRIDE)%PN_PERIOD,
+// so the receiver can regenerate the reference of any frame from its number
+// alone, even after frames were lost.
+#define PN_PERIOD 511
+#define PN_FRAME_STRIDE 131
+unsigned char pnTable[PN_PERIOD + PN_MAX_PAYLOAD_LEN];
+
+// Fill the table with one period of the sequence plus enough wrap-around
+// that any frame's payload is contiguous
+void initPNTable()
+{
+    msequence ms = msequence_create_default(9u);
+    for (unsigned int i=0; i<sizeof(pnTable); i++)
+        pnTable[i] = (unsigned char)msequence_generate_symbol(ms,8);
+    msequence_destroy(ms);
+} // End initPNTable()
+
+// Payload bytes of a frame (valid for PN_MAX_PAYLOAD_LEN bytes)
+const unsigned char * pnFrameSequence(unsigned int frameNumber)
+{
+    return pnTable + ((frameNumber%PN_PERIOD)*PN_FRAME_STRIDE)%PN_PERIOD;
+} // End pnFrameSequence()
+
+// Add the positions of the bit errors in one decoded payload to a histogram.
+// Positions are in the payload after FEC decoding and deinterleaving, so they
+// do not map onto the channel symbols that carried the frame.
+void errorHistogram_update(struct errorHistogram * hist, const unsigned char * x,
+    const unsigned char * ref, unsigned int n)
+{
+    hist->num_frames++;
+    if (n > hist->num_bytes) hist->num_bytes = n;
+
+    for (unsigned int m=0; m<n; m++)
+    {
+        unsigned int d = x[m]^ref[m];
+        if (d != 0)
+            hist->byte_errors[m] += __builtin_popcount(d);
+    }
+} // End errorHistogram_update()
+
+// Count bit errors between a payload and its reference a 64-bit word at a
+// time. Byte errors are returned through byteErrors.
+static inline __attribute__((always_inline)) unsigned int countBitErrors_words(const unsigned char * x,
+    const unsigned char * ref, unsigned int n, unsigned int * byteErrors)
+{
+    unsigned int bitErrors = 0;
+    unsigned int bytes = 0;
+    unsigned int m = 0;
+
+    for (; m+8<=n; m+=8)
+    {
+        uint64_t a, b;
+        memcpy(&a, x+m, 8);
+        memcpy(&b, ref+m, 8);
+        uint64_t d = a^b;
+        bitErrors += __builtin_popcountll(d);
+
+        // Collapse each byte onto its lowest bit to count the bytes in error
+        d |= d >> 4;
+        d |= d >> 2;
+        d |= d >> 1;
+        bytes += __builtin_popcountll(d & 0x0101010101010101ULL);
+    }
+    for (; m<n; m++)
+    {
+        unsigned int d = x[m]^ref[m];
+        bitErrors += __builtin_popcount(d);
+        bytes += (d != 0);
+    }
+
+    *byteErrors = bytes;
+    return bitErrors;
+}
+
+unsigned int countBitErrors_generic(const unsigned char * x, const unsigned char * ref, unsigned int n, unsigned int * byteErrors)
+{
+    return countBitErrors_words(x, ref, n, byteErrors);
+} // End countBitErrors_generic()
+
+// Whether countBitErrors() uses the popcount instruction. Set by
+// initCountBitErrors() before any thread counts errors.
+int countBitErrorsPopcnt = 0;
+
+void initCountBitErrors()
+{
+#ifdef CRTS_X86_SIMD
+    __builtin_cpu_init();
+    countBitErrorsPopcnt = __builtin_cpu_supports("popcnt") ? 1 : 0;
+#endif
+} // End initCountBitErrors()
+
+#ifdef CRTS_X86_SIMD
+// Same as countBitErrors_generic() with the hardware popcount instruction
+__attribute__((target("popcnt")))
+unsigned int countBitErrors_popcnt(const unsigned char * x, const unsigned char * ref, unsigned int n, unsigned int * byteErrors)
+{
+    return countBitErrors_words(x, ref, n, byteErrors);
+} // End countBitErrors_popcnt()
+#endif
+
+unsigned int countBitErrors(const unsigned char * x, const unsigned char * ref, unsigned int n, unsigned int * byteErrors)
+{
+#ifdef CRTS_X86_SIMD
+    if (countBitErrorsPopcnt)
+        return countBitErrors_popcnt(x, ref, n, byteErrors);
+#endif
+    return countBitErrors_generic(x, ref, n, byteErrors);
+} // End countBitErrors()
+
+void wirePutU8(struct wireWriter * w, unsigned int v)
+{
+    if (w->p + 1 > w->end) { w->error = 1; return; }
+    *w->p++ = (unsigned char) v;
+} // End wirePutU8()
+
+void wirePutU16(struct wireWriter * w, unsigned int v)
+{
+    if (w->p + 2 > w->end) { w->error = 1; return; }
+    w->p[0] = v & 0xFF;
+    w->p[1] = (v >> 8) & 0xFF;
+    w->p += 2;
+} // End wirePutU16()
+
+void wirePutU32(struct wireWriter * w, uint32_t v)
+{
+    if (w->p + 4 > w->end) { w->error = 1; return; }
+    for (int i=0; i<4; i++)
+        w->p[i] = (v >> (8*i)) & 0xFF;
+    w->p += 4;
+} // End wirePutU32()
+
+void wirePutFloat(struct wireWriter * w, float v)
+{
+    uint32_t u;
+    memcpy(&u, &v, 4);
+    wirePutU32(w, u);
+} // End wirePutFloat()
+
+unsigned int wireGetU8(struct wireReader * r)
+{
+    if (r->p + 1 > r->end) { r->error = 1; return 0; }
+    return *r->p++;
+} // End wireGetU8()
+
+unsigned int wireGetU16(struct wireReader * r)
+{
+    if (r->p + 2 > r->end) { r->error = 1; return 0; }
+    unsigned int v = r->p[0] | (r->p[1] << 8);
+    r->p += 2;
+    return v;
+} // End wireGetU16()
+
+uint32_t wireGetU32(struct wireReader * r)
+{
+    if (r->p + 4 > r->end) { r->error = 1; return 0; }
+    uint32_t v = 0;
+    for (int i=0; i<4; i++)
+        v |= (uint32_t) r->p[i] << (8*i);
+    r->p += 4;
+    return v;
+} // End wireGetU32()
+
+float wireGetFloat(struct wireReader * r)
+{
+    uint32_t u = wireGetU32(r);
+    float v;
+    memcpy(&v, &u, 4);
+    return v;
+} // End wireGetFloat()
+
+// Start a message of the given type in buf. The body follows.
+struct wireWriter wireBeginMessage(unsigned char * buf, unsigned int size, unsigned int type)
+{
+    struct wireWriter w = {buf, buf + size, 0};
+    wirePutU8(&w, CRTS_WIRE_MAGIC);
+    wirePutU8(&w, CRTS_WIRE_VERSION);
+    wirePutU8(&w, type);
+    wirePutU16(&w, 0);
+    return w;
+} // End wireBeginMessage()
+
+// Fill in the body length of a message started at buf.
+// Returns the length of the whole message, or 0 if it did not fit.
+unsigned int wireEndMessage(unsigned char * buf, struct wireWriter * w)
+{
+    unsigned int len = w->p - buf;
+    if (w->error || len - WIRE_HEADER_LEN > WIRE_MAX_BODY_LEN)
+        return 0;
+    buf[3] = (len - WIRE_HEADER_LEN) & 0xFF;
+    buf[4] = ((len - WIRE_HEADER_LEN) >> 8) & 0xFF;
+    return len;
+} // End wireEndMessage()
+
+// Returns EX_OK if buf starts with a valid header of this protocol version
+int wireDecodeHeader(const unsigned char * buf, unsigned int len, struct wireHeader * h)
+{
+    if (len < WIRE_HEADER_LEN || buf[0] != CRTS_WIRE_MAGIC || buf[1] != CRTS_WIRE_VERSION)
+        return EX_PROTOCOL;
+    h->type = buf[2];
+    h->length = buf[3] | (buf[4] << 8);
+    if (h->length > WIRE_MAX_BODY_LEN)
+        return EX_PROTOCOL;
+    return EX_OK;
+} // End wireDecodeHeader()
+
+unsigned int wireEncodeFeedback(unsigned char * buf, unsigned int size, const struct feedbackStruct * fb)
+{
+    struct wireWriter w = wireBeginMessage(buf, size, WIRE_MSG_FEEDBACK);
+    wirePutU8(&w, (fb->header_valid ? 1 : 0) | (fb->payload_valid ? 2 : 0));
+    wirePutU16(&w, std::min(fb->payload_len, 0xFFFFu));
+    wirePutU16(&w, std::min(fb->payloadByteErrors, 0xFFFFu));
+    wirePutU16(&w, std::min(fb->payloadBitErrors, 0xFFFFu));
+    wirePutU32(&w, fb->iteration);
+    wirePutFloat(&w, fb->evm);
+    wirePutFloat(&w, fb->rssi);
+    wirePutFloat(&w, fb->cfo);
+    return wireEndMessage(buf, &w);
+} // End wireEncodeFeedback()
+
+// Decode the body of a feedback message. Only the fields that are sent are changed.
+int wireDecodeFeedback(const unsigned char * body, unsigned int len, struct feedbackStruct * fb)
+{
+    struct wireReader r = {body, body + len, 0};
+    unsigned int flags = wireGetU8(&r);
+    unsigned int payload_len = wireGetU16(&r);
+    unsigned int byteErrors = wireGetU16(&r);
+    unsigned int bitErrors = wireGetU16(&r);
+    unsigned int iteration = wireGetU32(&r);
+    float evm = wireGetFloat(&r);
+    float rssi = wireGetFloat(&r);
+    float cfo = wireGetFloat(&r);
+    if (r.error)
+        return EX_PROTOCOL;
+
+    fb->header_valid = flags & 1;
+    fb->payload_valid = (flags >> 1) & 1;
+    fb->payload_len = payload_len;
+    fb->payloadByteErrors = byteErrors;
+    fb->payloadBitErrors = bitErrors;
+    fb->iteration = iteration;
+    fb->evm = evm;
+    fb->rssi = rssi;
+    fb->cfo = cfo;
+    return EX_OK;
+} // End wireDecodeFeedback()
+
+// The parameters a receiver needs to receive the CE's frames and send feedback
+unsigned int wireEncodeCognitiveEngine(unsigned char * buf, unsigned int size, const struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = &mcsTable[ce->mcsIndex];
+    struct wireWriter w = wireBeginMessage(buf, size, WIRE_MSG_CE_CONFIG);
+    wirePutU8(&w, mcs->mod);
+    wirePutU8(&w, mcs->fec0);
+    wirePutU8(&w, mcs->fec1);
+    wirePutU8(&w, ce->crcScheme);
+    wirePutU16(&w, ce->numSubcarriers);
+    wirePutU16(&w, ce->CPLen);
+    wirePutU16(&w, ce->taperLen);
+    wirePutU16(&w, ce->payloadLen);
+    wirePutU32(&w, ce->frameNumber);
+    wirePutFloat(&w, ce->txgain_dB);
+    wirePutFloat(&w, ce->uhd_txgain_dB);
+    wirePutFloat(&w, ce->uhd_rxgain_dB);
+    wirePutFloat(&w, ce->frequency_tx);
+    wirePutFloat(&w, ce->frequency_rx);
+    wirePutFloat(&w, ce->bandwidth);
+    wirePutFloat(&w, ce->delay_us);
+    return wireEndMessage(buf, &w);
+} // End wireEncodeCognitiveEngine()
+
+// Decode the body of a CE config message into a CE made by CreateCognitiveEngine()
+int wireDecodeCognitiveEngine(const unsigned char * body, unsigned int len, struct CognitiveEngine * ce)
+{
+    struct wireReader r = {body, body + len, 0};
+    unsigned int mod = wireGetU8(&r);
+    unsigned int fec0 = wireGetU8(&r);
+    unsigned int fec1 = wireGetU8(&r);
+    unsigned int crc = wireGetU8(&r);
+    ce->numSubcarriers = wireGetU16(&r);
+    ce->CPLen = wireGetU16(&r);
+    ce->taperLen = wireGetU16(&r);
+    ce->payloadLen = wireGetU16(&r);
+    ce->frameNumber = wireGetU32(&r);
+    ce->txgain_dB = wireGetFloat(&r);
+    ce->uhd_txgain_dB = wireGetFloat(&r);
+    ce->uhd_rxgain_dB = wireGetFloat(&r);
+    ce->frequency_tx = wireGetFloat(&r);
+    ce->frequency_rx = wireGetFloat(&r);
+    ce->bandwidth = wireGetFloat(&r);
+    ce->delay_us = wireGetFloat(&r);
+    if (r.error || mod >= NUM_MOD_SCHEME_NAMES || fec0 >= NUM_FEC_SCHEME_NAMES || fec1 >= NUM_FEC_SCHEME_NAMES)
+        return EX_PROTOCOL;
+    ce->mcsIndex = mcsIndexTable[mod][fec0][fec1];
+    ce->crcScheme = (crc_scheme) crc;
+    return EX_OK;
+} // End wireDecodeCognitiveEngine()
+
+// The scenario's settings. Channel state is created again by the receiver.
+unsigned int wireEncodeScenario(unsigned char * buf, unsigned int size, const struct Scenario * sc)
+{
+    struct wireWriter w = wireBeginMessage(buf, size, WIRE_MSG_SCENARIO_CONFIG);
+    wirePutU8(&w, (sc->addAWGNBasebandTx ? 1 : 0) | (sc->addAWGNBasebandRx ? 2 : 0) |
+        (sc->addRicianFadingBasebandTx ? 4 : 0) | (sc->addRicianFadingBasebandRx ? 8 : 0) |
+        (sc->addCWInterfererBasebandTx ? 16 : 0) | (sc->addCWInterfererBasebandRx ? 32 : 0) |
+        (sc->addMultipathBasebandTx ? 64 : 0) | (sc->addMultipathBasebandRx ? 128 : 0));
+    for (int i=0; i<NUM_IMPAIRMENTS; i++)
+        wirePutU8(&w, sc->impairmentOrder[i]);
+
+    wirePutU8(&w, sc->noiseKernel);
+    wirePutFloat(&w, sc->noiseSNR);
+    wirePutFloat(&w, sc->noiseDPhi);
+
+    wirePutU16(&w, sc->fadeFilterLen);
+    wirePutFloat(&w, sc->fadeK);
+    wirePutFloat(&w, sc->fadeFd);
+    wirePutFloat(&w, sc->fadeDPhi);
+
+    wirePutFloat(&w, sc->cw_pow);
+    wirePutFloat(&w, sc->cw_freq);
+    wirePutU8(&w, sc->num_cw_tones);
+    for (int i=0; i<sc->num_cw_tones; i++)
+    {
+        wirePutFloat(&w, sc->cw_tones[i].pow);
+        wirePutFloat(&w, sc->cw_tones[i].freq);
+    }
+
+    wirePutFloat(&w, sc->multipath.fd);
+    wirePutU32(&w, sc->multipath.fft_threshold);
+    wirePutU8(&w, sc->multipath.num_taps);
+    for (int i=0; i<sc->multipath.num_taps; i++)
+    {
+        wirePutFloat(&w, sc->multipath.tap_delay_ns[i]);
+        wirePutFloat(&w, sc->multipath.tap_power_dB[i]);
+    }
+    return wireEndMessage(buf, &w);
+} // End wireEncodeScenario()
+
+// Decode the body of a scenario config message into a scenario made by CreateScenario().
+// initScenarioChannels() must be called before it is used.
+int wireDecodeScenario(const unsigned char * body, unsigned int len, struct Scenario * sc)
+{
+    struct wireReader r = {body, body + len, 0};
+    unsigned int enabled = wireGetU8(&r);
+    sc->addAWGNBasebandTx = (enabled >> 0) & 1;
+    sc->addAWGNBasebandRx = (enabled >> 1) & 1;
+    sc->addRicianFadingBasebandTx = (enabled >> 2) & 1;
+    sc->addRicianFadingBasebandRx = (enabled >> 3) & 1;
+    sc->addCWInterfererBasebandTx = (enabled >> 4) & 1;
+    sc->addCWInterfererBasebandRx = (enabled >> 5) & 1;
+    sc->addMultipathBasebandTx = (enabled >> 6) & 1;
+    sc->addMultipathBasebandRx = (enabled >> 7) & 1;
+    for (int i=0; i<NUM_IMPAIRMENTS; i++)
+    {
+        sc->impairmentOrder[i] = wireGetU8(&r);
+        if (sc->impairmentOrder[i] >= NUM_IMPAIRMENTS)
+            return EX_PROTOCOL;
+    }
+
+    sc->noiseKernel = wireGetU8(&r);
+    sc->noiseSNR = wireGetFloat(&r);
+    sc->noiseDPhi = wireGetFloat(&r);
+
+    sc->fadeFilterLen = wireGetU16(&r);
+    sc->fadeK = wireGetFloat(&r);
+    sc->fadeFd = wireGetFloat(&r);
+    sc->fadeDPhi = wireGetFloat(&r);
+
+    sc->cw_pow = wireGetFloat(&r);
+    sc->cw_freq = wireGetFloat(&r);
+    sc->num_cw_tones = wireGetU8(&r);
+    if (sc->num_cw_tones > MAX_CW_TONES)
+        return EX_PROTOCOL;
+    for (int i=0; i<sc->num_cw_tones; i++)
+    {
+        sc->cw_tones[i].pow = wireGetFloat(&r);
+        sc->cw_tones[i].freq = wireGetFloat(&r);
+    }
+
+    sc->multipath.fd = wireGetFloat(&r);
+    sc->multipath.fft_threshold = wireGetU32(&r);
+    sc->multipath.num_taps = wireGetU8(&r);
+    if (sc->multipath.num_taps > MAX_MULTIPATH_TAPS)
+        return EX_PROTOCOL;
+    for (int i=0; i<sc->multipath.num_taps; i++)
+    {
+        sc->multipath.tap_delay_ns[i] = wireGetFloat(&r);
+        sc->multipath.tap_power_dB[i] = wireGetFloat(&r);
+    }
+    return r.error ? EX_PROTOCOL : EX_OK;
+} // End wireDecodeScenario()
+
+// Read exactly len bytes from a socket, however many recv() calls it takes.
+// Returns 0 on success and -1 if the connection closed or failed.
+int recvAll(int fd, void * buf, size_t len)
+{
+    unsigned char * p = (unsigned char *) buf;
+    while (len > 0)
+    {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+} // End recvAll()
+
+// Write exactly len bytes to a socket. Returns 0 on success and -1 on failure.
+// Non-blocking sockets are waited on for up to a second at a time.
+int sendAll(int fd, const void * buf, size_t len)
+{
+    const unsigned char * p = (const unsigned char *) buf;
+    while (len > 0)
+    {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            struct pollfd pfd = {fd, POLLOUT, 0};
+            if (poll(&pfd, 1, 1000) > 0)
+                continue;
+            return -1;
+        }
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+} // End sendAll()
+
+// Receive one whole message. The body is stored in body, which holds
+// WIRE_MAX_BODY_LEN bytes. Returns EX_OK, EX_IOERR if the connection
+// closed or failed, or EX_PROTOCOL if the message is not valid.
+int wireRecvMessage(int fd, struct wireHeader * h, unsigned char * body)
+{
+    unsigned char header[WIRE_HEADER_LEN];
+    if (recvAll(fd, header, WIRE_HEADER_LEN) < 0)
+        return EX_IOERR;
+    if (wireDecodeHeader(header, WIRE_HEADER_LEN, h) != EX_OK)
+        return EX_PROTOCOL;
+    if (recvAll(fd, body, h->length) < 0)
+        return EX_IOERR;
+    return EX_OK;
+} // End wireRecvMessage()
+
 int rxCallback(unsigned char *  _header,
                int              _header_valid,
                unsigned char *  _payload,
@@ -1229,28 +4471,27 @@ int rxCallback(unsigned char *  _header,
 {   
 	struct rxCBstruct * rxCBS_ptr = (struct rxCBstruct *) _userdata;
     int verbose = rxCBS_ptr->verbose;
-	msequence rx_ms = *rxCBS_ptr->rx_ms_ptr;
+    PROFILE_START(profile_t);
 
-    // Variables for checking number of errors 
-    int j;
-    unsigned int m;
-	unsigned int tx_byte;
-	
 	if(rxCBS_ptr->isController && rxCBS_ptr->usingUSRPs){
 		// Read FB from the payload received OTA and write it to the FB struct
-        if (_payload_valid)
+        struct wireHeader h;
+        struct feedbackStruct fbReceived = {};
+        if (_payload_valid &&
+            wireDecodeHeader(_payload, _payload_len, &h) == EX_OK && h.type == WIRE_MSG_FEEDBACK &&
+            h.length <= _payload_len - WIRE_HEADER_LEN &&
+            wireDecodeFeedback(_payload + WIRE_HEADER_LEN, h.length, &fbReceived) == EX_OK)
         {
             pthread_mutex_lock(&rxCBS_ptr->fb_ptr->fb_mutex);
-            struct feedbackStruct * _fbReceived = (struct feedbackStruct *) _payload;
-            rxCBS_ptr->fb_ptr->header_valid = _fbReceived->header_valid;
-            rxCBS_ptr->fb_ptr->payload_valid = _fbReceived->payload_valid;
-            rxCBS_ptr->fb_ptr->payload_len = _fbReceived->payload_len;
-            rxCBS_ptr->fb_ptr->payloadByteErrors = _fbReceived->payloadByteErrors;
-			rxCBS_ptr->fb_ptr->payloadBitErrors = _fbReceived->payloadBitErrors;
-            rxCBS_ptr->fb_ptr->evm = _fbReceived->evm;
-            rxCBS_ptr->fb_ptr->rssi = _fbReceived->rssi;
-            rxCBS_ptr->fb_ptr->cfo = _fbReceived->cfo;
-            rxCBS_ptr->fb_ptr->iteration = _fbReceived->iteration;
+            if (rxCBS_ptr->ota_ptr != NULL)
+            {
+                unsigned int slot = fbReceived.iteration % MAX_FRAMES_IN_FLIGHT;
+                feedbackStruct_copy(&rxCBS_ptr->ota_ptr->fb[slot], &fbReceived);
+                rxCBS_ptr->ota_ptr->received[slot] = 1;
+            }
+            else
+                feedbackStruct_copy(rxCBS_ptr->fb_ptr, &fbReceived);
+            rxCBS_ptr->fb_ptr->updates++;
             int sigrt = pthread_cond_signal(&rxCBS_ptr->fb_ptr->fb_cond);
             pthread_mutex_unlock(&rxCBS_ptr->fb_ptr->fb_mutex);
         }
@@ -1287,47 +4528,33 @@ int rxCallback(unsigned char *  _header,
 		}
 
 		// Calculate byte error rate and bit error rate for payload
-		for (m=0; m<_payload_len; m++)
-		{
-			tx_byte = msequence_generate_symbol(rx_ms,8);
-		    if (((int)_payload[m] != tx_byte))
-		    {
-		        fb.payloadByteErrors++;
-		        for (j=0; j<8; j++)
-		        {
-					if ((_payload[m]&(1<<j)) != (tx_byte&(1<<j)))
-		               fb.payloadBitErrors++;
-		        }      
-		    }           
-		}             
+		const unsigned char * pn = pnFrameSequence(fb.iteration);
+		unsigned int len = _payload_len < PN_MAX_PAYLOAD_LEN ? _payload_len : PN_MAX_PAYLOAD_LEN;
+		fb.payloadBitErrors = countBitErrors(_payload, pn, len, &fb.payloadByteErrors);
+		if (rxCBS_ptr->hist_ptr != NULL)
+			errorHistogram_update(rxCBS_ptr->hist_ptr, _payload, pn, len);
         	
 		// Data that will be sent to server
 		// TODO: Send other useful data through feedback array
 		if(rxCBS_ptr->isController){
             pthread_mutex_lock(&rxCBS_ptr->fb_ptr->fb_mutex);
-			*rxCBS_ptr->fb_ptr = fb;
+			feedbackStruct_copy(rxCBS_ptr->fb_ptr, &fb);
+            rxCBS_ptr->fb_ptr->updates++;
             pthread_cond_signal(&rxCBS_ptr->fb_ptr->fb_cond);
             pthread_mutex_unlock(&rxCBS_ptr->fb_ptr->fb_mutex);
 		}
 		else{
+			unsigned char payload[1000];
+			unsigned int msg_len = wireEncodeFeedback(payload, sizeof(payload), &fb);
+
 			// Receiver sends feedback over TCP link
-			write(rxCBS_ptr->client, (void*)&fb, sizeof(fb));
+			if (sendAll(rxCBS_ptr->client, payload, msg_len) < 0)
+				fprintf(stderr, "ERROR: Failed to send feedback to the controller: %s\n", strerror(errno));
 
-			// Receiver sends feedback OTA
-			int i = 0;
+			// Receiver sends feedback OTA. The frame carries only the encoded
+			// message; its length comes from the frame header.
 			unsigned char header[8] = {0};            // Must always be 8 bytes for ofdmflexframe
-			unsigned char *fb_c_ptr = (unsigned char*)&fb;
-			unsigned char payload[1000];
-			// Generate data
-			if (verbose) printf("\n\nGenerating data that will go in frame...\n");
-			for (size_t k=0; k<sizeof(fb); k++){
-				payload[k] = *fb_c_ptr;
-				fb_c_ptr++;
-			}
-			
-			for (i=sizeof(fb); i<(signed int)rxCBS_ptr->ce_ptr->payloadLen; i++)
-				payload[i] = i;
-			
+
 			// Include frame number in header information
 			if (verbose) printf("Frame Num: %u\n", rxCBS_ptr->ce_ptr->frameNumber);
 
@@ -1335,7 +4562,8 @@ int rxCallback(unsigned char *  _header,
 			char mod[30] = "BPSK";
 			char FEC0[30] = "Hamming74";
 			char FEC1[30] = "none";
-			modulation_scheme ms = convertModScheme(mod, &rxCBS_ptr->ce_ptr->bitsPerSym);
+			unsigned int bps;
+			modulation_scheme ms = convertModScheme(mod, &bps);
 			printf("Setting transceiver parameters\n");
             rxCBS_ptr->txrx_ptr->set_tx_gain_uhd(25.0);
             rxCBS_ptr->txrx_ptr->set_tx_gain_soft(-8.0);
@@ -1352,7 +4580,7 @@ int rxCallback(unsigned char *  _header,
 			fec_scheme fec1 = convertFECScheme(FEC1, verbose);
 
 			// Replace with txcvr methods that allow access to samples:
-			rxCBS_ptr->txrx_ptr->assemble_frame(header, payload, rxCBS_ptr->ce_ptr->payloadLen, ms, fec0, fec1);
+			rxCBS_ptr->txrx_ptr->assemble_frame(header, payload, msg_len, ms, fec0, fec1);
 			printf("Assembled\n");
 			int isLastSymbol = 0;
 			while(!isLastSymbol)
@@ -1363,112 +4591,927 @@ int rxCallback(unsigned char *  _header,
 			rxCBS_ptr->txrx_ptr->end_transmit_frame();
 		}
 	}// End else (not the controller)
+#ifdef CRTS_PROFILE
+    // With USRPs the main thread resets and merges this profile while the
+    // receive thread keeps running, so both sides hold fb_mutex
+    if (rxCBS_ptr->usingUSRPs)
+        pthread_mutex_lock(&rxCBS_ptr->fb_ptr->fb_mutex);
+    PROFILE_LAP(rxCBS_ptr->profile_ptr, PROFILE_RX_CALLBACK, profile_t);
+    if (rxCBS_ptr->usingUSRPs)
+        pthread_mutex_unlock(&rxCBS_ptr->fb_ptr->fb_mutex);
+#endif
     return 0;
 
-} // end rxCallback()
+} // end rxCallback()
+
+ofdmflexframesync CreateFS(struct CognitiveEngine ce, struct Scenario sc, struct rxCBstruct* rxCBs_ptr)
+{
+     ofdmflexframesync fs =
+	     ofdmflexframesync_create(ce.numSubcarriers, ce.CPLen, ce.taperLen, NULL, rxCallback, (void *) rxCBs_ptr);
+
+     return fs;
+} // End CreateFS();
+
+struct frameSynchronizerBank CreateFrameSynchronizerBank() {
+    struct frameSynchronizerBank bank = {};
+    bank.num_entries = 0;
+    bank.uses = 0;
+    return bank;
+} // End CreateFrameSynchronizerBank()
+
+// Get a synchronizer for the CE's OFDM geometry, building it only the first time
+// the geometry is seen. When the bank is full the least recently used one is replaced.
+// The caller resets the synchronizer when switching to it.
+ofdmflexframesync getFrameSynchronizer(struct frameSynchronizerBank * bank, struct CognitiveEngine * ce, struct rxCBstruct * rxCBs_ptr)
+{
+    bank->uses++;
+
+    struct frameSynchronizerEntry * victim = NULL;
+    for (int i=0; i<bank->num_entries; i++)
+    {
+        struct frameSynchronizerEntry * e = &bank->entries[i];
+        if (e->numSubcarriers == ce->numSubcarriers && e->CPLen == ce->CPLen &&
+            e->taperLen == ce->taperLen && e->userdata == (void *) rxCBs_ptr)
+        {
+            e->lastUsed = bank->uses;
+            return e->fs;
+        }
+        if (victim == NULL || e->lastUsed < victim->lastUsed)
+            victim = e;
+    }
+
+    pthread_mutex_lock(&liquidCreateMutex);
+    if (bank->num_entries < FS_BANK_SIZE)
+        victim = &bank->entries[bank->num_entries++];
+    else
+        ofdmflexframesync_destroy(victim->fs);
+
+    victim->fs = ofdmflexframesync_create(ce->numSubcarriers, ce->CPLen, ce->taperLen, NULL, rxCallback, (void *) rxCBs_ptr);
+    pthread_mutex_unlock(&liquidCreateMutex);
+    victim->numSubcarriers = ce->numSubcarriers;
+    victim->CPLen = ce->CPLen;
+    victim->taperLen = ce->taperLen;
+    victim->userdata = (void *) rxCBs_ptr;
+    victim->lastUsed = bank->uses;
+    return victim->fs;
+} // End getFrameSynchronizer()
+
+void destroyFrameSynchronizerBank(struct frameSynchronizerBank * bank)
+{
+    pthread_mutex_lock(&liquidCreateMutex);
+    for (int i=0; i<bank->num_entries; i++)
+        ofdmflexframesync_destroy(bank->entries[i].fs);
+    pthread_mutex_unlock(&liquidCreateMutex);
+    bank->num_entries = 0;
+} // End destroyFrameSynchronizerBank()
+
+// Queue feedback from a node, dropping the oldest if the queue is full.
+// Called with the server's mutex held.
+void tcpServerPushFeedback(struct receiverNode * node, const struct feedbackStruct * fb)
+{
+    if (node->count == NODE_FEEDBACK_QUEUE_LEN)
+    {
+        node->head = (node->head + 1) % NODE_FEEDBACK_QUEUE_LEN;
+        node->count--;
+        node->dropped++;
+    }
+    feedbackStruct_copy(&node->queue[(node->head + node->count) % NODE_FEEDBACK_QUEUE_LEN], fb);
+    node->count++;
+} // End tcpServerPushFeedback()
+
+// Handle the complete messages in a node's receive buffer and keep the rest.
+// Returns the number of feedback messages queued, or -1 if the node sent
+// something that is not a valid message. Called with the server's mutex held.
+int tcpServerParse(struct receiverNode * node)
+{
+    int queued = 0;
+    unsigned int pos = 0;
+    struct wireHeader h;
+    while (node->rxlen - pos >= WIRE_HEADER_LEN)
+    {
+        if (wireDecodeHeader(node->rxbuf + pos, node->rxlen - pos, &h) != EX_OK)
+            return -1;
+        if (node->rxlen - pos < WIRE_HEADER_LEN + h.length)
+            break;
+        if (h.type == WIRE_MSG_FEEDBACK)
+        {
+            struct feedbackStruct fb = {};
+            if (wireDecodeFeedback(node->rxbuf + pos + WIRE_HEADER_LEN, h.length, &fb) != EX_OK)
+                return -1;
+            tcpServerPushFeedback(node, &fb);
+            queued++;
+        }
+        pos += WIRE_HEADER_LEN + h.length;
+    }
+    memmove(node->rxbuf, node->rxbuf + pos, node->rxlen - pos);
+    node->rxlen -= pos;
+    return queued;
+} // End tcpServerParse()
+
+// Called with the server's mutex held
+void tcpServerCloseNode(struct tcpServer * server, struct receiverNode * node)
+{
+    epoll_ctl(server->epollFD, EPOLL_CTL_DEL, node->fd, NULL);
+    close(node->fd);
+    node->fd = -1;
+    server->num_nodes--;
+} // End tcpServerCloseNode()
+
+// Accept every pending connection
+void tcpServerAccept(struct tcpServer * server)
+{
+    while (1)
+    {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept4(server->listenFD, (struct sockaddr *) &addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                fprintf(stderr, "ERROR: Server failed to accept a receiver: %s\n", strerror(errno));
+            return;
+        }
+
+        pthread_mutex_lock(&server->mutex);
+        struct receiverNode * node = NULL;
+        for (int i=0; i<MAX_RECEIVER_NODES && node == NULL; i++)
+            if (server->nodes[i].fd < 0)
+                node = &server->nodes[i];
+        if (node == NULL)
+        {
+            pthread_mutex_unlock(&server->mutex);
+            fprintf(stderr, "ERROR: At most %d receivers can connect. Refused %s\n", MAX_RECEIVER_NODES,
+                inet_ntoa(addr.sin_addr));
+            close(fd);
+            continue;
+        }
+
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *) &noDelay, sizeof(noDelay));
+        node->fd = fd;
+        node->addr = addr;
+        node->rxlen = 0;
+        node->txlen = 0;
+        node->overflowed = 0;
+        node->head = node->count = node->dropped = 0;
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.ptr = node;
+        if (epoll_ctl(server->epollFD, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            fprintf(stderr, "ERROR: epoll_ctl() failed for a receiver: %s\n", strerror(errno));
+            close(fd);
+            node->fd = -1;
+        }
+        else
+            server->num_nodes++;
+        pthread_mutex_unlock(&server->mutex);
+
+        if (server->verbose && node->fd >= 0)
+            printf("Receiver %d connected from %s\n", (int) (node - server->nodes), inet_ntoa(addr.sin_addr));
+    }
+} // End tcpServerAccept()
 
-ofdmflexframesync CreateFS(struct CognitiveEngine ce, struct Scenario sc, struct rxCBstruct* rxCBs_ptr)
+// Read everything a node has sent so far.
+// Returns the number of feedback messages queued, or -1 if the node should be closed.
+int tcpServerRead(struct tcpServer * server, struct receiverNode * node)
 {
-     ofdmflexframesync fs =
-	     ofdmflexframesync_create(ce.numSubcarriers, ce.CPLen, ce.taperLen, NULL, rxCallback, (void *) rxCBs_ptr);
+    int queued = 0;
+    while (1)
+    {
+        ssize_t n = recv(node->fd, node->rxbuf + node->rxlen, sizeof(node->rxbuf) - node->rxlen, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return queued;
+        if (n <= 0)
+            return -1;
+        node->rxlen += n;
+
+        pthread_mutex_lock(&server->mutex);
+        int q = tcpServerParse(node);
+        pthread_mutex_unlock(&server->mutex);
+        if (q < 0)
+        {
+            fprintf(stderr, "ERROR: Invalid message from receiver %d\n", (int) (node - server->nodes));
+            return -1;
+        }
+        queued += q;
+    }
+} // End tcpServerRead()
 
-     return fs;
-} // End CreateFS();
+// Write as much of a node's send buffer as the socket takes without blocking,
+// and only wait for the socket to become writable while some is left.
+// Called with the server's mutex held. Returns -1 if the node should be closed.
+int tcpServerFlush(struct tcpServer * server, struct receiverNode * node)
+{
+    unsigned int pos = 0;
+    while (pos < node->txlen)
+    {
+        ssize_t n = send(node->fd, node->txbuf + pos, node->txlen - pos, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+            return -1;
+        pos += n;
+    }
+    memmove(node->txbuf, node->txbuf + pos, node->txlen - pos);
+    node->txlen -= pos;
+
+    struct epoll_event ev = {};
+    ev.events = node->txlen > 0 ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.ptr = node;
+    return epoll_ctl(server->epollFD, EPOLL_CTL_MOD, node->fd, &ev);
+} // End tcpServerFlush()
+
+// Event loop of the controller's TCP server. Owns the listening socket
+// and every receiver connection until stopTCPServer() is called.
+void * tcpServerThread(void * _server)
+{
+    struct tcpServer * server = (struct tcpServer *) _server;
+    struct epoll_event events[TCP_SERVER_MAX_EVENTS];
 
-void * serveTCPclient(void * _sc_ptr){
-	struct serveClientStruct * sc_ptr = (struct serveClientStruct*) _sc_ptr;
-	struct feedbackStruct read_buffer;
-	int rflag;
-	// Write feedback to file
-
-	while(1){
-		rflag = recv(sc_ptr->client, &read_buffer, sizeof(struct feedbackStruct), 0);
-		if(rflag == 0 || rflag == -1){
-			close(sc_ptr->client);
-			printf("Socket failure\n");
-			exit(1);
-		}
-	}
+    while (1)
+    {
+        int n = epoll_wait(server->epollFD, events, TCP_SERVER_MAX_EVENTS, -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "ERROR: epoll_wait() failed: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        int queued = 0;
+        for (int i=0; i<n; i++)
+        {
+            if (events[i].data.ptr == (void *) &server->wakeFD)
+                return NULL;
+            if (events[i].data.ptr == (void *) &server->listenFD)
+            {
+                tcpServerAccept(server);
+                continue;
+            }
+
+            struct receiverNode * node = (struct receiverNode *) events[i].data.ptr;
+            if (node->fd < 0)
+                continue;       // Closed earlier in this batch
+            int q = 0;
+            pthread_mutex_lock(&server->mutex);
+            if ((events[i].events & EPOLLOUT) && !node->overflowed && tcpServerFlush(server, node) < 0)
+            {
+                fprintf(stderr, "ERROR: Failed to send to receiver %d: %s\n", (int) (node - server->nodes), strerror(errno));
+                q = -1;
+            }
+            pthread_mutex_unlock(&server->mutex);
+            if (q == 0 && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+                q = tcpServerRead(server, node);
+            if (q < 0)
+            {
+                if (server->verbose)
+                    printf("Receiver %d disconnected\n", (int) (node - server->nodes));
+                pthread_mutex_lock(&server->mutex);
+                tcpServerCloseNode(server, node);
+                pthread_mutex_unlock(&server->mutex);
+            }
+            else
+                queued += q;
+        }
+
+        // Wake the controller if it is waiting for feedback
+        if (queued > 0 && server->fb_ptr != NULL)
+        {
+            pthread_mutex_lock(&server->fb_ptr->fb_mutex);
+            server->fb_ptr->updates++;
+            pthread_cond_broadcast(&server->fb_ptr->fb_cond);
+            pthread_mutex_unlock(&server->fb_ptr->fb_mutex);
+        }
+    }
     return NULL;
-}
+} // End tcpServerThread()
 
-// Create a TCP socket for the server and bind it to a port
-// Then sit and listen/accept all connections and write the data
-// to an array that is accessible to the CE
-void * startTCPServer(void * _ss_ptr)
+// Create a TCP socket for the server, bind it to a port and start the
+// thread that accepts receivers and reads their feedback.
+// fb_ptr's condition is signalled whenever feedback arrives.
+void startTCPServer(struct tcpServer * server, unsigned int serverPort, struct feedbackStruct * fb_ptr, int verbose)
 {
-    struct serverThreadStruct * ss_ptr = (struct serverThreadStruct*) _ss_ptr;
-
     //  Local (server) address
-    struct sockaddr_in servAddr;   
-    // Parameters of client connection
-    struct sockaddr_in clientAddr;              // Client address 
-    socklen_t client_addr_size;  // Client address size
-    int socket_to_client = -1;
+    struct sockaddr_in servAddr;
     int reusePortOption = 1;
 
-	pthread_t TCPServeClientThread[5]; // Threads for clients
-	int client = 0; // Client counter
-        
-    // Create socket for incoming connections 
-    int sock_listen;
-    if ((sock_listen = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    server->fb_ptr = fb_ptr;
+    server->verbose = verbose;
+    server->num_nodes = 0;
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
+        server->nodes[i].fd = -1;
+    pthread_mutex_init(&server->mutex, NULL);
+
+    // Create socket for incoming connections
+    if ((server->listenFD = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
     {
         fprintf(stderr, "Transmitter Failed to Create Server Socket.\n");
         exit(EXIT_FAILURE);
     }
 
     // Allow reuse of a port. See http://stackoverflow.com/questions/14388706/socket-options-so-reuseaddr-and-so-reuseport-how-do-they-differ-do-they-mean-t
-    if (setsockopt(sock_listen, SOL_SOCKET, SO_REUSEPORT, (void*) &reusePortOption, sizeof(reusePortOption)) < 0 )
+    if (setsockopt(server->listenFD, SOL_SOCKET, SO_REUSEPORT, (void*) &reusePortOption, sizeof(reusePortOption)) < 0 )
     {
         fprintf(stderr, " setsockopt() failed\n");
         exit(EXIT_FAILURE);
     }
 
-    // Construct local (server) address structure 
-    memset(&servAddr, 0, sizeof(servAddr));       // Zero out structure 
-    servAddr.sin_family = AF_INET;                // Internet address family 
-    servAddr.sin_addr.s_addr = htonl(INADDR_ANY); // Any incoming interface 
-    servAddr.sin_port = htons(ss_ptr->serverPort);              // Local port 
+    // Construct local (server) address structure
+    memset(&servAddr, 0, sizeof(servAddr));       // Zero out structure
+    servAddr.sin_family = AF_INET;                // Internet address family
+    servAddr.sin_addr.s_addr = htonl(INADDR_ANY); // Any incoming interface
+    servAddr.sin_port = htons(serverPort);        // Local port
     // Bind to the local address to a port
-    if (bind(sock_listen, (struct sockaddr *) &servAddr, sizeof(servAddr)) < 0)
+    if (bind(server->listenFD, (struct sockaddr *) &servAddr, sizeof(servAddr)) < 0)
     {
         fprintf(stderr, "ERROR: bind() error\n");
         exit(EXIT_FAILURE);
     }
 
-    // Listen and accept connections indefinitely
-    while (1)
+    // Receivers may all connect at once
+    if (listen(server->listenFD, MAX_RECEIVER_NODES) < 0)
+    {
+        fprintf(stderr, "ERROR: Failed to Set Sleeping (listening) Mode\n");
+        exit(EXIT_FAILURE);
+    }
+
+    server->epollFD = epoll_create1(EPOLL_CLOEXEC);
+    server->wakeFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server->epollFD < 0 || server->wakeFD < 0)
+    {
+        fprintf(stderr, "ERROR: Failed to create the server's event loop: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.ptr = (void *) &server->listenFD;
+    epoll_ctl(server->epollFD, EPOLL_CTL_ADD, server->listenFD, &ev);
+    ev.data.ptr = (void *) &server->wakeFD;
+    epoll_ctl(server->epollFD, EPOLL_CTL_ADD, server->wakeFD, &ev);
+
+    pthread_create(&server->thread, NULL, tcpServerThread, (void *) server);
+} // End startTCPServer()
+
+// Stop the server thread, send what is left for each receiver and close
+// every connection
+void stopTCPServer(struct tcpServer * server)
+{
+    uint64_t one = 1;
+    if (write(server->wakeFD, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "ERROR: Failed to stop the TCP server\n");
+    pthread_join(server->thread, NULL);
+
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
     {
-        // listen for connections on socket
-        if (listen(sock_listen, MAXPENDING) < 0)
+        struct receiverNode * node = &server->nodes[i];
+        if (node->fd < 0)
+            continue;
+        if (node->txlen > 0 && !node->overflowed && sendAll(node->fd, node->txbuf, node->txlen) < 0)
+            fprintf(stderr, "ERROR: Failed to send to receiver %d: %s\n", i, strerror(errno));
+        tcpServerCloseNode(server, node);
+    }
+    close(server->listenFD);
+    close(server->epollFD);
+    close(server->wakeFD);
+    pthread_mutex_destroy(&server->mutex);
+} // End stopTCPServer()
+
+int tcpServerNumNodes(struct tcpServer * server)
+{
+    pthread_mutex_lock(&server->mutex);
+    int n = server->num_nodes;
+    pthread_mutex_unlock(&server->mutex);
+    return n;
+} // End tcpServerNumNodes()
+
+// Send a message to every connected receiver without waiting for any of
+// them. What a socket does not take at once is sent by the server thread.
+// A receiver whose send buffer is full is disconnected.
+// Returns the number of receivers the message was queued for.
+int tcpServerBroadcast(struct tcpServer * server, const unsigned char * buf, unsigned int len)
+{
+    int sent = 0;
+    pthread_mutex_lock(&server->mutex);
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
+    {
+        struct receiverNode * node = &server->nodes[i];
+        if (node->fd < 0 || node->overflowed)
+            continue;
+        if (node->txlen + len > sizeof(node->txbuf))
         {
-            fprintf(stderr, "ERROR: Failed to Set Sleeping (listening) Mode\n");
-            exit(EXIT_FAILURE);
+            // The server thread sees the connection end and closes it
+            fprintf(stderr, "ERROR: Receiver %d does not take the messages sent to it\n", i);
+            shutdown(node->fd, SHUT_RDWR);
+            node->overflowed = 1;
+            continue;
+        }
+        memcpy(node->txbuf + node->txlen, buf, len);
+        node->txlen += len;
+        // An error shows up as EPOLLERR in the server thread, which closes the node
+        tcpServerFlush(server, node);
+        sent++;
+    }
+    pthread_mutex_unlock(&server->mutex);
+    return sent;
+} // End tcpServerBroadcast()
+
+void timespecAddNs(struct timespec * t, long long ns)
+{
+    long long nsec = t->tv_nsec + ns % 1000000000LL;
+    t->tv_sec += ns / 1000000000LL + nsec / 1000000000LL;
+    nsec %= 1000000000LL;
+    if (nsec < 0)
+    {
+        nsec += 1000000000LL;
+        t->tv_sec--;
+    }
+    t->tv_nsec = nsec;
+} // End timespecAddNs()
+
+// a-b in nanoseconds
+long long timespecDiffNs(const struct timespec * a, const struct timespec * b)
+{
+    return (long long) (a->tv_sec - b->tv_sec)*1000000000LL + (a->tv_nsec - b->tv_nsec);
+} // End timespecDiffNs()
+
+// Start a grid of deadlines with the first one now
+void pacerStart(struct framePacer * p, long long interval_ns)
+{
+    memset(p, 0, sizeof(struct framePacer));
+    p->interval_ns = interval_ns > 0 ? interval_ns : 0;
+    clock_gettime(CLOCK_MONOTONIC, &p->next);
+} // End pacerStart()
+
+// Is the next frame's deadline here?
+int pacerDue(const struct framePacer * p)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespecDiffNs(&now, &p->next) >= 0;
+} // End pacerDue()
+
+// Block until the next frame's deadline and move on to the one after.
+// A frame released more than an interval late restarts the grid from
+// now rather than letting the frames behind it go out in a burst.
+void pacerWait(struct framePacer * p)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timespecDiffNs(&p->next, &now) > PACER_SPIN_NS)
+    {
+        struct timespec wake = p->next;
+        timespecAddNs(&wake, -PACER_SPIN_NS);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+            ;
+    }
+    do
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    while (timespecDiffNs(&now, &p->next) < 0);
+
+    long long late = timespecDiffNs(&now, &p->next);
+    p->frames++;
+    p->sum_ns += (double) late;
+    p->sumsq_ns += (double) late*(double) late;
+    if (late > p->max_ns)
+        p->max_ns = late;
+    if (late > p->interval_ns)
+    {
+        if (p->interval_ns > 0)
+            p->overruns++;
+        p->next = now;
+    }
+    timespecAddNs(&p->next, p->interval_ns);
+} // End pacerWait()
+
+// Print how closely the frames kept to their deadlines
+void pacerReport(const struct framePacer * p, FILE * f)
+{
+    double n = p->frames > 0 ? (double) p->frames : 1.0;
+    double mean = p->sum_ns/n;
+    double var = p->sumsq_ns/n - mean*mean;
+    fprintf(f, "Pacing: %u frames, interval %.1f us, lateness mean %.1f us, std dev %.1f us, max %.1f us, %u overrun(s)\n",
+        p->frames, p->interval_ns/1e3, mean/1e3, var > 0.0 ? sqrt(var)/1e3 : 0.0, p->max_ns/1e3, p->overruns);
+} // End pacerReport()
+
+void crtsClockStartWall(struct crtsClock * c)
+{
+    memset(c, 0, sizeof(struct crtsClock));
+    c->type = CRTS_CLOCK_WALL;
+    clock_gettime(CLOCK_MONOTONIC, &c->start);
+} // End crtsClockStartWall()
+
+void crtsClockStartVirtual(struct crtsClock * c, double sampleRate)
+{
+    memset(c, 0, sizeof(struct crtsClock));
+    c->type = CRTS_CLOCK_VIRTUAL;
+    c->sampleRate = sampleRate;
+} // End crtsClockStartVirtual()
+
+// Move a virtual clock on by the air time of num_samples samples
+void crtsClockAdvance(struct crtsClock * c, unsigned int num_samples)
+{
+    c->samples += num_samples;
+} // End crtsClockAdvance()
+
+// Seconds since the clock was started
+double crtsClockNow(const struct crtsClock * c)
+{
+    if (c->type == CRTS_CLOCK_VIRTUAL)
+        return c->sampleRate > 0.0 ? (double) c->samples/c->sampleRate : 0.0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timespecDiffNs(&now, &c->start)*1e-9;
+} // End crtsClockNow()
+
+const char * crtsClockName(const struct crtsClock * c)
+{
+    return c->type == CRTS_CLOCK_VIRTUAL ? "virtual" : "wall";
+} // End crtsClockName()
+
+// The in-flight frame with number frameNumber, or NULL if it is not in flight
+struct inFlightFrame * inFlightFind(struct inFlightTable * t, unsigned int frameNumber)
+{
+    // Unsigned, so frames older than 'oldest' are out of range too
+    if (frameNumber - t->oldest >= t->count)
+        return NULL;
+    return &t->frames[frameNumber % MAX_FRAMES_IN_FLIGHT];
+} // End inFlightFind()
+
+// Add a frame that has just been sent. Frames must be added in order
+// of their numbers, and at most MAX_FRAMES_IN_FLIGHT at once.
+struct inFlightFrame * inFlightAdd(struct inFlightTable * t, unsigned int frameNumber, long timeout_ns)
+{
+    if (t->count == 0)
+        t->oldest = frameNumber;
+    t->count++;
+
+    struct inFlightFrame * f = &t->frames[frameNumber % MAX_FRAMES_IN_FLIGHT];
+    f->frameNumber = frameNumber;
+    f->target = -1;
+    f->ce = NULL;
+    f->otaReceived = 0;
+    f->rf.num_nodes = 0;
+    f->rf.reports = 0;
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
+        f->rf.received[i] = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &f->deadline);
+    timespecAddNs(&f->deadline, timeout_ns);
+    return f;
+} // End inFlightAdd()
+
+// Remove the oldest frame once its feedback has been used
+void inFlightRetireOldest(struct inFlightTable * t)
+{
+    t->oldest++;
+    t->count--;
+} // End inFlightRetireOldest()
+
+// Note which receivers are connected now. Only their reports on f count.
+void inFlightUpdateNodes(struct inFlightFrame * f, const int * connected)
+{
+    f->rf.num_nodes = 0;
+    f->rf.reports = 0;
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
+    {
+        f->rf.connected[i] = connected[i];
+        f->rf.num_nodes += connected[i] != 0;
+        f->rf.reports += connected[i] && f->rf.received[i];
+    }
+} // End inFlightUpdateNodes()
+
+// Has the time to wait for feedback on f run out?
+int inFlightExpired(const struct inFlightFrame * f, const struct timespec * now)
+{
+    return timespecDiffNs(now, &f->deadline) >= 0;
+} // End inFlightExpired()
+
+// Is there nothing more to wait for on f? That is when every connected
+// receiver has reported on it, or, with no receiver connected, when its
+// feedback was heard over the air, or when its time has run out.
+int inFlightComplete(const struct inFlightFrame * f, const struct timespec * now)
+{
+    if (f->rf.num_nodes > 0 ? f->rf.reports >= f->rf.num_nodes : f->otaReceived)
+        return 1;
+    return inFlightExpired(f, now);
+} // End inFlightComplete()
+
+// Empty the feedback queues of all receivers into the frames in flight.
+// Feedback on frames that are no longer in flight arrived too late and
+// is discarded. Returns the number of reports that were kept.
+int tcpServerCollectFeedback(struct tcpServer * server, struct inFlightTable * t)
+{
+    int kept = 0;
+    pthread_mutex_lock(&server->mutex);
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
+    {
+        struct receiverNode * node = &server->nodes[i];
+        for (; node->count > 0; node->count--)
+        {
+            struct feedbackStruct * queued = &node->queue[node->head];
+            struct inFlightFrame * f = inFlightFind(t, queued->iteration);
+            if (f != NULL && !f->rf.received[i])
+            {
+                feedbackStruct_copy(&f->rf.fb[i], queued);
+                f->rf.received[i] = 1;
+                kept++;
+            }
+            node->head = (node->head + 1) % NODE_FEEDBACK_QUEUE_LEN;
         }
+    }
+    pthread_mutex_unlock(&server->mutex);
+    return kept;
+} // End tcpServerCollectFeedback()
+
+// What a receiver reported on a frame. A receiver that did not report in
+// time is taken to have lost the frame.
+void receiverFeedbackFor(struct receiverFeedback * rf, int node, unsigned int frameNumber, struct feedbackStruct * fb)
+{
+    if (rf->received[node])
+    {
+        feedbackStruct_copy(fb, &rf->fb[node]);
+        return;
+    }
+    struct feedbackStruct lost = {};
+    lost.iteration = frameNumber;
+    feedbackStruct_copy(fb, &lost);
+} // End receiverFeedbackFor()
+
+// Is a worse than b? Lost payloads come first, then lost headers,
+// more bit errors and higher EVM.
+int feedbackWorse(const struct feedbackStruct * a, const struct feedbackStruct * b)
+{
+    if (a->payload_valid != b->payload_valid)
+        return a->payload_valid < b->payload_valid;
+    if (a->header_valid != b->header_valid)
+        return a->header_valid < b->header_valid;
+    if (a->payloadBitErrors != b->payloadBitErrors)
+        return a->payloadBitErrors > b->payloadBitErrors;
+    return a->evm > b->evm;
+} // End feedbackWorse()
+
+// Combine the receivers' feedback on a frame into fb, the feedback the CE sees.
+// With FB_AGGREGATE_PER_NODE only the frame's target receiver is used.
+// Does nothing and returns 0 if no receiver is connected.
+int aggregateFeedback(enum feedbackAggregationType policy, struct receiverFeedback * rf, unsigned int frameNumber,
+    int target, struct feedbackStruct * fb)
+{
+    if (rf->num_nodes == 0)
+        return 0;
 
-        // Accept a connection from client
-        socket_to_client = accept(sock_listen, (struct sockaddr *)&clientAddr, &client_addr_size);
-        if(socket_to_client< 0)
+    struct feedbackStruct nodeFb;
+    switch (policy)
+    {
+    case FB_AGGREGATE_PER_NODE:
+        receiverFeedbackFor(rf, target, frameNumber, fb);
+        break;
+    case FB_AGGREGATE_MEAN:
+    {
+        // Frames count as received when at least half of the receivers got them.
+        // Measurements are averaged over the receivers that reported.
+        int headers = 0, payloads = 0;
+        double len = 0.0, byteErrors = 0.0, bitErrors = 0.0, evm = 0.0, rssi = 0.0, cfo = 0.0;
+        for (int i=0; i<MAX_RECEIVER_NODES; i++)
         {
-            fprintf(stderr, "ERROR: Sever Failed to Connect to Client\n");
-            exit(EXIT_FAILURE);
+            if (!rf->connected[i])
+                continue;
+            receiverFeedbackFor(rf, i, frameNumber, &nodeFb);
+            headers += nodeFb.header_valid;
+            payloads += nodeFb.payload_valid;
+            if (!rf->received[i])
+                continue;
+            len += nodeFb.payload_len;
+            byteErrors += nodeFb.payloadByteErrors;
+            bitErrors += nodeFb.payloadBitErrors;
+            evm += nodeFb.evm;
+            rssi += nodeFb.rssi;
+            cfo += nodeFb.cfo;
         }
-		// Create separate thread for each client as they are accepted.
-		else {
-			struct serveClientStruct sc = CreateServeClientStruct();
-			sc.client = socket_to_client;
-			sc.fb_ptr = ss_ptr->fb_ptr;
-			sc.OTA = ss_ptr->OTA;
-			sc.usingUSRPs = ss_ptr->usingUSRPs;
-			pthread_create( &TCPServeClientThread[client], NULL, serveTCPclient, (void*) &sc);
-			client++;
-			*ss_ptr->client_ptr = socket_to_client;
-		}
-	}// End While loop	
-} // End startTCPServer()
+        int n = rf->reports > 0 ? rf->reports : 1;
+        struct feedbackStruct mean = {};
+        mean.header_valid = 2*headers >= rf->num_nodes;
+        mean.payload_valid = 2*payloads >= rf->num_nodes;
+        mean.payload_len = (unsigned int) (len/n + 0.5);
+        mean.payloadByteErrors = (unsigned int) (byteErrors/n + 0.5);
+        mean.payloadBitErrors = (unsigned int) (bitErrors/n + 0.5);
+        mean.iteration = frameNumber;
+        mean.evm = evm/n;
+        mean.rssi = rssi/n;
+        mean.cfo = cfo/n;
+        feedbackStruct_copy(fb, &mean);
+        break;
+    }
+    default:
+    {
+        int first = 1;
+        for (int i=0; i<MAX_RECEIVER_NODES; i++)
+        {
+            if (!rf->connected[i])
+                continue;
+            receiverFeedbackFor(rf, i, frameNumber, &nodeFb);
+            if (first || feedbackWorse(&nodeFb, fb))
+                feedbackStruct_copy(fb, &nodeFb);
+            first = 0;
+        }
+        break;
+    }
+    }
+    return rf->reports;
+} // End aggregateFeedback()
+
+// Mark the receivers that are connected. Returns how many there are.
+int tcpServerConnectedNodes(struct tcpServer * server, int * connected)
+{
+    int n = 0;
+    pthread_mutex_lock(&server->mutex);
+    for (int i=0; i<MAX_RECEIVER_NODES; i++)
+    {
+        connected[i] = server->nodes[i].fd >= 0;
+        n += connected[i];
+    }
+    pthread_mutex_unlock(&server->mutex);
+    return n;
+} // End tcpServerConnectedNodes()
 
-int ceProcessData(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, int verbose)
+// The next active receiver after 'last', in turn. -1 if none is active.
+int nextTargetNode(const int * active, int last)
+{
+    for (int k=1; k<=MAX_RECEIVER_NODES; k++)
+    {
+        int i = (last + k + MAX_RECEIVER_NODES) % MAX_RECEIVER_NODES;
+        if (active[i])
+            return i;
+    }
+    return -1;
+} // End nextTargetNode()
+
+// Send the CE under test to every receiver
+void sendCognitiveEngine(struct tcpServer * server, const struct CognitiveEngine * ce)
+{
+    unsigned char buf[WIRE_HEADER_LEN + WIRE_MAX_BODY_LEN];
+    unsigned int len = wireEncodeCognitiveEngine(buf, sizeof(buf), ce);
+    if (len == 0)
+    {
+        fprintf(stderr, "ERROR: CE info does not fit in a message\n");
+        exit(EX_SOFTWARE);
+    }
+    if (tcpServerBroadcast(server, buf, len) == 0)
+        fprintf(stderr, "WARNING: No receiver is connected\n");
+} // End sendCognitiveEngine()
+
+// Send the scenario under test to every receiver
+void sendScenario(struct tcpServer * server, const struct Scenario * sc)
+{
+    unsigned char buf[WIRE_HEADER_LEN + WIRE_MAX_BODY_LEN];
+    unsigned int len = wireEncodeScenario(buf, sizeof(buf), sc);
+    if (len == 0)
+    {
+        fprintf(stderr, "ERROR: Scenario info does not fit in a message\n");
+        exit(EX_SOFTWARE);
+    }
+    if (tcpServerBroadcast(server, buf, len) == 0)
+        fprintf(stderr, "WARNING: No receiver is connected\n");
+} // End sendScenario()
+
+// Goal values, indexed by ceGoalType
+typedef float (*ceGoalFunction)(struct CognitiveEngine *, struct feedbackStruct *);
+
+float ceGoalPayloadValid(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return fbPtr->payload_valid; }
+float ceGoalValidPayloads(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return (float) ce->validPayloads; }
+float ceGoalErrorFreePayloads(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return (float) ce->errorFreePayloads; }
+float ceGoalFrames(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return (float) ce->frameNumber; }
+float ceGoalSeconds(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->runningTime; }
+
+static const ceGoalFunction ceGoalFunctions[NUM_CE_GOALS] = {
+    ceGoalPayloadValid, ceGoalValidPayloads, ceGoalErrorFreePayloads, ceGoalFrames, ceGoalSeconds};
+
+// Adaptation conditions, indexed by ceConditionType
+typedef int (*ceConditionFunction)(struct CognitiveEngine *, struct feedbackStruct *);
+
+int ceConditionNone(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return 0; }
+int ceConditionAlways(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return 1; }
+int ceConditionLastPayloadInvalid(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return fbPtr->payload_valid < 1; }
+int ceConditionWeightedAvgLT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->weightedAvg < ce->weighted_avg_payload_valid_threshold; }
+int ceConditionWeightedAvgGT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->weightedAvg > ce->weighted_avg_payload_valid_threshold; }
+int ceConditionPERLT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->PER < ce->PER_threshold; }
+int ceConditionPERGT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->PER > ce->PER_threshold; }
+int ceConditionBERLT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->BER < ce->BER_threshold; }
+int ceConditionBERGT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->BER > ce->BER_threshold; }
+int ceConditionLastPacketErrorFree(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return !(fbPtr->payloadBitErrors); }
+int ceConditionPERVarianceLT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->PER_stats.variance() < ce->PER_variance_threshold; }
+int ceConditionPERVarianceGT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->PER_stats.variance() > ce->PER_variance_threshold; }
+int ceConditionBERQuantileLT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->BER_stats.quantile(ce->BER_quantile) < ce->BER_threshold; }
+int ceConditionBERQuantileGT(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr) { return ce->BER_stats.quantile(ce->BER_quantile) > ce->BER_threshold; }
+
+static const ceConditionFunction ceConditionFunctions[NUM_CE_CONDITIONS] = {
+    ceConditionNone, ceConditionAlways, ceConditionLastPayloadInvalid, ceConditionWeightedAvgLT,
+    ceConditionWeightedAvgGT, ceConditionPERLT, ceConditionPERGT, ceConditionBERLT, ceConditionBERGT,
+    ceConditionLastPacketErrorFree, ceConditionPERVarianceLT, ceConditionPERVarianceGT,
+    ceConditionBERQuantileLT, ceConditionBERQuantileGT};
+
+// Adaptations, indexed by ceAdaptationType
+typedef void (*ceAdaptationFunction)(struct CognitiveEngine *);
+
+void ceAdaptNone(struct CognitiveEngine * ce) {}
+
+void ceAdaptIncreasePayloadLen(struct CognitiveEngine * ce)
+{
+    if (ce->payloadLen + ce->payloadLenIncrement <= ce->payloadLenMax)
+        ce->payloadLen += ce->payloadLenIncrement;
+} // End ceAdaptIncreasePayloadLen()
+
+void ceAdaptDecreasePayloadLen(struct CognitiveEngine * ce)
+{
+    if (ce->payloadLen - ce->payloadLenIncrement >= ce->payloadLenMin)
+        ce->payloadLen -= ce->payloadLenIncrement;
+} // End ceAdaptDecreasePayloadLen()
+
+void ceAdaptDecreaseModSchemePSK(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    ceSetMCS(ce, pskDown[mcs->mod], mcs->fec0, mcs->fec1);
+} // End ceAdaptDecreaseModSchemePSK()
+
+void ceAdaptDecreaseModSchemeASK(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    ceSetMCS(ce, askDown[mcs->mod], mcs->fec0, mcs->fec1);
+} // End ceAdaptDecreaseModSchemeASK()
+
+void ceAdaptOuterFECOnOff(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    // Turn FEC off
+    if (ce->FECswitch == 1) {
+        ce->outerFEC_prev = mcs->fec1;
+        ceSetMCS(ce, mcs->mod, mcs->fec0, 0);
+        ce->FECswitch = 0;
+    }
+    // Turn FEC on
+    else {
+        ceSetMCS(ce, mcs->mod, mcs->fec0, ce->outerFEC_prev);
+        ce->FECswitch = 1;
+    }
+} // End ceAdaptOuterFECOnOff()
+
+void ceAdaptNoFEC(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    ceSetMCS(ce, mcs->mod, mcs->fec0, 0);
+} // End ceAdaptNoFEC()
+
+// Step the outer FEC to the next or previous entry of fecSchemeNames. That
+// list is not ordered by protection, so a step can weaken the code.
+void ceAdaptIncreaseFEC(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    if (mcs->fec1+1u < NUM_FEC_SCHEME_NAMES)
+        ceSetMCS(ce, mcs->mod, mcs->fec0, mcs->fec1+1);
+} // End ceAdaptIncreaseFEC()
+
+void ceAdaptDecreaseFEC(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    if (mcs->fec1 > 0)
+        ceSetMCS(ce, mcs->mod, mcs->fec0, mcs->fec1-1);
+} // End ceAdaptDecreaseFEC()
+
+void ceAdaptSetModScheme(struct CognitiveEngine * ce)
+{
+    const struct mcsEntry * mcs = ceMCS(ce);
+    ceSetMCS(ce, ce->adaptationModScheme, mcs->fec0, mcs->fec1);
+} // End ceAdaptSetModScheme()
+
+void ceAdaptIncreaseMCS(struct CognitiveEngine * ce)
+{
+    ce->mcsIndex = mcsLadderStep(ce->mcsIndex, 1);
+} // End ceAdaptIncreaseMCS()
+
+void ceAdaptDecreaseMCS(struct CognitiveEngine * ce)
+{
+    ce->mcsIndex = mcsLadderStep(ce->mcsIndex, -1);
+} // End ceAdaptDecreaseMCS()
+
+void ceAdaptSetMCSEfficiency(struct CognitiveEngine * ce)
+{
+    ce->mcsIndex = ce->adaptationMCSIndex;
+} // End ceAdaptSetMCSEfficiency()
+
+static const ceAdaptationFunction ceAdaptationFunctions[NUM_CE_ADAPTATIONS] = {
+    ceAdaptNone, ceAdaptIncreasePayloadLen, ceAdaptDecreasePayloadLen, ceAdaptDecreaseModSchemePSK,
+    ceAdaptDecreaseModSchemeASK, ceAdaptOuterFECOnOff, ceAdaptNoFEC, ceAdaptIncreaseFEC, ceAdaptDecreaseFEC,
+    ceAdaptSetModScheme, ceAdaptIncreaseMCS, ceAdaptDecreaseMCS, ceAdaptSetMCSEfficiency};
+
+int ceProcessData(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, const struct txFrameParams * sent, int verbose)
 {
     if (verbose)
     {
@@ -1478,53 +5521,30 @@ int ceProcessData(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, in
 
     ce->validPayloads += fbPtr->payload_valid;
 
-    if (fbPtr->payload_valid && (!(fbPtr->payloadBitErrors)))
+    int errorFree = fbPtr->payload_valid && (!(fbPtr->payloadBitErrors));
+    if (errorFree)
     {
         ce->errorFreePayloads++;
-		ce->errorFreePayloads_RA_ptr->update(1.0);
         if (verbose) printf("Error Free payload!\n");
     }
 
     ce->PER = ((float)ce->frameNumber-(float)ce->errorFreePayloads)/((float)ce->frameNumber);
     ce->lastReceivedFrame = fbPtr->iteration;
-    ce->BER = ((float)fbPtr->payloadBitErrors)/((float)(ce->payloadLen*8));
+    ce->BER = ((float)fbPtr->payloadBitErrors)/((float)(sent->payloadLen*8));
     ce->weightedAvg += (float) fbPtr->payload_valid;
 
-	ce->BER_RA_ptr->update(ce->BER);
-	ce->PER_RA_ptr->update(ce->PER);
-	ce->validPayloads_RA_ptr->update((float)fbPtr->payload_valid);
+	ce->BER_stats.update(ce->BER);
+	ce->PER_stats.update(ce->PER);
+	ce->validPayloads_stats.update((float)fbPtr->payload_valid);
+	ce->errorFreePayloads_stats.update((float)errorFree);
+	ce->BER_avg = ce->BER_stats.mean();
+	ce->PER_avg = ce->PER_stats.mean();
+	ce->validPayloads_avg = ce->validPayloads_stats.mean();
+	ce->errorFreePayloads_avg = ce->errorFreePayloads_stats.mean();
 
     // Update goal value
-    if (strcmp(ce->goal, "payload_valid") == 0)
-    {
-        if (verbose) printf("Goal is payload_valid. Setting latestGoalValue to %d\n", fbPtr->payload_valid);
-        ce->latestGoalValue = fbPtr->payload_valid;
-    }
-    else if (strcmp(ce->goal, "X_valid_payloads") == 0)
-    {
-        if (verbose) printf("Goal is X_valid_payloads. Setting latestGoalValue to %u\n", ce->validPayloads);
-        ce->latestGoalValue = (float) ce->validPayloads;
-    }
-    else if (strcmp(ce->goal, "X_errorFreePayloads") == 0)
-    {
-        if (verbose) printf("Goal is X_errorFreePayloads. Setting latestGoalValue to %u\n", ce->errorFreePayloads);
-        ce->latestGoalValue  = (float) ce->errorFreePayloads;
-    }
-    else if (strcmp(ce->goal, "X_frames") == 0)
-    {
-        if (verbose) printf("Goal is X_frames. Setting latestGoalValue to %u\n", ce->frameNumber);
-        ce->latestGoalValue  = (float) ce->frameNumber;
-    }
-    else if (strcmp(ce->goal, "X_seconds") == 0)
-    {       
-		if (verbose) printf("Goal is X_seconds. Setting latestGoalValue to %f\n", ce->runningTime);
-        ce->latestGoalValue = ce->runningTime;
-    }
-    else
-    {
-        fprintf(stderr, "ERROR: Unknown Goal!\n");
-        exit(EXIT_FAILURE);
-    }
+    ce->latestGoalValue = ceGoalFunctions[ce->goal](ce, fbPtr);
+    if (verbose) printf("Goal is %s. Setting latestGoalValue to %f\n", ceGoalNames[ce->goal], ce->latestGoalValue);
     // TODO: implement if statements for other possible goals
 
     return 1;
@@ -1533,9 +5553,8 @@ int ceProcessData(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, in
 int ceOptimized(struct CognitiveEngine * ce, int verbose)
 {
 	// Update running average
-	ce->averagedGoalValue -= ce->goal_mem[ce->iteration%ce->goal_averaging]/ce->goal_averaging;
-	ce->averagedGoalValue += ce->latestGoalValue/ce->goal_averaging;
-	ce->goal_mem[ce->iteration%ce->goal_averaging] = ce->latestGoalValue;
+	ce->goal_stats.update(ce->latestGoalValue);
+	ce->averagedGoalValue = ce->goal_stats.mean();
 	
    	if(ce->frameNumber>ce->goal_averaging){
 		if (verbose) 
@@ -1554,300 +5573,98 @@ int ceOptimized(struct CognitiveEngine * ce, int verbose)
    	return 0;
 } // end ceOptimized()
 
-int ceModifyTxParams(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, int verbose)
+// Let the CE's plugin decide on the next frame's parameters
+int cePluginModifyTxParams(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, int verbose)
 {
-    int modify = 0;
-
-
-    if (verbose) printf("ce->adaptationCondition= %s\n", ce->adaptationCondition);
-
-    // Add 'user input' adaptation
-    if(strcmp(ce->adaptationCondition, "user_specified") == 0) {
-        // Check if parameters should be modified
-        modify = 1;
-        if (verbose) printf("user specified adaptation mode. Modifying...\n");
-    }
-
-    // Check what values determine if parameters should be modified
-    if(strcmp(ce->adaptationCondition, "last_payload_invalid") == 0) {
-        // Check if parameters should be modified
-        if(fbPtr->payload_valid<1)
-        {
-            modify = 1;
-            if (verbose) printf("lpi. Modifying...\n");
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "weighted_avg_payload_valid<X") == 0) {
-        // Check if parameters should be modified
-        if (ce->weightedAvg < ce->weighted_avg_payload_valid_threshold)
-        {
-            modify = 1;
-            if (verbose) printf("wapv<X. Modifying...\n");
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "weighted_avg_payload_valid>X") == 0) {
-        // Check if parameters should be modified
-        if (ce->weightedAvg > ce->weighted_avg_payload_valid_threshold)
-        {
-            modify = 1;
-            if (verbose) printf("wapv>X. Modifying...\n");
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "PER<X") == 0) {
-        // Check if parameters should be modified
-        if (verbose) printf("PER = %f\n", ce->PER);
-        if(ce->PER < ce->PER_threshold)
-        {
-            modify = 1;
-            if (verbose) printf("per<x. Modifying...\n" );
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "PER>X") == 0) {
-        // Check if parameters should be modified
-        if (verbose) printf("PER = %f\n", ce->PER);
-        if(ce->PER > ce->PER_threshold)
-        {
-            modify = 1;
-            if (verbose) printf("per>x. Modifying...\n" );
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "BER_lastPacket<X") == 0) {
-        // Check if parameters should be modified
-        if (verbose) printf("BER = %f\n", ce->BER);
-        if(ce->BER < ce->BER_threshold)
-        {
-            modify = 1;
-            if (verbose) printf("Ber_lastpacket<x. Modifying...\n" );
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "BER_lastPacket>X") == 0) {
-        // Check if parameters should be modified
-        if (verbose) printf("BER = %f\n", ce->BER);
-        if(ce->BER > ce->BER_threshold)
-        {
-            modify = 1;
-            if (verbose) printf("Ber_lastpacket>x. Modifying...\n" );
-        }
-    }
-    if(strcmp(ce->adaptationCondition, "last_packet_error_free") == 0) {
-        // Check if parameters should be modified
-        if(!(fbPtr->payloadBitErrors)){
-            modify = 1;
-            if (verbose) printf("lpef. Modifying...\n");
-        }
-    }
-
-    // If so, modify the specified parameter
-    if (modify) 
+    const struct mcsEntry * mcs = ceMCS(ce);
+    struct crts_ce_metrics metrics;
+    metrics.frameNumber = ce->frameNumber;
+    metrics.runningTime = ce->runningTime;
+    metrics.PER = ce->PER;
+    metrics.PER_avg = ce->PER_avg;
+    metrics.BER = ce->BER;
+    metrics.BER_avg = ce->BER_avg;
+    metrics.validPayloads = ce->validPayloads;
+    metrics.errorFreePayloads = ce->errorFreePayloads;
+    metrics.latestGoalValue = ce->latestGoalValue;
+    metrics.averagedGoalValue = ce->averagedGoalValue;
+    metrics.mcs_index = mcsLadderRung(ce->mcsIndex);
+    metrics.num_mcs = NUM_MCS_LADDER;
+    metrics.bits_per_symbol = mcs->bitsPerSymbol;
+    metrics.code_rate = mcs->rate;
+    metrics.efficiency = mcs->efficiency;
+    metrics.payloadLen = ce->payloadLen;
+    metrics.txgain_dB = ce->txgain_dB;
+
+    struct crts_ce_delta delta;
+    memset(&delta, 0, sizeof(delta));
+
+    struct cePlugin * plugin = ce->plugin_ptr;
+    if (plugin->desc->decide(plugin->state, (const struct crts_ce_feedback *) fbPtr, &metrics, &delta) != 0)
     {
-        if (verbose) printf("Modifying Tx parameters...\n");
-        // TODO: Implement a similar if statement for each possible option
-        // that can be adapted.
-
-        if(strcmp(ce->adaptationCondition, "user_specified") == 0) {
-            // Check if parameters should be modified
-            if (verbose) printf("Reading user specified adaptations from user ce file: 'userEngine.txt'\n");
-            readCEConfigFile(ce, (char*) "userEngine.txt", verbose);
-        }
+        fprintf(stderr, "ERROR: CE plugin %s failed\n", plugin->desc->name ? plugin->desc->name : ce->pluginPath);
+        exit(EXIT_FAILURE);
+    }
 
-        if (strcmp(ce->adaptation, "increase_payload_len") == 0) {
-            if (ce->payloadLen + ce->payloadLenIncrement <= ce->payloadLenMax) 
-            {
-                ce->payloadLen += ce->payloadLenIncrement;
-            }
-        }
+    if (delta.set & CRTS_CE_SET_MCS_INDEX)
+        ce->mcsIndex = mcsLadder[std::min(delta.mcs_index, (unsigned int) NUM_MCS_LADDER-1)];
+    if (delta.set & CRTS_CE_SET_MCS_EFFICIENCY)
+        ce->mcsIndex = mcsIndexForEfficiency(delta.efficiency);
+    if (delta.set & CRTS_CE_SET_MCS_STEP)
+        ce->mcsIndex = mcsLadderStep(ce->mcsIndex, delta.mcs_step);
+    if (delta.set & CRTS_CE_SET_PAYLOAD_LEN)
+        ce->payloadLen = std::max(ce->payloadLenMin, std::min(delta.payloadLen, ce->payloadLenMax));
+    if (delta.set & CRTS_CE_SET_TXGAIN_DB)
+        ce->txgain_dB = delta.txgain_dB;
+
+    if (verbose && delta.set)
+        printf("CE plugin set modulation %s, inner FEC %s, outer FEC %s, payloadLen %u, txgain_dB %f\n",
+            modSchemeName(ceModScheme(ce)), fecSchemeName(ceInnerFEC(ce)), fecSchemeName(ceOuterFEC(ce)),
+            ce->payloadLen, ce->txgain_dB);
+    return 1;
+} // End cePluginModifyTxParams()
 
-        if (strcmp(ce->adaptation, "decrease_payload_len") == 0) {
-            if (ce->payloadLen - ce->payloadLenIncrement >= ce->payloadLenMin) 
-            {
-                ce->payloadLen -= ce->payloadLenIncrement;
-            }
-        }
+int ceModifyTxParams(struct CognitiveEngine * ce, struct feedbackStruct * fbPtr, const struct txFrameParams * sent, int verbose)
+{
+    // A plugin or a learning engine replaces the built in adaptations
+    if (ce->plugin_ptr != NULL)
+        return cePluginModifyTxParams(ce, fbPtr, verbose);
+    if (ce->learning_ptr != NULL)
+        return learningModifyTxParams(ce, fbPtr, sent, verbose);
 
-        if (strcmp(ce->adaptation, "decrease_mod_scheme_PSK") == 0) {
-            if (strcmp(ce->modScheme, "QPSK") == 0) {
-                strcpy(ce->modScheme, "BPSK");
-            }
-            if (strcmp(ce->modScheme, "8PSK") == 0) {
-                strcpy(ce->modScheme, "QPSK");
-            }
-            if (strcmp(ce->modScheme, "16PSK") == 0) {
-                strcpy(ce->modScheme, "8PSK");
-            }
-            if (strcmp(ce->modScheme, "32PSK") == 0) {
-                strcpy(ce->modScheme, "16PSK");
-            }
-            if (strcmp(ce->modScheme, "64PSK") == 0) {
-                strcpy(ce->modScheme, "32PSK");
-            }
-            if (strcmp(ce->modScheme, "128PSK") == 0) {
-                strcpy(ce->modScheme, "64PSK");
-            }
-        }
-        // Decrease ASK Modulations
-        if (strcmp(ce->adaptation, "decrease_mod_scheme_ASK") == 0) {
-            if (strcmp(ce->modScheme, "4ASK") == 0) {
-                strcpy(ce->modScheme, "BASK");
-            }
-            if (strcmp(ce->modScheme, "8ASK") == 0) {
-                strcpy(ce->modScheme, "4ASK");
-            }
-            if (strcmp(ce->modScheme, "16ASK") == 0) {
-                strcpy(ce->modScheme, "8ASK");
-            }
-            if (strcmp(ce->modScheme, "32ASK") == 0) {
-                strcpy(ce->modScheme, "16ASK");
-	    }
-            if (strcmp(ce->modScheme, "64ASK") == 0) {
-                strcpy(ce->modScheme, "32ASK");
-            }
-            if (strcmp(ce->modScheme, "128ASK") == 0) {
-                strcpy(ce->modScheme, "64ASK");
-            }
-        }
-	// Turn outer FEC on/off
-   	if (strcmp(ce->adaptation, "Outer FEC On/Off") == 0){
-        if (verbose) printf("Adapt option: outer fec on/off. adapting...\n");
-   	    // Turn FEC off
-   	    if (ce->FECswitch == 1) {
-   	        strcpy(ce->outerFEC_prev, ce->outerFEC);
-   	        strcpy(ce->outerFEC, "none");
-   	        ce->FECswitch = 0;
-   	    }
-   	    // Turn FEC on
-   	    else {
-   	        strcpy(ce->outerFEC, ce->outerFEC_prev);
-   	        ce->FECswitch = 1;
-   	    }
-   	} 
-        // Not use FEC
-        if (strcmp(ce->adaptation, "no_fec") == 0) {
-           if (strcmp(ce->outerFEC, "none") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-           if (strcmp(ce->outerFEC, "Hamming74") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-           if (strcmp(ce->outerFEC, "Hamming128") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-           if (strcmp(ce->outerFEC, "Golay2412") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-           if (strcmp(ce->outerFEC, "SEC-DED2216") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-           if (strcmp(ce->outerFEC, "SEC-DED3932") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-        }
-        // FEC modifying (change to higher)
-        if (strcmp(ce->adaptation, "increase_fec") == 0) {
-           if (strcmp(ce->outerFEC, "SEC-DED3932") == 0) {
-               strcpy(ce->outerFEC, "SEC-DED7264");
-           } 
-           if (strcmp(ce->outerFEC, "SEC-DED2216") == 0) {
-               strcpy(ce->outerFEC, "SEC-DED3932");
-           }
-           if (strcmp(ce->outerFEC, "Golay2412") == 0) {
-               strcpy(ce->outerFEC, "SEC-DED2216");
-           }
-           if (strcmp(ce->outerFEC, "Hamming128") == 0) {
-               strcpy(ce->outerFEC, "Golay2412");
-           }
-           if (strcmp(ce->outerFEC, "Hamming74") == 0) {
-               strcpy(ce->outerFEC, "Hamming128");
-           }
-           if (strcmp(ce->outerFEC, "none") == 0) {
-               strcpy(ce->outerFEC, "Hamming74");
-           }
-        }
-        // FEC modifying (change to lower)
-        if (strcmp(ce->adaptation, "decrease_fec") == 0) {
-           if (strcmp(ce->outerFEC, "Hamming74") == 0) {
-               strcpy(ce->outerFEC, "none");
-           }
-           if (strcmp(ce->outerFEC, "Hamming128") == 0) {
-               strcpy(ce->outerFEC, "Hamming74");
-           }
-           if (strcmp(ce->outerFEC, "Golay2412") == 0) {
-               strcpy(ce->outerFEC, "Hamming128");
-           }
-           if (strcmp(ce->outerFEC, "SEC-DED2216") == 0) {
-               strcpy(ce->outerFEC, "Golay2412");
-           }
-           if (strcmp(ce->outerFEC, "SEC-DED3932") == 0) {
-               strcpy(ce->outerFEC, "SEC-DED2216");
-           }
-           if (strcmp(ce->outerFEC, "SEC-DED7264") == 0) {
-               strcpy(ce->outerFEC, "SEC-DED3932");
-           }
-        }
+    if (verbose) printf("ce->adaptationCondition= %s\n", ceConditionNames[ce->adaptationCondition]);
 
-        if (strcmp(ce->adaptation, "mod_scheme->BPSK") == 0) {
-            strcpy(ce->modScheme, "BPSK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->QPSK") == 0) {
-            strcpy(ce->modScheme, "QPSK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->8PSK") == 0) {
-            strcpy(ce->modScheme, "8PSK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->16PSK") == 0) {
-            strcpy(ce->modScheme, "16PSK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->328PSK") == 0) {
-            strcpy(ce->modScheme, "32PSK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->64PSK") == 0) {
-            strcpy(ce->modScheme, "64PSK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->8QAM") == 0) {
-            strcpy(ce->modScheme, "8QAM");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->16QAM") == 0) {
-            strcpy(ce->modScheme, "16QAM");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->32QAM") == 0) {
-            strcpy(ce->modScheme, "32QAM");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->64QAM") == 0) {
-            strcpy(ce->modScheme, "64QAM");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->OOK") == 0) {
-            strcpy(ce->modScheme, "OOK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->4ASK") == 0) {
-            strcpy(ce->modScheme, "4ASK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->8ASK") == 0) {
-            strcpy(ce->modScheme, "8ASK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->16ASK") == 0) {
-            strcpy(ce->modScheme, "16ASK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->32ASK") == 0) {
-            strcpy(ce->modScheme, "32ASK");
-        }
-        if (strcmp(ce->adaptation, "mod_scheme->64ASK") == 0) {
-            strcpy(ce->modScheme, "64ASK");
+    // Check if parameters should be modified
+    int modify = ceConditionFunctions[ce->adaptationCondition](ce, fbPtr);
+    if (verbose) printf("PER = %f, BER = %f. %s\n", ce->PER, ce->BER, modify ? "Modifying..." : "Not modifying");
+
+    // If so, modify the specified parameter
+    if (modify) 
+    {
+        if(ce->adaptationCondition == CE_CONDITION_USER_SPECIFIED) {
+            if (verbose) printf("Applying user specified adaptations from user ce file: 'userEngine.txt'\n");
+            applyUserEngine(ce, verbose);
         }
+
+        if (verbose) printf("Modifying Tx parameters: %s\n", ceAdaptationNames[ce->adaptation]);
+        ceAdaptationFunctions[ce->adaptation](ce);
     }
     return 1;
 }   // End ceModifyTxParams()
 
-int postTxTasks(struct CognitiveEngine * cePtr, struct feedbackStruct * fb_ptr, int verbose)
+// Let a CE learn from the feedback on a frame it sent with the parameters in sent
+int postTxTasks(struct CognitiveEngine * cePtr, struct feedbackStruct * fb_ptr, const struct txFrameParams * sent, int verbose)
 {
     // FIXME: Find another way to fix this:: FIXED?
     int DoneTransmitting = 0;
 
     // Process data from rx
-    ceProcessData(cePtr, fb_ptr, verbose);
+    ceProcessData(cePtr, fb_ptr, sent, verbose);
     // Modify transmission parameters (in fg and in USRP) accordingly
     if (!ceOptimized(cePtr, verbose)) 
     {
         if (verbose) printf("ceOptimized() returned false\n");
-        ceModifyTxParams(cePtr, fb_ptr, verbose);
+        ceModifyTxParams(cePtr, fb_ptr, sent, verbose);
     }
     else
     {
@@ -1865,15 +5682,37 @@ int postTxTasks(struct CognitiveEngine * cePtr, struct feedbackStruct * fb_ptr,
     return DoneTransmitting;
 } // End postTxTasks()
 
-void updateScenarioSummary(struct scenarioSummaryInfo *sc_sum, struct feedbackStruct *fb, struct CognitiveEngine *ce, int i_CE, int i_Sc){
+void updateScenarioSummary(struct scenarioSummaryInfo *sc_sum, struct feedbackStruct *fb, unsigned int payloadLen, int i_CE, int i_Sc){
 	sc_sum->valid_headers[i_CE][i_Sc] += fb->header_valid;
 	sc_sum->valid_payloads[i_CE][i_Sc] += fb->payload_valid;
 	sc_sum->EVM[i_CE][i_Sc] += fb->evm;
 	sc_sum->RSSI[i_CE][i_Sc] += fb->rssi;
-	sc_sum->total_bits[i_CE][i_Sc] += ce->payloadLen;
+	sc_sum->total_bits[i_CE][i_Sc] += 8*payloadLen;
 	sc_sum->bit_errors[i_CE][i_Sc] += fb->payloadBitErrors;
 }
 
+// Add each receiver's feedback on a frame to its totals.
+// target is the receiver the frame was sent to, or -1 if it was sent to all.
+void updateNodeSummary(struct scenarioSummaryInfo *sc_sum, struct receiverFeedback *rf, unsigned int payloadLen, int target)
+{
+	for (int i=0; i<MAX_RECEIVER_NODES; i++)
+	{
+		if (!rf->connected[i] || (target >= 0 && i != target))
+			continue;
+		struct nodeSummary * node = &sc_sum->nodes[i];
+		node->frames++;
+		node->total_bits += 8*payloadLen;
+		if (!rf->received[i])
+			continue;
+		node->reports++;
+		node->valid_headers += rf->fb[i].header_valid;
+		node->valid_payloads += rf->fb[i].payload_valid;
+		node->bit_errors += rf->fb[i].payloadBitErrors;
+		node->EVM += rf->fb[i].evm;
+		node->RSSI += rf->fb[i].rssi;
+	}
+} // End updateNodeSummary()
+
 void updateCognitiveEngineSummaryInfo(struct cognitiveEngineSummaryInfo *ce_sum, struct scenarioSummaryInfo *sc_sum, struct CognitiveEngine *ce, int i_CE, int i_Sc){
 	// Decrement frameNumber once
 	ce->frameNumber--;
@@ -1889,6 +5728,19 @@ void updateCognitiveEngineSummaryInfo(struct cognitiveEngineSummaryInfo *ce_sum,
 		(float)sc_sum->valid_headers[i_CE][i_Sc]/(float)sc_sum->total_frames[i_CE][i_Sc], (float)sc_sum->valid_payloads[i_CE][i_Sc]/(float)sc_sum->total_frames[i_CE][i_Sc],
 		sc_sum->EVM[i_CE][i_Sc], sc_sum->RSSI[i_CE][i_Sc], (float)sc_sum->bit_errors[i_CE][i_Sc]/(float)sc_sum->total_bits[i_CE][i_Sc], sc_sum->PER[i_CE][i_Sc]);
 
+	// Display the breakdown by receiver
+	for (int i=0; i<MAX_RECEIVER_NODES; i++)
+	{
+		struct nodeSummary * node = &sc_sum->nodes[i];
+		if (node->frames == 0)
+			continue;
+		int reports = node->reports > 0 ? node->reports : 1;
+		printf("Receiver %i: Frames: %i Reported: %2f Valid headers: %2f Valid payloads: %2f Average EVM: %2f Average RSSI: %2f"
+			" Average BER: %2f\n", i, node->frames, (float)node->reports/(float)node->frames,
+			(float)node->valid_headers/(float)node->frames, (float)node->valid_payloads/(float)node->frames,
+			node->EVM/reports, node->RSSI/reports, (float)node->bit_errors/(float)node->total_bits);
+	}
+
 	// Store the sum of scenario metrics for the cognitive engine
 	ce_sum->total_frames[i_CE] += sc_sum->total_frames[i_CE][i_Sc];
 	ce_sum->valid_headers[i_CE] += sc_sum->valid_headers[i_CE][i_Sc];
@@ -1900,6 +5752,840 @@ void updateCognitiveEngineSummaryInfo(struct cognitiveEngineSummaryInfo *ce_sum,
 	ce_sum->PER[i_CE] += sc_sum->PER[i_CE][i_Sc];
 }
 
+// Write the column headings of a CE/scenario section of the data file
+void printDataFileHeader(FILE * dataFile, struct dataFileColumns * columns)
+{
+    if(columns->frame_info) fprintf(dataFile,"%-10s%-7s","Linetype","Frame");
+    if(columns->validity_metrics) fprintf(dataFile,"%-14s%-15s","Valid Header","Valid Payload");
+    if(columns->error_metrics) fprintf(dataFile,"%-13s%-12s%-7s%-7s%-9s%-9s","Byte Errors","Bit Errors","PER","BER","Avg PER","Avg BER");
+    if(columns->signal_quality_metrics) fprintf(dataFile,"%-10s%-11s","EVM (dB)","RSSI (dB)");
+    if(columns->spectral_metrics) fprintf(dataFile,"%-12s%-21s","Throughput", "Spectral Efficiency");
+    if(columns->goal_metrics) fprintf(dataFile,"%-16s","Avg Goal Value");
+    if(columns->learning_metrics) fprintf(dataFile,"%-10s","Regret");
+    if(columns->receiver_metrics) fprintf(dataFile,"%-9s%-6s","Reports","Node");
+    fprintf(dataFile,"\n");
+    if(columns->frame_info) fprintf(dataFile,"----------------");
+    if(columns->validity_metrics) fprintf(dataFile,"-----------------------------");
+    if(columns->error_metrics) fprintf(dataFile,"---------------------------------------------------------");
+    if(columns->signal_quality_metrics) fprintf(dataFile,"---------------------");
+    if(columns->spectral_metrics) fprintf(dataFile,"--------------------------------");
+    if(columns->goal_metrics) fprintf(dataFile,"----------------");
+    if(columns->learning_metrics) fprintf(dataFile,"----------");
+    if(columns->receiver_metrics) fprintf(dataFile,"---------------");
+    fprintf(dataFile,"\n");
+} // End printDataFileHeader()
+
+// Write exactly len bytes to a file. Returns 0 on success and -1 on failure.
+int writeAll(int fd, const void * buf, size_t len)
+{
+    const unsigned char * p = (const unsigned char *) buf;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+} // End writeAll()
+
+uint32_t crtsLogColumns(const struct dataFileColumns * columns)
+{
+    uint32_t mask = 0;
+    if (columns->frame_info) mask |= CRTS_LOG_COL_FRAME_INFO;
+    if (columns->validity_metrics) mask |= CRTS_LOG_COL_VALIDITY;
+    if (columns->error_metrics) mask |= CRTS_LOG_COL_ERRORS;
+    if (columns->signal_quality_metrics) mask |= CRTS_LOG_COL_SIGNAL_QUALITY;
+    if (columns->spectral_metrics) mask |= CRTS_LOG_COL_SPECTRAL;
+    if (columns->goal_metrics) mask |= CRTS_LOG_COL_GOAL;
+    if (columns->learning_metrics) mask |= CRTS_LOG_COL_LEARNING;
+    if (columns->receiver_metrics) mask |= CRTS_LOG_COL_RECEIVERS;
+    return mask;
+} // End crtsLogColumns()
+
+void dataFileColumnsFromLog(struct dataFileColumns * columns, uint32_t mask)
+{
+    columns->frame_info = (mask & CRTS_LOG_COL_FRAME_INFO) != 0;
+    columns->validity_metrics = (mask & CRTS_LOG_COL_VALIDITY) != 0;
+    columns->error_metrics = (mask & CRTS_LOG_COL_ERRORS) != 0;
+    columns->signal_quality_metrics = (mask & CRTS_LOG_COL_SIGNAL_QUALITY) != 0;
+    columns->spectral_metrics = (mask & CRTS_LOG_COL_SPECTRAL) != 0;
+    columns->goal_metrics = (mask & CRTS_LOG_COL_GOAL) != 0;
+    columns->learning_metrics = (mask & CRTS_LOG_COL_LEARNING) != 0;
+    columns->receiver_metrics = (mask & CRTS_LOG_COL_RECEIVERS) != 0;
+    columns->error_histograms = false;
+} // End dataFileColumnsFromLog()
+
+// Move records from the ring of a crtsLog to its file until the log is closed
+void * crtsLogWriterThread(void * _log)
+{
+    struct crtsLog * log = (struct crtsLog *) _log;
+    struct timespec lastWrite, now;
+    clock_gettime(CLOCK_MONOTONIC, &lastWrite);
+    for (;;)
+    {
+        // Read before the ring, so every record added before close is seen
+        int stopping = __atomic_load_n(&log->stop, __ATOMIC_ACQUIRE);
+
+        // Records ready to go, up to the end of the ring
+        unsigned int pos = log->dequeue_pos;
+        unsigned int first = pos & (CRTS_LOG_RING_LEN-1);
+        unsigned int n = 0;
+        while (first+n < CRTS_LOG_RING_LEN && __atomic_load_n(&log->seq[first+n], __ATOMIC_ACQUIRE) == pos+n+1)
+            n++;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int due = stopping || n >= CRTS_LOG_BATCH || first+n == CRTS_LOG_RING_LEN ||
+            timespecDiffNs(&now, &lastWrite) >= CRTS_LOG_MAX_DELAY_MS*1000000LL;
+        if (n > 0 && due)
+        {
+            if (writeAll(log->fd, &log->records[first], n*sizeof(struct crts_log_record)) < 0 && log->write_errno == 0)
+                log->write_errno = errno;
+            // Hand the slots back to the producers, one lap further on
+            for (unsigned int i=0; i<n; i++)
+                __atomic_store_n(&log->seq[first+i], pos+i+CRTS_LOG_RING_LEN, __ATOMIC_RELEASE);
+            __atomic_store_n(&log->dequeue_pos, pos+n, __ATOMIC_RELAXED);
+            lastWrite = now;
+            continue;
+        }
+        if (stopping)
+            break;
+
+        // Sleep until the records there are now are due, or for a whole
+        // delay when there are none. Announcing the sleep before looking
+        // at the ring again means a producer either sees it and wakes the
+        // writer, or its record is seen here.
+        struct timespec deadline = n > 0 ? lastWrite : now;
+        timespecAddNs(&deadline, CRTS_LOG_MAX_DELAY_MS*1000000LL);
+        pthread_mutex_lock(&log->mutex);
+        __atomic_store_n(&log->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (!__atomic_load_n(&log->stop, __ATOMIC_SEQ_CST) &&
+               first+n < CRTS_LOG_RING_LEN && n < CRTS_LOG_BATCH &&
+               __atomic_load_n(&log->seq[first+n], __ATOMIC_SEQ_CST) != pos+n+1)
+        {
+            if (pthread_cond_timedwait(&log->cond, &log->mutex, &deadline) == ETIMEDOUT)
+                break;
+        }
+        __atomic_store_n(&log->sleeping, 0, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&log->mutex);
+    }
+    return NULL;
+} // End crtsLogWriterThread()
+
+// Wake the log writer if it sleeps
+void crtsLogWake(struct crtsLog * log)
+{
+    pthread_mutex_lock(&log->mutex);
+    pthread_cond_signal(&log->cond);
+    pthread_mutex_unlock(&log->mutex);
+} // End crtsLogWake()
+
+// Create a binary log, or write it to stdout if filename is NULL
+struct crtsLog * openCrtsLog(const char * filename, const struct dataFileColumns * columns)
+{
+    struct crtsLog * log = (struct crtsLog *) calloc(1, sizeof(struct crtsLog));
+    log->fd = filename != NULL ? open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644) : STDOUT_FILENO;
+    if (log->fd < 0)
+    {
+        fprintf(stderr, "ERROR: Could not create %s: %s\n", filename, strerror(errno));
+        exit(EX_CANTCREAT);
+    }
+
+    struct crts_log_file_header h = {};
+    h.magic = CRTS_LOG_MAGIC;
+    h.version = CRTS_LOG_VERSION;
+    h.record_size = sizeof(struct crts_log_record);
+    h.columns = crtsLogColumns(columns);
+    if (writeAll(log->fd, &h, sizeof(h)) < 0)
+    {
+        fprintf(stderr, "ERROR: Could not write the binary log: %s\n", strerror(errno));
+        exit(EX_IOERR);
+    }
+
+    log->seq = (unsigned int *) malloc(CRTS_LOG_RING_LEN*sizeof(unsigned int));
+    log->records = (struct crts_log_record *) malloc(CRTS_LOG_RING_LEN*sizeof(struct crts_log_record));
+    for (unsigned int i=0; i<CRTS_LOG_RING_LEN; i++)
+        log->seq[i] = i;
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&log->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&log->mutex, NULL);
+    pthread_create(&log->thread, NULL, crtsLogWriterThread, (void *) log);
+    return log;
+} // End openCrtsLog()
+
+// Add a record to a log. Safe to call from any thread. Waits for the
+// writer when the ring is full rather than lose the record.
+void crtsLogPut(struct crtsLog * log, const struct crts_log_record * r)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    unsigned int pos = __atomic_load_n(&log->enqueue_pos, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        unsigned int i = pos & (CRTS_LOG_RING_LEN-1);
+        int diff = (int) (__atomic_load_n(&log->seq[i], __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0)
+        {
+            // A failed exchange loads the current position into pos
+            if (__atomic_compare_exchange_n(&log->enqueue_pos, &pos, pos+1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                log->records[i] = *r;
+                log->records[i].timestamp_ns = (uint64_t) now.tv_sec*1000000000ULL + (uint64_t) now.tv_nsec;
+                __atomic_store_n(&log->seq[i], pos+1, __ATOMIC_SEQ_CST);
+                if (__atomic_load_n(&log->sleeping, __ATOMIC_SEQ_CST) &&
+                    pos+1 - __atomic_load_n(&log->dequeue_pos, __ATOMIC_RELAXED) >= CRTS_LOG_BATCH)
+                    crtsLogWake(log);
+                return;
+            }
+        }
+        else
+        {
+            if (diff < 0)
+            {
+                __atomic_add_fetch(&log->stalls, 1, __ATOMIC_RELAXED);
+                if (__atomic_load_n(&log->sleeping, __ATOMIC_SEQ_CST))
+                    crtsLogWake(log);
+                sched_yield();
+            }
+            pos = __atomic_load_n(&log->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+} // End crtsLogPut()
+
+// Write out every record added so far and close the log
+void closeCrtsLog(struct crtsLog * log, int verbose)
+{
+    __atomic_store_n(&log->stop, 1, __ATOMIC_SEQ_CST);
+    crtsLogWake(log);
+    pthread_join(log->thread, NULL);
+    pthread_cond_destroy(&log->cond);
+    pthread_mutex_destroy(&log->mutex);
+    if (log->write_errno != 0)
+        fprintf(stderr, "ERROR: Could not write the binary log: %s\n", strerror(log->write_errno));
+    if (verbose && log->stalls > 0)
+        printf("Frames waited %u time(s) for the binary log writer\n", log->stalls);
+    if (log->fd != STDOUT_FILENO)
+        close(log->fd);
+    free(log->seq);
+    free(log->records);
+    free(log);
+} // End closeCrtsLog()
+
+// Write the data file line of one frame
+void printFrameRecord(FILE * dataFile, struct dataFileColumns * columns, const struct crts_log_frame * f)
+{
+    if(columns->frame_info) fprintf(dataFile,"%-10s%-7i","crtsdata",(int)f->iteration);
+    if(columns->validity_metrics) fprintf(dataFile,"%-14i%-15i",f->header_valid,f->payload_valid);
+    if(columns->error_metrics) fprintf(dataFile,"%-13i%-12i%-7.2f%-7.2f%-9.2f%-9.2f",(int)f->byte_errors,(int)f->bit_errors,f->PER,f->BER,f->PER_avg,f->BER_avg);
+    if(columns->signal_quality_metrics) fprintf(dataFile,"%-10.2f%-11.2f",f->evm,f->rssi);
+    if(columns->spectral_metrics) fprintf(dataFile,"%-12.2f%-21.2f",f->throughput,f->spectral_efficiency);
+    if(columns->goal_metrics) fprintf(dataFile,"%-16.2f",f->goal);
+    if(columns->learning_metrics) fprintf(dataFile,"%-10.2f",f->regret);
+    if(columns->receiver_metrics) fprintf(dataFile,"%-9i%-6i",f->reports,f->node);
+    fprintf(dataFile,"\n");
+} // End printFrameRecord()
+
+// Record the data of one frame.
+// node is the receiver the frame was sent to, or -1 if it was sent to all.
+void printFrameData(struct dataCell * out, struct CognitiveEngine * ce, struct feedbackStruct * fb,
+    const struct txFrameParams * sent, float throughput, int reports, int node)
+{
+    const struct mcsEntry * mcs = &mcsTable[sent->mcsIndex];
+    struct crts_log_record r = {};
+    r.type = CRTS_LOG_FRAME;
+    r.i_CE = out->i_CE;
+    r.i_Sc = out->i_Sc;
+    r.repetition = out->repetition;
+
+    struct crts_log_frame * f = &r.u.frame;
+    f->iteration = ce->iteration;
+    f->frame_number = fb->iteration;
+    f->ce_time = ce->runningTime;
+    f->header_valid = fb->header_valid;
+    f->payload_valid = fb->payload_valid;
+    f->mcs = sent->mcsIndex;
+    f->mod_scheme = modSchemeNames[mcs->mod].scheme;
+    f->inner_fec = fecSchemeNames[mcs->fec0].scheme;
+    f->outer_fec = fecSchemeNames[mcs->fec1].scheme;
+    f->node = node;
+    f->reports = reports;
+    f->payload_len = fb->payload_len;
+    f->byte_errors = fb->payloadByteErrors;
+    f->bit_errors = fb->payloadBitErrors;
+    f->PER = ce->PER;
+    f->BER = ce->BER;
+    f->PER_avg = ce->PER_avg;
+    f->BER_avg = ce->BER_avg;
+    f->evm = fb->evm;
+    f->rssi = fb->rssi;
+    f->cfo = fb->cfo;
+    f->throughput = throughput;
+    f->spectral_efficiency = throughput/ce->bandwidth;
+    f->goal = ce->averagedGoalValue;
+    f->regret = ce->regret;
+
+    if (out->log != NULL)
+        crtsLogPut(out->log, &r);
+    else
+        printFrameRecord(out->file, out->columns, f);
+} // End printFrameData()
+
+// Write the heading of a CE/scenario section of the data file
+void printCellHeading(FILE * dataFile, struct dataFileColumns * columns, int i_CE, int i_Sc, int repetition,
+    int num_repetitions)
+{
+    fprintf(dataFile, "Cognitive Engine %d\nScenario %d\n", i_CE+1, i_Sc+1);
+    if (num_repetitions > 1)
+        fprintf(dataFile, "Repetition %d\n", repetition+1);
+    printDataFileHeader(dataFile, columns);
+} // End printCellHeading()
+
+// Write the end of a CE/scenario section of the data file
+void printCellEnd(FILE * dataFile, const struct crts_log_cell * c)
+{
+    if (c->paced_frames > 0)
+    {
+        struct framePacer p = {};
+        p.interval_ns = c->pacing_interval_ns;
+        p.frames = c->paced_frames;
+        p.overruns = c->pacing_overruns;
+        p.sum_ns = c->pacing_sum_ns;
+        p.sumsq_ns = c->pacing_sumsq_ns;
+        p.max_ns = c->pacing_max_ns;
+        pacerReport(&p, dataFile);
+    }
+    struct crtsClock clock = {};
+    clock.type = c->clock == CRTS_LOG_CLOCK_VIRTUAL ? CRTS_CLOCK_VIRTUAL : CRTS_CLOCK_WALL;
+    fprintf(dataFile, "Clock: %s Time: %f", crtsClockName(&clock), c->time);
+    fprintf(dataFile, "\n\n");
+} // End printCellEnd()
+
+void beginDataCell(struct dataCell * out)
+{
+    if (out->log == NULL)
+    {
+        printCellHeading(out->file, out->columns, out->i_CE, out->i_Sc, out->repetition, out->num_repetitions);
+        return;
+    }
+    struct crts_log_record r = {};
+    r.type = CRTS_LOG_CELL_BEGIN;
+    r.i_CE = out->i_CE;
+    r.i_Sc = out->i_Sc;
+    r.repetition = out->repetition;
+    r.u.cell.num_repetitions = out->num_repetitions;
+    crtsLogPut(out->log, &r);
+} // End beginDataCell()
+
+// End a cell that took the time of testClock. pacer is NULL if frames were not paced.
+void endDataCell(struct dataCell * out, const struct crtsClock * testClock, const struct framePacer * pacer)
+{
+    struct crts_log_record r = {};
+    r.type = CRTS_LOG_CELL_END;
+    r.i_CE = out->i_CE;
+    r.i_Sc = out->i_Sc;
+    r.repetition = out->repetition;
+    struct crts_log_cell * c = &r.u.cell;
+    c->num_repetitions = out->num_repetitions;
+    c->clock = testClock->type == CRTS_CLOCK_VIRTUAL ? CRTS_LOG_CLOCK_VIRTUAL : CRTS_LOG_CLOCK_WALL;
+    c->time = crtsClockNow(testClock);
+    if (pacer != NULL)
+    {
+        c->paced_frames = pacer->frames;
+        c->pacing_overruns = pacer->overruns;
+        c->pacing_interval_ns = pacer->interval_ns;
+        c->pacing_max_ns = pacer->max_ns;
+        c->pacing_sum_ns = pacer->sum_ns;
+        c->pacing_sumsq_ns = pacer->sumsq_ns;
+    }
+
+    if (out->log != NULL)
+        crtsLogPut(out->log, &r);
+    else
+    {
+        printCellEnd(out->file, c);
+        fflush(out->file);
+    }
+} // End endDataCell()
+
+bool crtsLogCellBefore(const struct crts_log_record & a, const struct crts_log_record & b)
+{
+    if (a.i_CE != b.i_CE)
+        return a.i_CE < b.i_CE;
+    if (a.i_Sc != b.i_Sc)
+        return a.i_Sc < b.i_Sc;
+    return a.repetition < b.repetition;
+} // End crtsLogCellBefore()
+
+// Print a binary log as the text table a run without -l writes
+int convertCrtsLog(const char * filename, FILE * out)
+{
+    FILE * in = fopen(filename, "rb");
+    if (in == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not open %s: %s\n", filename, strerror(errno));
+        return EX_NOINPUT;
+    }
+    struct crts_log_file_header h;
+    if (fread(&h, sizeof(h), 1, in) != 1 || h.magic != CRTS_LOG_MAGIC || h.version != CRTS_LOG_VERSION ||
+        h.record_size != sizeof(struct crts_log_record))
+    {
+        fprintf(stderr, "ERROR: %s is not a binary log of this version of crts\n", filename);
+        fclose(in);
+        return EX_DATAERR;
+    }
+
+    size_t n = 0, capacity = 4096;
+    struct crts_log_record * records = (struct crts_log_record *) malloc(capacity*sizeof(struct crts_log_record));
+    size_t got;
+    while ((got = fread(records+n, sizeof(struct crts_log_record), capacity-n, in)) > 0)
+    {
+        n += got;
+        if (n == capacity)
+        {
+            capacity *= 2;
+            records = (struct crts_log_record *) realloc(records, capacity*sizeof(struct crts_log_record));
+        }
+    }
+    fclose(in);
+
+    // Cells of a parallel run may be interleaved. Their own records are in order.
+    std::stable_sort(records, records+n, crtsLogCellBefore);
+
+    struct dataFileColumns columns;
+    dataFileColumnsFromLog(&columns, h.columns);
+    for (size_t i=0; i<n; i++)
+    {
+        struct crts_log_record * r = &records[i];
+        switch (r->type)
+        {
+        case CRTS_LOG_CELL_BEGIN:
+            printCellHeading(out, &columns, r->i_CE, r->i_Sc, r->repetition, r->u.cell.num_repetitions);
+            break;
+        case CRTS_LOG_FRAME:
+            printFrameRecord(out, &columns, &r->u.frame);
+            break;
+        case CRTS_LOG_CELL_END:
+            printCellEnd(out, &r->u.cell);
+            break;
+        }
+    }
+    free(records);
+    return EX_OK;
+} // End convertCrtsLog()
+
+// Write the error positions of a scenario to the data file
+void printErrorHistogram(FILE * dataFile, struct errorHistogram * hist)
+{
+    fprintf(dataFile, "Bit errors by payload byte (%u frames)\n", hist->num_frames);
+    fprintf(dataFile, "%-10s%-12s\n", "Byte", "Bit Errors");
+    for (unsigned int m=0; m<hist->num_bytes; m++)
+        fprintf(dataFile, "%-10u%-12u\n", m, hist->byte_errors[m]);
+} // End printErrorHistogram()
+
+// Add the metrics of one run of a cell to the scenario summary
+void addCellSummary(struct scenarioSummaryInfo *sc_sum, struct cellSummary *cell, int i_CE, int i_Sc){
+	sc_sum->valid_headers[i_CE][i_Sc] += cell->valid_headers;
+	sc_sum->valid_payloads[i_CE][i_Sc] += cell->valid_payloads;
+	sc_sum->EVM[i_CE][i_Sc] += cell->EVM;
+	sc_sum->RSSI[i_CE][i_Sc] += cell->RSSI;
+	sc_sum->total_bits[i_CE][i_Sc] += cell->total_bits;
+	sc_sum->bit_errors[i_CE][i_Sc] += cell->bit_errors;
+} // End addCellSummary()
+
+// Average the CE's metrics over its scenarios and print them
+void printCognitiveEngineSummary(struct cognitiveEngineSummaryInfo *ce_sum, int i_CE, int NumSc){
+	// Divide the sum of each metric by the number of scenarios run to get the final metric
+	ce_sum->EVM[i_CE] /= NumSc;
+	ce_sum->RSSI[i_CE] /= NumSc;
+	ce_sum->PER[i_CE] /= NumSc;
+
+	// Print cognitive engine summaries
+	printf("Cognitive Engine %i Summary:\nTotal frames: %i\nPercent valid headers: %2f\nPercent valid payloads: %2f\nAverage EVM: %2f\n"
+		"Average RSSI: %2f\nAverage BER: %2f\nAverage PER: %2f\n\n", i_CE+1, ce_sum->total_frames[i_CE], (float)ce_sum->valid_headers[i_CE]/(float)ce_sum->total_frames[i_CE],
+		(float)ce_sum->valid_payloads[i_CE]/(float)ce_sum->total_frames[i_CE], ce_sum->EVM[i_CE], ce_sum->RSSI[i_CE], (float)ce_sum->bit_errors[i_CE]/(float)ce_sum->total_bits[i_CE], ce_sum->PER[i_CE]);
+} // End printCognitiveEngineSummary()
+
+// Copy a CE read from its config file, with empty metric windows of its own
+void copyCognitiveEngine(struct CognitiveEngine * dst, struct CognitiveEngine * src)
+{
+    *dst = *src;
+    dst->goal_stats.init(src->goal_averaging, src->goal_stats.lo, src->goal_stats.hi,
+        src->goal_stats.alpha);
+    dst->BER_stats.init(src->BER_averaging, src->BER_stats.lo, src->BER_stats.hi,
+        src->BER_stats.alpha);
+    dst->PER_stats.init(src->PER_averaging, src->PER_stats.lo, src->PER_stats.hi,
+        src->PER_stats.alpha);
+    dst->validPayloads_stats.init(src->validPayloads_averaging, src->validPayloads_stats.lo, src->validPayloads_stats.hi,
+        src->validPayloads_stats.alpha);
+    dst->errorFreePayloads_stats.init(src->errorFreePayloads_averaging, src->errorFreePayloads_stats.lo, src->errorFreePayloads_stats.hi,
+        src->errorFreePayloads_stats.alpha);
+    if (src->plugin_ptr)
+    {
+        dst->plugin_ptr = loadCEPlugin(src->pluginPath, src->pluginArgs);
+        if (dst->plugin_ptr == NULL)
+            exit(EX_UNAVAILABLE);
+    }
+    dst->learning_ptr = createLearningEngine(dst);
+} // End copyCognitiveEngine()
+
+void freeCognitiveEngine(struct CognitiveEngine * ce)
+{
+    ce->goal_stats.release();
+    ce->BER_stats.release();
+    ce->PER_stats.release();
+    ce->validPayloads_stats.release();
+    ce->errorFreePayloads_stats.release();
+    unloadCEPlugin(ce->plugin_ptr);
+    ce->plugin_ptr = NULL;
+    destroyLearningEngine(ce->learning_ptr);
+    ce->learning_ptr = NULL;
+    if (ce->adaptationCondition == CE_CONDITION_USER_SPECIFIED)
+        releaseUserEngine();
+} // End freeCognitiveEngine()
+
+struct simulationState * CreateSimulationState(int verbose, int isController)
+{
+    struct simulationState * sim = (struct simulationState *) calloc(1, sizeof(struct simulationState));
+    sim->fgPool = CreateFrameGeneratorPool();
+    sim->fsBank = CreateFrameSynchronizerBank();
+    sim->fs = NULL;
+
+    pthread_mutex_init(&sim->fb.fb_mutex, NULL);
+    pthread_cond_init(&sim->fb.fb_cond, NULL);
+
+    sim->rxCBs = CreaterxCBStruct();
+    sim->rxCBs.verbose = verbose;
+    sim->rxCBs.isController = isController;
+    sim->rxCBs.usingUSRPs = 0;
+    sim->rxCBs.fb_ptr = &sim->fb;
+#ifdef CRTS_PROFILE
+    sim->rxCBs.profile_ptr = &sim->profile;
+#endif
+    return sim;
+} // End CreateSimulationState()
+
+void destroySimulationState(struct simulationState * sim)
+{
+    destroyFrameGeneratorPool(&sim->fgPool);
+    destroyFrameSynchronizerBank(&sim->fsBank);
+    free(sim->hist);
+    free(sim);
+} // End destroySimulationState()
+
+// Simulate frames of one CE/scenario cell in software until the CE reaches its goal.
+// The data of every frame goes to out and the frame metrics are summed into cell.
+// The frames' samples advance the virtual clock testClock.
+void simulateScenario(struct simulationState * sim, struct CognitiveEngine * ce, struct Scenario * sc,
+    struct cellSummary * cell, struct crtsClock * testClock, struct dataCell * out, int verbose)
+{
+    struct feedbackStruct * fb = &sim->fb;
+    unsigned char * header = sim->header;
+    unsigned char * payload = sim->payload;
+    int DoneTransmitting = 0;
+    int isLastSymbol;
+    unsigned int symbolLen;
+
+    sim->rxCBs.ce_ptr = ce;
+    sim->rxCBs.sc_ptr = sc;
+    sim->rxCBs.hist_ptr = NULL;
+    if (out->columns->error_histograms)
+    {
+        if (sim->hist == NULL)
+            sim->hist = (struct errorHistogram *) malloc(sizeof(struct errorHistogram));
+        memset(sim->hist, 0, sizeof(struct errorHistogram));
+        sim->rxCBs.hist_ptr = sim->hist;
+    }
+
+    // Initialize Receiver Defaults for current CE and Sc
+    sim->fs = getFrameSynchronizer(&sim->fsBank, ce, &sim->rxCBs);
+    ofdmflexframesync_reset(sim->fs);
+
+    while(!DoneTransmitting)
+    {
+        // Get a frame generator configured for the current CE parameters
+        ofdmflexframegen fg = getFrameGenerator(&sim->fgPool, ce, verbose);
+        if (verbose) ofdmflexframegen_print(fg);
+
+        // Switch synchronizers if the CE changed the OFDM geometry
+        ofdmflexframesync next_fs = getFrameSynchronizer(&sim->fsBank, ce, &sim->rxCBs);
+        if (next_fs != sim->fs)
+        {
+            ofdmflexframesync_reset(next_fs);
+            sim->fs = next_fs;
+        }
+
+        // Iterator
+        int i = 0;
+
+        // Generate data
+        PROFILE_START(profile_t);
+        if (verbose) printf("\n\nGenerating data that will go in frame...\n");
+        header[0] = out->i_CE+1;
+        header[1] = out->i_Sc+1;
+        for (i=0; i<4; i++)
+            header[i+2] = (ce->frameNumber & (0xFF<<(8*(3-i))))>>(8*(3-i));
+        header[6] = 0;
+        header[7] = 0;
+        memcpy(payload, pnFrameSequence(ce->frameNumber), ce->payloadLen);
+        PROFILE_LAP(&sim->profile, PROFILE_PAYLOAD, profile_t);
+
+        // Assemble frame
+        ofdmflexframegen_assemble(fg, header, payload, ce->payloadLen);
+        ce->frameLen = ofdmflexframegen_getframelen(fg);
+        PROFILE_LAP(&sim->profile, PROFILE_ASSEMBLE, profile_t);
+
+        // i.e. Need to transmit each symbol in frame.
+        isLastSymbol = 0;
+
+        while (!isLastSymbol)
+        {
+            isLastSymbol = ofdmflexframegen_writesymbol(fg, sim->frameSamples);
+            PROFILE_LAP(&sim->profile, PROFILE_WRITE_SYMBOL, profile_t);
+            symbolLen = ce->numSubcarriers + ce->CPLen;
+            enactScenarioBasebandTx(sim->frameSamples, symbolLen, ce, sc);
+            PROFILE_LAP(&sim->profile, PROFILE_CHANNEL, profile_t);
+
+            // Rx Receives packet
+            ofdmflexframesync_execute(sim->fs, sim->frameSamples, symbolLen);
+            PROFILE_LAP(&sim->profile, PROFILE_SYNC, profile_t);
+            crtsClockAdvance(testClock, symbolLen);
+        } // End Transmition For loop
+
+        // Throughput and spectral efficiency of the frame, before the CE adapts
+        struct txFrameParams sent = txFrameParamsOf(ce);
+        float throughput = ceThroughput(ce, sent.frameLen);
+
+        DoneTransmitting = postTxTasks(ce, fb, &sent, verbose);
+        PROFILE_LAP(&sim->profile, PROFILE_POST_TX, profile_t);
+
+        printFrameData(out, ce, fb, &sent, throughput, 1, -1);
+
+        // Increment the frame counters and iteration counter
+        ce->frameNumber++;
+        ce->iteration++;
+        // Update the clock
+        ce->runningTime = crtsClockNow(testClock);
+
+        cell->valid_headers += fb->header_valid;
+        cell->valid_payloads += fb->payload_valid;
+        cell->EVM += fb->evm;
+        cell->RSSI += fb->rssi;
+        cell->total_bits += 8*sent.payloadLen;
+        cell->bit_errors += fb->payloadBitErrors;
+    } // End While loop
+
+    if (out->columns->error_histograms)
+        printErrorHistogram(out->file, sim->hist);
+} // End simulateScenario()
+
+// Take the next task of a worker, or steal the oldest task of another one.
+// Returns -1 once every queue is empty.
+int takeSimulationTask(struct simulationPool * pool, int id)
+{
+    struct taskQueue * q = &pool->queues[id];
+    int task = -1;
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->tail > q->head)
+        task = q->tasks[--q->tail];
+    pthread_mutex_unlock(&q->mutex);
+
+    for (int i=1; i<pool->num_workers && task < 0; i++)
+    {
+        struct taskQueue * victim = &pool->queues[(id+i)%pool->num_workers];
+        pthread_mutex_lock(&victim->mutex);
+        if (victim->tail > victim->head)
+            task = victim->tasks[victim->head++];
+        pthread_mutex_unlock(&victim->mutex);
+    }
+    return task;
+} // End takeSimulationTask()
+
+// Run one repetition of a cell from fresh copies of its CE and scenario
+void runSimulationTask(struct simulationPool * pool, struct simulationState * sim, struct simulationTask * task)
+{
+    crtsSeedThreadRand(task->seed);
+
+    struct CognitiveEngine ce;
+    copyCognitiveEngine(&ce, &pool->ce_list[task->i_CE]);
+    struct Scenario sc = pool->sc_list[task->i_Sc];
+    initScenarioChannels(&sc);
+
+    // Text is kept in memory until the run is merged. Binary records
+    // carry their cell and go to the log at once.
+    struct dataCell out = {NULL, pool->log, &pool->columns, task->i_CE, task->i_Sc, task->repetition,
+        pool->num_repetitions};
+    if (out.log == NULL)
+        out.file = open_memstream(&task->data, &task->data_len);
+    beginDataCell(&out);
+
+    ce.frameNumber = 1;
+    struct crtsClock testClock;
+    crtsClockStartVirtual(&testClock, ce.bandwidth);
+#ifdef CRTS_PROFILE
+    stageProfileReset(&sim->profile);
+#endif
+    simulateScenario(sim, &ce, &sc, &task->cell, &testClock, &out, 0);
+
+    endDataCell(&out, &testClock, NULL);
+    if (out.file != NULL)
+        fclose(out.file);
+#ifdef CRTS_PROFILE
+    task->profile = (struct stageProfile *) malloc(sizeof(struct stageProfile));
+    *task->profile = sim->profile;
+#endif
+
+    task->cell.total_frames = ce.frameNumber-1;
+    task->cell.PER = ce.PER;
+
+    destroyScenarioChannels(&sc);
+    freeCognitiveEngine(&ce);
+} // End runSimulationTask()
+
+void * simulationWorkerThread(void * _worker)
+{
+    struct simulationWorker * worker = (struct simulationWorker *) _worker;
+    struct simulationPool * pool = worker->pool;
+    // Software simulation acts as its own controller
+    struct simulationState * sim = CreateSimulationState(0, 1);
+
+    int task;
+    while ((task = takeSimulationTask(pool, worker->id)) >= 0)
+        runSimulationTask(pool, sim, &pool->tasks[task]);
+
+    destroySimulationState(sim);
+    return NULL;
+} // End simulationWorkerThread()
+
+// Run every CE/scenario cell num_repetitions times on num_workers threads.
+// The results are merged afterwards in CE, scenario, repetition order, so
+// the data file and summaries do not depend on the scheduling. Binary
+// records go to dataLog as the cells run and are put in order by crts -L.
+void runParallelSimulation(int num_workers, int num_repetitions,
+    char cogengine_list[][60], int NumCE, char scenario_list[][60], int NumSc,
+    struct dataFileColumns * columns, FILE * dataFile, struct crtsLog * dataLog, struct scenarioSummaryInfo * sc_sum,
+    struct cognitiveEngineSummaryInfo * ce_sum, float frequency_tx, float frequency_rx, int verbose)
+{
+    struct simulationPool pool;
+    pool.num_workers = num_workers;
+    pool.num_repetitions = num_repetitions;
+    pool.columns = *columns;
+    pool.log = dataLog;
+
+    // Read every config file once up front
+    pool.ce_list = (struct CognitiveEngine *) calloc(NumCE, sizeof(struct CognitiveEngine));
+    pool.sc_list = (struct Scenario *) calloc(NumSc, sizeof(struct Scenario));
+    for (int i_CE=0; i_CE<NumCE; i_CE++)
+    {
+        pool.ce_list[i_CE] = CreateCognitiveEngine();
+        readCEConfigFile(&pool.ce_list[i_CE], cogengine_list[i_CE], verbose);
+        pool.ce_list[i_CE].frequency_tx = frequency_tx;
+        pool.ce_list[i_CE].frequency_rx = frequency_rx;
+    }
+    for (int i_Sc=0; i_Sc<NumSc; i_Sc++)
+    {
+        pool.sc_list[i_Sc] = CreateScenario();
+        readScConfigFile(&pool.sc_list[i_Sc], scenario_list[i_Sc], verbose);
+        // Tasks build their own channel state from the parsed options
+        destroyScenarioChannels(&pool.sc_list[i_Sc]);
+    }
+
+    // One task per repetition of each cell, dealt round robin to the workers
+    int num_tasks = NumCE*NumSc*num_repetitions;
+    uint64_t seed = ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+    pool.tasks = (struct simulationTask *) calloc(num_tasks, sizeof(struct simulationTask));
+    pool.queues = (struct taskQueue *) calloc(num_workers, sizeof(struct taskQueue));
+    for (int w=0; w<num_workers; w++)
+    {
+        pthread_mutex_init(&pool.queues[w].mutex, NULL);
+        pool.queues[w].tasks = (int *) calloc(num_tasks/num_workers + 1, sizeof(int));
+    }
+    for (int t=0; t<num_tasks; t++)
+    {
+        pool.tasks[t].i_CE = t/(NumSc*num_repetitions);
+        pool.tasks[t].i_Sc = (t/num_repetitions)%NumSc;
+        pool.tasks[t].repetition = t%num_repetitions;
+        pool.tasks[t].seed = (unsigned int)splitmix64(&seed);
+        struct taskQueue * q = &pool.queues[t%num_workers];
+        q->tasks[q->tail++] = t;
+    }
+
+    if (verbose) printf("Running %d simulations on %d threads\n", num_tasks, num_workers);
+    pthread_t * threads = (pthread_t *) calloc(num_workers, sizeof(pthread_t));
+    struct simulationWorker * workers = (struct simulationWorker *) calloc(num_workers, sizeof(struct simulationWorker));
+    for (int w=0; w<num_workers; w++)
+    {
+        workers[w].pool = &pool;
+        workers[w].id = w;
+        pthread_create(&threads[w], NULL, simulationWorkerThread, (void*) &workers[w]);
+    }
+    for (int w=0; w<num_workers; w++)
+        pthread_join(threads[w], NULL);
+
+    // Merge the results in order
+#ifdef CRTS_PROFILE
+    struct stageProfile * cellProfile = (struct stageProfile *) malloc(sizeof(struct stageProfile));
+#endif
+    for (int i_CE=0; i_CE<NumCE; i_CE++)
+    {
+        for (int i_Sc=0; i_Sc<NumSc; i_Sc++)
+        {
+            // Stands in for the CE at the end of the cell in updateCognitiveEngineSummaryInfo()
+            struct CognitiveEngine ce = {};
+            ce.frameNumber = 1;
+            ce.PER = 0.0f;
+#ifdef CRTS_PROFILE
+            stageProfileReset(cellProfile);
+#endif
+            for (int r=0; r<num_repetitions; r++)
+            {
+                struct simulationTask * task = &pool.tasks[(i_CE*NumSc+i_Sc)*num_repetitions+r];
+                if (task->data != NULL)
+                    fwrite(task->data, 1, task->data_len, dataFile);
+                free(task->data);
+                addCellSummary(sc_sum, &task->cell, i_CE, i_Sc);
+                ce.frameNumber += task->cell.total_frames;
+                ce.PER += task->cell.PER/num_repetitions;
+#ifdef CRTS_PROFILE
+                stageProfileMerge(cellProfile, task->profile);
+                free(task->profile);
+#endif
+            }
+            if (dataFile != NULL)
+                fflush(dataFile);
+            updateCognitiveEngineSummaryInfo(ce_sum, sc_sum, &ce, i_CE, i_Sc);
+#ifdef CRTS_PROFILE
+            stageProfilePrint(stdout, cellProfile, i_CE, i_Sc);
+#endif
+        }
+        printCognitiveEngineSummary(ce_sum, i_CE, NumSc);
+    }
+
+    for (int w=0; w<num_workers; w++)
+    {
+        pthread_mutex_destroy(&pool.queues[w].mutex);
+        free(pool.queues[w].tasks);
+    }
+    for (int i_CE=0; i_CE<NumCE; i_CE++)
+        freeCognitiveEngine(&pool.ce_list[i_CE]);
+#ifdef CRTS_PROFILE
+    free(cellProfile);
+#endif
+    free(pool.queues);
+    free(pool.tasks);
+    free(pool.ce_list);
+    free(pool.sc_list);
+    free(threads);
+    free(workers);
+} // End runParallelSimulation()
+
 void uhd_quiet(uhd::msg::type_t type, const std::string &msg){}
 
 void terminate(int sig){
@@ -1922,6 +6608,17 @@ int main(int argc, char ** argv)
     // Specifies whether this crts instance is managing the experiment.
     int isController = 0;
 
+    // Parallel simulation: worker threads (0: run serially) and repetitions of each cell
+    int numJobs = 0;
+    int numRepetitions = 1;
+
+    // Write bit error histograms to the data file (simulation mode)
+    int errorHistograms = 0;
+
+    // Write binary records instead of text, and a binary log to print as text
+    int binaryLog = 0;
+    char * logToConvert = NULL;
+
     unsigned int serverPort = 1402;
     char * serverAddr = (char*) "127.0.0.1";
 
@@ -1936,7 +6633,7 @@ int main(int argc, char ** argv)
 
     // Check Program options
     int d;
-    while ((d = getopt(argc,argv,"uhqvdrsp:ca:f:b:G:M:C:T:")) != EOF) {
+    while ((d = getopt(argc,argv,"uhqvdrsp:ca:f:b:G:M:C:T:j:n:elL:")) != EOF) {
         switch (d) {
         case 'u':
         case 'h':   usage();                           		return 0;
@@ -1956,6 +6653,11 @@ int main(int argc, char ** argv)
         case 'M':   numSubcarriers = atoi(optarg);          break;
         case 'C':   CPLen = atoi(optarg);                   break;
         case 'T':   taperLen = atoi(optarg);                break;
+        case 'j':   numJobs = atoi(optarg);                 break;
+        case 'n':   numRepetitions = atoi(optarg);          break;
+        case 'e':   errorHistograms = 1;                    break;
+        case 'l':   binaryLog = 1;                          break;
+        case 'L':   logToConvert = optarg;                  break;
         //case 'p':   serverPort = atol(optarg);            break;
         //case 'f':   frequency = atof(optarg);           break;
         //case 'b':   bandwidth = atof(optarg);           break;
@@ -1966,6 +6668,27 @@ int main(int argc, char ** argv)
         }   
     }
 
+    if (logToConvert != NULL)
+        return convertCrtsLog(logToConvert, stdout);
+    if (binaryLog && errorHistograms)
+    {
+        fprintf(stderr, "WARNING: Bit error histograms are not written to binary logs\n");
+        errorHistograms = 0;
+    }
+
+    if (numRepetitions < 1 || numJobs < 0)
+    {
+        fprintf(stderr, "ERROR: -j and -n must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if (numRepetitions > 1 && numJobs == 0)
+        numJobs = 1;
+    if (numJobs > 0 && (usingUSRPs || !isController))
+    {
+        fprintf(stderr, "ERROR: -j and -n are only supported in simulation mode (-c)\n");
+        exit(EXIT_FAILURE);
+    }
+
 	// Default transmit and receive frequencies (reversed for controller/slaves)
 	if(isController){
 	    frequency_tx = 460.0e6;
@@ -1976,25 +6699,29 @@ int main(int argc, char ** argv)
 		frequency_rx = 460.0e6;
 	}
 
-    pthread_t TCPServerThread;   // Pointer to thread ID
     pthread_t enactScBbRxThread;   // Pointer to thread ID
 
     // Array that will be accessible to both Server and CE.
     // Server uses it to pass data to CE.
     struct feedbackStruct fb = {};
-
-    // For creating appropriate symbol length from 
-    // number of subcarriers and CP Length
-    unsigned int symbolLen;
+    // Waits for feedback time out on the monotonic clock, like the frame pacing
+    pthread_condattr_t fb_condattr;
+    pthread_condattr_init(&fb_condattr);
+    pthread_condattr_setclock(&fb_condattr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&fb.fb_mutex, NULL);
+    pthread_cond_init(&fb.fb_cond, &fb_condattr);
+    pthread_condattr_destroy(&fb_condattr);
 
     // Iterators
     int i_CE = 0;
     int i_Sc = 0;
     int DoneTransmitting = 0;
-    int isLastSymbol = 0;
     char scenario_list [30][60];
     char cogengine_list [30][60];
 
+    // Modulation and coding schemes available to the CEs
+    initMCSTable();
+
     int NumCE=readCEMasterFile(cogengine_list, verbose, isController);  
     int NumSc=readScMasterFile(scenario_list, verbose);  
 
@@ -2003,47 +6730,42 @@ int main(int argc, char ** argv)
     // Scenario struct used in each test
     struct Scenario sc = CreateScenario();
 
-    // framegenerator object used in each test
-    ofdmflexframegen fg;
-
-    // framesynchronizer object used in each test
-    ofdmflexframesync fs;
+    // Frame generators, synchronizers and buffers for simulation mode.
+    // They persist across frames, scenarios and CEs.
+    struct simulationState * sim = NULL;
 
 	// Quiet UHD output if not verbose
 	if(!verbose) uhd::msg::register_handler(&uhd_quiet);
 
-	// Identical pseudo random sequence generators for tx and rx
-	msequence tx_ms = msequence_create_default(9u);
-	msequence rx_ms = msequence_create_default(9u);
+	// Pseudo random payload shared by tx and rx
+	initPNTable();
+	initCountBitErrors();
 
     // Buffers for packet/frame data
     unsigned char header[8];                       // Must always be 8 bytes for ofdmflexframe
     unsigned char payload[1000];                   // Large enough to accomodate any (reasonable) payload that
                                                    // the CE wants to use.
 
-    std::complex<float> frameSamples[10000];      // Buffer of frame samples for each symbol.
-                                                   // Large enough to accomodate any (reasonable) payload that 
-                                                   // the CE wants to use.
     // USRP objects
     uhd::tx_metadata_t metaData;
     uhd::usrp::multi_usrp::sptr usrp;
     uhd::tx_streamer::sptr txStream;
 
-	float throughput = 0;
-	float total_symbols;
-	float payload_symbols;
-
 	// Metric Summary structs for each scenario and each cognitive engine
-	struct scenarioSummaryInfo sc_sum;
-	struct cognitiveEngineSummaryInfo ce_sum;
+	struct scenarioSummaryInfo sc_sum = {};
+	struct cognitiveEngineSummaryInfo ce_sum = {};
    
     // Statements for what information to print
-	bool print_frame_info = true;
-	bool print_validity_metrics = true;
-	bool print_error_metrics = false;
-	bool print_signal_quality_metrics = true;
-	bool print_spectral_metrics = true;
-	bool print_goal_metrics = true;
+	struct dataFileColumns columns;
+	columns.frame_info = true;
+	columns.validity_metrics = true;
+	columns.error_metrics = false;
+	columns.signal_quality_metrics = true;
+	columns.spectral_metrics = true;
+	columns.goal_metrics = true;
+	columns.learning_metrics = true;
+	columns.receiver_metrics = usingUSRPs && isController;
+	columns.error_histograms = errorHistograms;
 				 
 
     ////////////////////// End variable initializations.///////////////////////
@@ -2053,17 +6775,27 @@ int main(int argc, char ** argv)
 	signal(SIGQUIT, terminate);
 	signal(SIGKILL, terminate);
 
-    int client;
+    // TCP server for the receiver node(s)
+    struct tcpServer * server = NULL;
+    // Frames sent to the receivers that are awaiting feedback
+    struct inFlightTable * inFlight = NULL;
+    // Feedback on them heard over the air, written by rxCallback()
+    struct otaFeedbackTable * ota = NULL;
+    // With per_node aggregation, a copy of the CE for each receiver,
+    // and the receivers whose copy has not reached its goal yet
+    struct CognitiveEngine * nodeCE = NULL;
+    int nodeActive[MAX_RECEIVER_NODES] = {0};
 	
 	// Begin TCP Server Thread for slave node(s) if using USRP's
 	if(usingUSRPs && isController){
-		struct serverThreadStruct ss_slave = CreateServerStruct();
-		ss_slave.serverPort = serverPort;
-		ss_slave.fb_ptr = &fb;
-		ss_slave.client_ptr = &client;
-		pthread_create( &TCPServerThread, NULL, startTCPServer, (void*) &ss_slave);
+		server = (struct tcpServer *) calloc(1, sizeof(struct tcpServer));
+		inFlight = (struct inFlightTable *) calloc(1, sizeof(struct inFlightTable));
+		ota = (struct otaFeedbackTable *) calloc(1, sizeof(struct otaFeedbackTable));
+		nodeCE = (struct CognitiveEngine *) calloc(MAX_RECEIVER_NODES, sizeof(struct CognitiveEngine));
+		startTCPServer(server, serverPort, &fb, verbose);
 		printf("\nPress any key once all nodes have connected to the TCP server\n");
 		getchar();
+		printf("%d receiver(s) connected\n", tcpServerNumNodes(server));
 	}
 
     struct rxCBstruct rxCBs = CreaterxCBStruct();
@@ -2071,10 +6803,19 @@ int main(int argc, char ** argv)
     rxCBs.serverPort = serverPort;
     rxCBs.serverAddr = serverAddr;
     rxCBs.verbose = verbose;
-	rxCBs.rx_ms_ptr = &rx_ms;
 	rxCBs.isController = isController;
 	rxCBs.usingUSRPs = usingUSRPs;
 	rxCBs.fb_ptr = &fb;
+	rxCBs.ota_ptr = ota;
+#ifdef CRTS_PROFILE
+    // Stage latencies of the cell being run with USRPs. rxCallback() runs
+    // on the receive thread, so it records into a profile of its own that
+    // is merged into this one after the cell. The receive thread is never
+    // stopped, so that profile is only touched under fb_mutex.
+    struct stageProfile * profile = (struct stageProfile *) calloc(1, sizeof(struct stageProfile));
+    struct stageProfile * rxProfile = (struct stageProfile *) calloc(1, sizeof(struct stageProfile));
+    rxCBs.profile_ptr = rxProfile;
+#endif
 
     // Allow server time to finish initialization
     usleep(0.1e6);
@@ -2117,14 +6858,20 @@ int main(int argc, char ** argv)
     char dataFilename[50];
     time_t now = time(NULL);
     struct tm *t  = localtime(&now);
-    strftime(dataFilename, sizeof(dataFilename)-1, "data/%Y-%m-%d__%H-%M-%S__crts_data.txt", t);
+    strftime(dataFilename, sizeof(dataFilename)-1,
+        binaryLog ? "data/%Y-%m-%d__%H-%M-%S__crts_data.bin" : "data/%Y-%m-%d__%H-%M-%S__crts_data.txt", t);
     // TODO: Make sure data folder exists
     
     // Initialize Data File
-    FILE * dataFile;
+    FILE * dataFile = NULL;
+    struct crtsLog * dataLog = NULL;
     if (isController)
     {
-        if (dataToStdout)
+        if (binaryLog)
+        {
+            dataLog = openCrtsLog(dataToStdout ? NULL : dataFilename, &columns);
+        }
+        else if (dataToStdout)
         {
             dataFile = stdout;
         }
@@ -2136,6 +6883,18 @@ int main(int argc, char ** argv)
 
     // Begin running tests
 
+    // Run the whole CE x scenario matrix on worker threads
+    if (numJobs > 0)
+    {
+        runParallelSimulation(numJobs, numRepetitions, cogengine_list, NumCE, scenario_list, NumSc,
+            &columns, dataFile, dataLog, &sc_sum, &ce_sum, frequency_tx, frequency_rx, verbose);
+        if (dataLog) closeCrtsLog(dataLog, verbose);
+        if (dataFile && dataFile != stdout) fclose(dataFile);
+        return 0;
+    }
+
+    if (!usingUSRPs) sim = CreateSimulationState(verbose, isController);
+
     // For each Cognitive Engine
     for (i_CE=0; i_CE<NumCE; i_CE++)
     {
@@ -2145,16 +6904,19 @@ int main(int argc, char ** argv)
             
         if(isController){
 		    // Initialize current CE
+			freeCognitiveEngine(&ce);
 			ce = CreateCognitiveEngine();
 			readCEConfigFile(&ce,cogengine_list[i_CE], verbose);
 			// Send CE info to slave node(s)
-			if(usingUSRPs) write(client, (void*)&ce, sizeof(ce));
+			if(usingUSRPs) sendCognitiveEngine(server, &ce);
 		}
         ce.frequency_tx = frequency_tx;
 		ce.frequency_rx = frequency_rx;
         // Run each CE through each scenario
         for (i_Sc= 0; i_Sc<NumSc; i_Sc++)
         {                	
+            // Where the data of this CE/scenario cell goes
+            struct dataCell cellData = {dataFile, dataLog, &columns, i_CE, i_Sc, 0, 1};
 				
             if (isController)
             {                   
@@ -2164,43 +6926,38 @@ int main(int argc, char ** argv)
                 readScConfigFile(&sc,scenario_list[i_Sc], verbose);
                 
 				// Send Sc info to slave node(s)
-                if(usingUSRPs) write(client, (void*)&sc, sizeof(sc));	
+                if(usingUSRPs) sendScenario(server, &sc);
 				if (verbose) printf("\n\nStarting Scenario %d\n", i_Sc+1);
             	rxCBs.ce_ptr = &ce;
             	rxCBs.sc_ptr = &sc;
 
-                fprintf(dataFile, "Cognitive Engine %d\nScenario %d\n", i_CE+1, i_Sc+1);
-                
-				/////////// Print metrics by category /////////////
-				
-				if(print_frame_info) fprintf(dataFile,"%-10s%-7s","Linetype","Frame");
-				if(print_validity_metrics) fprintf(dataFile,"%-14s%-15s","Valid Header","Valid Payload");
-				if(print_error_metrics) fprintf(dataFile,"%-13s%-12s%-7s%-7s%-9s%-9s","Byte Errors","Bit Errors","PER","BER","Avg PER","Avg BER");
-				if(print_signal_quality_metrics) fprintf(dataFile,"%-10s%-11s","EVM (dB)","RSSI (dB)");
-				if(print_spectral_metrics) fprintf(dataFile,"%-12s%-21s","Throughput", "Spectral Efficiency");
-				if(print_goal_metrics) fprintf(dataFile,"%-16s","Avg Goal Value");
-				fprintf(dataFile,"\n");
-				if(print_frame_info) fprintf(dataFile,"----------------");
-				if(print_validity_metrics) fprintf(dataFile,"-----------------------------");
-				if(print_error_metrics) fprintf(dataFile,"---------------------------------------------------------");
-				if(print_signal_quality_metrics) fprintf(dataFile,"---------------------");
-				if(print_spectral_metrics) fprintf(dataFile,"--------------------------------");
-				if(print_goal_metrics) fprintf(dataFile,"----------------");
-				fprintf(dataFile,"\n");
-
-				/////////////////////////////////////////////////////
-				
-				fflush(dataFile);
+                beginDataCell(&cellData);
+				if (dataFile) fflush(dataFile);
             }
 
             // Initialize Receiver Defaults for current CE and Sc
             ce.frameNumber = 1;
-            fs = CreateFS(ce, sc, &rxCBs);
 
-            std::clock_t begin = std::clock();
-            std::clock_t now;
+            // Time of the test: wall time with USRPs, air time in simulation
+            struct crtsClock testClock;
+            if (usingUSRPs)
+                crtsClockStartWall(&testClock);
+            else
+                crtsClockStartVirtual(&testClock, ce.bandwidth);
+            // Frames are released delay_us apart with USRPs
+            struct framePacer pacer = {};
+            int paced = 0;
             // Begin Testing Scenario
             DoneTransmitting = 0;
+#ifdef CRTS_PROFILE
+            stageProfileReset(usingUSRPs ? profile : &sim->profile);
+            if (usingUSRPs)
+            {
+                pthread_mutex_lock(&fb.fb_mutex);
+                stageProfileReset(rxProfile);
+                pthread_mutex_unlock(&fb.fb_mutex);
+            }
+#endif
 
             if (usingUSRPs) 
             { 
@@ -2226,6 +6983,46 @@ int main(int argc, char ** argv)
 
 				if (isController) txcvr_ptr->start_rx();
 
+                // How the receivers' feedback is combined. With per_node aggregation
+                // every receiver connected now gets its own copy of the CE.
+                enum feedbackAggregationType aggregation = ce.feedbackAggregation;
+                int perNode = 0;
+                int target = -1;            // Receiver the current frame is sent to
+                // Frames are numbered in the order they are sent. ce.frameNumber
+                // counts the frames whose feedback the CE has seen.
+                unsigned int nextFrame = ce.frameNumber;
+                int stopSending = 0;
+                unsigned int seenUpdates = 0;
+                pacerStart(&pacer, (long long) (ce.delay_us*1000.0));
+                paced = 1;
+                if (isController)
+                {
+                    // Feedback left over from the last scenario is not about its frames
+                    pthread_mutex_lock(&fb.fb_mutex);
+                    fb.iteration = 0;
+                    seenUpdates = fb.updates;
+                    if (ota != NULL)
+                        memset(ota->received, 0, sizeof(ota->received));
+                    pthread_mutex_unlock(&fb.fb_mutex);
+                    inFlight->count = 0;
+                }
+                if (isController && server != NULL)
+                {
+                    memset(sc_sum.nodes, 0, sizeof(sc_sum.nodes));
+                    if (aggregation == FB_AGGREGATE_PER_NODE)
+                    {
+                        perNode = tcpServerConnectedNodes(server, nodeActive) > 0;
+                        for (int n=0; n<MAX_RECEIVER_NODES; n++)
+                            if (nodeActive[n])
+                                copyCognitiveEngine(&nodeCE[n], &ce);
+                        if (!perNode)
+                        {
+                            fprintf(stderr, "WARNING: No receiver is connected. Using worst_node feedback aggregation\n");
+                            aggregation = FB_AGGREGATE_WORST_NODE;
+                        }
+                    }
+                }
+
                 // Each instance of this while loop transmits one packet
                 while(!DoneTransmitting)
                 {
@@ -2241,30 +7038,32 @@ int main(int argc, char ** argv)
                        	}
                             
                        	// Structs for CE and Sc info
-                       	struct CognitiveEngine ce_controller;
-                       	struct Scenario sc_controller;
+                       	struct CognitiveEngine ce_controller = CreateCognitiveEngine();
+                       	struct Scenario sc_controller = CreateScenario();
 						
                        	int continue_running = 1;
 						int rflag;
-						char readbuffer[1000];
+						struct wireHeader msg;
+						unsigned char readbuffer[WIRE_MAX_BODY_LEN];
 
                        	// Receive CE info
-                       	rflag = recv(socket_to_server, &readbuffer, sizeof(struct CognitiveEngine), 0);
-                       	if(rflag == 0 || rflag == -1){
+                       	rflag = wireRecvMessage(socket_to_server, &msg, readbuffer);
+                       	if(rflag != EX_OK || msg.type != WIRE_MSG_CE_CONFIG ||
+                           wireDecodeCognitiveEngine(readbuffer, msg.length, &ce_controller) != EX_OK){
                        		printf("Error receiving CE info from the controller\n");
 							close(socket_to_server);
 							exit(1);
 						}
-		    			else ce_controller = *(struct CognitiveEngine*)readbuffer;
 							
 		    			// Receive Sc info
-		    			rflag = recv(socket_to_server, &readbuffer, sizeof(struct Scenario), 0);
-                        if(rflag == 0 || rflag == -1){
+		    			rflag = wireRecvMessage(socket_to_server, &msg, readbuffer);
+                        if(rflag != EX_OK || msg.type != WIRE_MSG_SCENARIO_CONFIG ||
+                           wireDecodeScenario(readbuffer, msg.length, &sc_controller) != EX_OK){
                            	printf("Error receiving Scenario info from the controller\n");
 							close(socket_to_server);
 							exit(1);
   			    		}
-		    			else sc_controller = *(struct Scenario*)readbuffer;
+						initScenarioChannels(&sc_controller);
 							
 		    			// Initialize members of esbrs struct sent to enactScenarioBasebandRx()
 		    			//struct enactScenarioBasebandRxStruct esbrs = {.txcvr_ptr = txcvr_ptr, .ce_ptr = &ce_controller, .sc_ptr = &sc_controller};
@@ -2289,11 +7088,10 @@ int main(int argc, char ** argv)
                         while(continue_running)
                         {
 							// Wait until server provides more information, closes, or there is an error
-							rflag = recv(socket_to_server, &readbuffer, sizeof(struct Scenario)+sizeof(struct CognitiveEngine), 0);
-							if(rflag == 0 || rflag == -1){
+							rflag = wireRecvMessage(socket_to_server, &msg, readbuffer);
+							if(rflag != EX_OK){
 								printf("Socket closed or failed\n");
 				 				close(socket_to_server);
-								msequence_destroy(rx_ms);
 								exit(1);
 							}
 								
@@ -2306,20 +7104,20 @@ int main(int argc, char ** argv)
                                 // open new ofdmtxrx object
                                 // open new enactScenarioBasebandRx Thread
                             //}
-                            /*else if(rflag == sizeof(struct Scenario)){
+                            /*else if(msg.type == WIRE_MSG_SCENARIO_CONFIG){
                             	if(verbose) printf("Rewriting Scenario Info");
 								pthread_cancel(enactScBbRxThread);
 								delete txcvr_ptr;
-								sc_controller = *(struct Scenario*)readbuffer;
+								wireDecodeScenario(readbuffer, msg.length, &sc_controller);
 								ofdmtxrx *txcvr_ptr = new ofdmtxrx(ce.numSubcarriers, ce.CPLen, ce.taperLen, p, rxCallback, (void*) &rxCBs, true);
 								struct enactScenarioBasebandRxStruct esbrs = {.txcvr_ptr = txcvr_ptr, .ce_ptr = &ce_controller, .sc_ptr = &sc_controller};							
 								pthread_create( &enactScBbRxThread, NULL, enactScenarioBasebandRx, (void*) &esbrs);
 							}
-							else if(rflag == sizeof(struct CognitiveEngine)){
+							else if(msg.type == WIRE_MSG_CE_CONFIG){
 								if(verbose) printf("Rewriting CE info");
 								pthread_cancel(enactScBbRxThread);
 								delete txcvr_ptr;
-								ce_controller = *(struct CognitiveEngine*)readbuffer;
+								wireDecodeCognitiveEngine(readbuffer, msg.length, &ce_controller);
 								ofdmtxrx *txcvr_ptr = new ofdmtxrx(ce.numSubcarriers, ce.CPLen, ce.taperLen, p, rxCallback, (void*) &rxCBs, true);
 								struct enactScenarioBasebandRxStruct esbrs = {.txcvr_ptr = txcvr_ptr, .ce_ptr = &ce_controller, .sc_ptr = &sc_controller};							
 								pthread_create( &enactScBbRxThread, NULL, enactScenarioBasebandRx, (void*) &esbrs);
@@ -2337,216 +7135,208 @@ int main(int argc, char ** argv)
                        	printf("Set Tx antenna to %s\n", "TX/RX");
                     }
 
-                    int i = 0;
-                    // Generate data
-                    if (verbose) printf("\n\nGenerating data that will go in frame...\n");
-					header[0] = i_CE+1;
-					header[1] = i_Sc+1;
-                    for (i=0; i<4; i++)
-                       	header[i+2] = (ce.frameNumber & (0xFF<<(8*(3-i))))>>(8*(3-i));
-					header[6] = 0;
-					header[7] = 0;
-                    for (i=0; i<(signed int)ce.payloadLen; i++)
-                       	payload[i] = (unsigned char)msequence_generate_symbol(tx_ms,8);
-
-                    // Include frame number in header information
-                    if (verbose) printf("Frame Num: %u\n", ce.frameNumber);
-
-                    // Set Modulation Scheme
-                    if (verbose) printf("Modulation scheme: %s\n", ce.modScheme);
-                    modulation_scheme ms = convertModScheme(ce.modScheme, &ce.bitsPerSym);
-
-                    // Set Cyclic Redundency Check Scheme
-                    //crc_scheme check = convertCRCScheme(ce.crcScheme);
-
-                    // Set inner forward error correction scheme
-                    if (verbose) printf("Inner FEC: ");
-                    fec_scheme fec0 = convertFECScheme(ce.innerFEC, verbose);
-
-                    // Set outer forward error correction scheme
-                    if (verbose) printf("Outer FEC: ");
-                    fec_scheme fec1 = convertFECScheme(ce.outerFEC, verbose);
-
-                    // Replace with txcvr methods that allow access to samples:
-                    txcvr_ptr->assemble_frame(header, payload, ce.payloadLen, ms, fec0, fec1);
-                    int isLastSymbol = 0;
-                    while(!isLastSymbol)
+                    // Send frames until framesInFlight of them are awaiting feedback.
+                    // What the CE learns from feedback applies to the next frame sent.
+                    while (!stopSending && inFlight->count < ce.framesInFlight)
                     {
-                        isLastSymbol = txcvr_ptr->write_symbol();
-						enactScenarioBasebandTx(txcvr_ptr->fgbuffer, txcvr_ptr->fgbuffer_len, &ce, &sc);
-						txcvr_ptr->transmit_symbol();
+                        // Until the next frame is due, wait for feedback on those in flight
+                        if (inFlight->count > 0 && !pacerDue(&pacer))
+                            break;
+
+                        // The CE that chooses this frame's parameters
+                        struct CognitiveEngine * txCE = &ce;
+                        if (perNode)
+                        {
+                            target = nextTargetNode(nodeActive, target);
+                            if (target < 0)
+                            {
+                                stopSending = 1;
+                                break;
+                            }
+                            txCE = &nodeCE[target];
+                        }
+
+                        int i = 0;
+                        // Generate data
+                        PROFILE_START(profile_t);
+                        if (verbose) printf("\n\nGenerating data that will go in frame...\n");
+                        header[0] = i_CE+1;
+                        header[1] = i_Sc+1;
+                        for (i=0; i<4; i++)
+                            header[i+2] = (nextFrame & (0xFF<<(8*(3-i))))>>(8*(3-i));
+                        header[6] = 0;
+                        header[7] = 0;
+                        memcpy(payload, pnFrameSequence(nextFrame), txCE->payloadLen);
+                        PROFILE_LAP(profile, PROFILE_PAYLOAD, profile_t);
+
+                        // Include frame number in header information
+                        if (verbose) printf("Frame Num: %u\n", nextFrame);
+
+                        if (verbose) printf("Modulation scheme: %s\n", modSchemeName(ceModScheme(txCE)));
+                        if (verbose) printf("Inner FEC: %s\n", fecSchemeName(ceInnerFEC(txCE)));
+                        if (verbose) printf("Outer FEC: %s\n", fecSchemeName(ceOuterFEC(txCE)));
+
+                        // Replace with txcvr methods that allow access to samples:
+                        txcvr_ptr->assemble_frame(header, payload, txCE->payloadLen, ceModScheme(txCE), ceInnerFEC(txCE), ceOuterFEC(txCE));
+                        txCE->frameLen = ofdmflexframegen_getframelen(txcvr_ptr->fg);
+                        PROFILE_LAP(profile, PROFILE_ASSEMBLE, profile_t);
+                        pacerWait(&pacer);
+                        PROFILE_START(profile_symbol);
+                        int isLastSymbol = 0;
+                        while(!isLastSymbol)
+                        {
+                            isLastSymbol = txcvr_ptr->write_symbol();
+                            PROFILE_LAP(profile, PROFILE_WRITE_SYMBOL, profile_symbol);
+                            enactScenarioBasebandTx(txcvr_ptr->fgbuffer, txcvr_ptr->fgbuffer_len, txCE, &sc);
+                            PROFILE_LAP(profile, PROFILE_CHANNEL, profile_symbol);
+                            txcvr_ptr->transmit_symbol();
+                            PROFILE_LAP(profile, PROFILE_TRANSMIT, profile_symbol);
+                        }
+                        txcvr_ptr->end_transmit_frame();
+
+                        // Remember what was sent until its feedback is in
+                        struct inFlightFrame * sent = inFlightAdd(inFlight, nextFrame, FEEDBACK_TIMEOUT_NS);
+                        sent->target = target;
+                        sent->ce = txCE;
+                        sent->sent = txFrameParamsOf(txCE);
+                        sent->throughput = ceThroughput(txCE, txCE->frameLen);
+                        nextFrame++;
+                        if (verbose)
+                            printf("Frame transmitted. %u frame(s) awaiting feedback\n", inFlight->count);
                     }
-                    txcvr_ptr->end_transmit_frame();
-					//printf("Transmitted frame\n");
-                        
-					// Get current time. Then add delay to find out at what time to stop waiting. 
-                    //TODO switch to boost library for more accuracy
-   	                struct timeval timeNow;
-       	            struct timespec releaseTime;
-           	        gettimeofday(&timeNow, NULL);
-               	    double wholeSecondsDelay = 0.0;
-                   	//printf("delay = %f\n", ce.delay_us);
-                    double delay_fpart_s = modf(ce.delay_us*1e-6, &wholeSecondsDelay);
-   	                //printf("wholeSecondsDelay = %f\n", wholeSecondsDelay);
-
-       	            //releaseTime.tv_sec = timeNow.tv_sec + (int) wholeSecondsDelay;
-           	        //unsigned int wholeNsDelay = (int) delay_fpart_s*1e9;
-               	    //releaseTime.tv_nsec = (timeNow.tv_usec*1000) + wholeNsDelay;
-
-                    // Temporary Fix
-       	            releaseTime.tv_sec = timeNow.tv_sec;
-               	    releaseTime.tv_nsec = (timeNow.tv_usec*1000) + 20000000;
-
-                   	// Lock the feedback struct mutex and
-                    // Wait for either a signal, or until the delay time has passed.
-   	                //printf("In main: locking fb_mutex\n");
-       	            //pthread_mutex_lock(&fb.fb_mutex);
-           	        if (verbose)
-               	        printf("Frame transmitted. Waiting for feedback OTA or for timeout\n");
-                   	int ptrt = pthread_cond_timedwait(&fb.fb_cond, &fb.fb_mutex, &releaseTime);
-	
-					DoneTransmitting = postTxTasks(&ce, &fb, verbose);
-                    // Record the feedback data received
-                    //TODO: include fb.cfo
 
-					// Compute throughput and spectral efficiency
-					payload_symbols = (float)ce.payloadLen/(float)ce.bitsPerSym;
-					total_symbols = (float)ofdmflexframegen_getframelen(txcvr_ptr->fg);
-					throughput = (float)ce.bitsPerSym*ce.bandwidth*(payload_symbols/total_symbols);
+                    // Wait for feedback over the air or from the receivers' TCP links,
+                    // at most until the oldest frame in flight runs out of time or
+                    // the next frame is due. The update count tells whether feedback
+                    // came in while the lock was not held.
+                    pthread_mutex_lock(&fb.fb_mutex);
+                    if (inFlight->count > 0)
+                    {
+                        const struct timespec * deadline = &inFlightFind(inFlight, inFlight->oldest)->deadline;
+                        if (!stopSending && inFlight->count < ce.framesInFlight && timespecDiffNs(&pacer.next, deadline) < 0)
+                            deadline = &pacer.next;
+                        while (fb.updates == seenUpdates)
+                            if (pthread_cond_timedwait(&fb.fb_cond, &fb.fb_mutex, deadline) == ETIMEDOUT)
+                                break;
+                    }
+                    seenUpdates = fb.updates;
 
-					/////////// Print metrics by category /////////////
-				
-					if(print_frame_info) fprintf(dataFile,"%-10s%-7i","crtsdata",ce.iteration);
-					if(print_validity_metrics) fprintf(dataFile,"%-14i%-15i",fb.header_valid,fb.payload_valid);
-					if(print_error_metrics) fprintf(dataFile,"%-13i%-12i%-7.2f%-7.2f%-9.2f%-9.2f",fb.payloadByteErrors,fb.payloadBitErrors,ce.PER,ce.BER,ce.PER_avg,ce.BER_avg);
-					if(print_signal_quality_metrics) fprintf(dataFile,"%-10.2f%-11.2f",fb.evm,fb.rssi);
-					if(print_spectral_metrics) fprintf(dataFile,"%-12.2f%-21.2f",throughput, throughput/ce.bandwidth);
-					if(print_goal_metrics) fprintf(dataFile,"%-16.2f",ce.averagedGoalValue);
-				    fprintf(dataFile,"\n");
-
-					/////////////////////////////////////////////////////
-					
-					//All metrics
-                    //fprintf(dataFile, "%-10s %-10u %-14i %-15i %-10.2f %-10.2f %-10.2f %-19u %-16.2f %-18u\n", //%-12.2f %-20.2f %-19.2f 
-					//"crtsdata:", ce.iteration, fb.header_valid, fb.payload_valid, fb.evm, fb.rssi, ce.PER, fb.payloadByteErrors,
-					//ce.BER, fb.payloadBitErrors);//, throughput, throughput/ce.bandwidth, ce.averagedGoalValue);
-					//Useful metrics
-					/*fprintf(dataFile, "%-10s %-10i %-10.2f %-10.2f %-8.2f %-12.2f %-12.2f %-20.2f %-19.2f\n", 
-					"crtsdata:", ce.iteration,  fb.evm, fb.rssi, ce.PER,
-					ce.BERLastPacket, throughput, throughput/ce.bandwidth, ce.averagedGoalValue);*/
-                    fflush(dataFile);
-
-					// Increment the frame counter
-                    ce.frameNumber++;
-					ce.iteration++;
+                    // Sort the feedback out to the frames it is about
+                    for (unsigned int k=0; k<inFlight->count; k++)
+                    {
+                        struct inFlightFrame * heard = inFlightFind(inFlight, inFlight->oldest + k);
+                        unsigned int slot = heard->frameNumber % MAX_FRAMES_IN_FLIGHT;
+                        if (ota->received[slot] && ota->fb[slot].iteration == heard->frameNumber)
+                        {
+                            if (!heard->otaReceived)
+                                feedbackStruct_copy(&heard->ota, &ota->fb[slot]);
+                            heard->otaReceived = 1;
+                            ota->received[slot] = 0;
+                        }
+                    }
+                    pthread_mutex_unlock(&fb.fb_mutex);
+                    tcpServerCollectFeedback(server, inFlight);
+
+                    // Hand the feedback to the CEs in the order the frames were sent,
+                    // retiring every frame there is nothing more to wait for on
+                    int connected[MAX_RECEIVER_NODES];
+                    tcpServerConnectedNodes(server, connected);
+                    struct timespec timeNow;
+                    clock_gettime(CLOCK_MONOTONIC, &timeNow);
+                    while (inFlight->count > 0)
+                    {
+                        struct inFlightFrame * f = inFlightFind(inFlight, inFlight->oldest);
+                        inFlightUpdateNodes(f, connected);
+                        if (!inFlightComplete(f, &timeNow))
+                            break;
+
+                        // Feedback from the receivers' TCP links replaces what was heard over the air.
+                        // A frame no one reported on counts as lost.
+                        struct feedbackStruct frameFb = {};
+                        frameFb.iteration = f->frameNumber;
+                        if (f->otaReceived)
+                            feedbackStruct_copy(&frameFb, &f->ota);
+                        aggregateFeedback(aggregation, &f->rf, f->frameNumber, f->target, &frameFb);
+                        updateNodeSummary(&sc_sum, &f->rf, f->sent.payloadLen, f->target);
+                        if (perNode && !f->rf.connected[f->target])
+                            nodeActive[f->target] = 0;     // Gone, stop sending to it
+
+                        PROFILE_START(profile_t);
+                        int ceDone = postTxTasks(f->ce, &frameFb, &f->sent, verbose);
+                        PROFILE_LAP(profile, PROFILE_POST_TX, profile_t);
+                        if (perNode)
+                        {
+                            // Done once every receiver's CE has reached its goal
+                            if (ceDone)
+                                nodeActive[f->target] = 0;
+                            ceDone = nextTargetNode(nodeActive, f->target) < 0;
+                        }
+                        // Frames still in flight are waited for before the scenario ends
+                        if (ceDone)
+                            stopSending = 1;
+
+                        printFrameData(&cellData, f->ce, &frameFb, &f->sent, f->throughput, f->rf.reports, f->target);
+                        updateScenarioSummary(&sc_sum, &frameFb, f->sent.payloadLen, i_CE, i_Sc);
+
+                        // Increment the frame counter
+                        ce.frameNumber++;
+                        ce.iteration++;
+                        if (f->ce != &ce)
+                        {
+                            f->ce->frameNumber++;
+                            f->ce->iteration++;
+                        }
+                        inFlightRetireOldest(inFlight);
+                    }
+                    if (dataFile) fflush(dataFile);
+                    DoneTransmitting = stopSending && inFlight->count == 0;
 
                     // Update the clock
-                    now = std::clock();
-                    ce.runningTime = double(now-begin)/CLOCKS_PER_SEC;
-
-					updateScenarioSummary(&sc_sum, &fb, &ce, i_CE, i_Sc);
+                    ce.runningTime = crtsClockNow(&testClock);
+                    for (int n=0; perNode && n<MAX_RECEIVER_NODES; n++)
+                        nodeCE[n].runningTime = ce.runningTime;
                 } // End while not done transmitting loop
+
+                if (isController)
+                    pacerReport(&pacer, stdout);
+
+                if (perNode)
+                {
+                    for (int n=0; n<MAX_RECEIVER_NODES; n++)
+                        freeCognitiveEngine(&nodeCE[n]);
+                    memset(nodeCE, 0, MAX_RECEIVER_NODES*sizeof(struct CognitiveEngine));
+                }
                 // TODO: close ofdmtxrx object
             }
             else // If not using USRPs
             {
-                while(!DoneTransmitting)
-                {
-                    // Initialize Transmitter Defaults for current CE and Sc
-                    fg = CreateFG(ce, sc, verbose);  // Create ofdmflexframegen object with given parameters
-                    if (verbose) ofdmflexframegen_print(fg);
-
-                    // Iterator
-                    int i = 0;
-
-                    // Generate data
-                    if (verbose) printf("\n\nGenerating data that will go in frame...\n");
-                    header[0] = i_CE+1;
-					header[1] = i_Sc+1;
-                    for (i=0; i<4; i++)
-                       	header[i+2] = (ce.frameNumber & (0xFF<<(8*(3-i))))>>(8*(3-i));
-					header[6] = 0;
-					header[7] = 0;
-                    for (i=0; i<(signed int)ce.payloadLen; i++)
-                        payload[i] = (unsigned char)msequence_generate_symbol(tx_ms,8);
-
-					// Called just to update bits per symbol field
-					convertModScheme(ce.modScheme, &ce.bitsPerSym);
-
-                    // Assemble frame
-                    ofdmflexframegen_assemble(fg, header, payload, ce.payloadLen);
-                    //printf("DoneTransmitting= %d\n", DoneTransmitting);
-						
-                    // i.e. Need to transmit each symbol in frame.
-                    isLastSymbol = 0;
-
-                    while (!isLastSymbol) 
-                    {
-                        //isLastSymbol = txTransmitPacket(ce, &fg, frameSamples, metaData, txStream, usingUSRPs);
-                        isLastSymbol = ofdmflexframegen_writesymbol(fg, frameSamples);
-                        symbolLen = ce.numSubcarriers + ce.CPLen;
-                        enactScenarioBasebandTx(frameSamples, symbolLen, &ce, &sc);
-							
-                        // Rx Receives packet
-						ofdmflexframesync_execute(fs, frameSamples, symbolLen);
-                    } // End Transmition For loop
-
-                    DoneTransmitting = postTxTasks(&ce, &fb, verbose);
-
-					fflush(dataFile);
-
-					// Compute throughput and spectral efficiency
-					payload_symbols = (float)ce.payloadLen/(float)ce.bitsPerSym;
-					total_symbols = (float)ofdmflexframegen_getframelen(fg);
-					throughput = (float)ce.bitsPerSym*ce.bandwidth*(payload_symbols/total_symbols);
-
-					/////////// Print metrics by category /////////////
-				
-					if(print_frame_info) fprintf(dataFile,"%-10s%-7i","crtsdata",ce.iteration);
-					if(print_validity_metrics) fprintf(dataFile,"%-14i%-15i",fb.header_valid,fb.payload_valid);
-					if(print_error_metrics) fprintf(dataFile,"%-13i%-12i%-7.2f%-7.2f%-9.2f%-9.2f",fb.payloadByteErrors,fb.payloadBitErrors,ce.PER,ce.BER,ce.PER_avg,ce.BER_avg);
-					if(print_signal_quality_metrics) fprintf(dataFile,"%-10.2f%-11.2f",fb.evm,fb.rssi);
-					if(print_spectral_metrics) fprintf(dataFile,"%-12.2f%-21.2f",throughput, throughput/ce.bandwidth);
-					if(print_goal_metrics) fprintf(dataFile,"%-16.2f",ce.averagedGoalValue);
-				    fprintf(dataFile,"\n");
-
-					/////////////////////////////////////////////////////
-					
-					//All metrics
-                    //fprintf(dataFile, "%-10s %-10u %-14i %-15i %-10.2f %-10.2f %-10.2f %-19u %-16.2f %-18u \n", // %-12.2f %-20.2f %-19.2f
-					//"crtsdata:", ce.iteration, fb.header_valid, fb.payload_valid, fb.evm, fb.rssi, ce.PER, fb.payloadByteErrors,
-					//ce.BER, fb.payloadBitErrors);//, throughput, throughput/ce.bandwidth, ce.averagedGoalValue);
-					//Useful metrics
-					/*fprintf(dataFile, "%-10s %-10i %-10.2f %-10.2f %-8.2f %-12.2f %-12.2f %-20.2f %-19.2f\n", 
-					"crtsdata:", ce.iteration,  fb.evm, fb.rssi, ce.PER,
-					ce.BERLastPacket, throughput, throughput/ce.bandwidth, ce.averagedGoalValue);*/
-
-                    // Increment the frame counters and iteration counter
-                    ce.frameNumber++;
-					ce.iteration++;
-                    // Update the clock
-                    now = std::clock();
-                    ce.runningTime = double(now-begin)/CLOCKS_PER_SEC;
-
-					updateScenarioSummary(&sc_sum, &fb, &ce, i_CE, i_Sc);
-                } // End else While loop					
+                struct cellSummary cell = {};
+                simulateScenario(sim, &ce, &sc, &cell, &testClock, &cellData, verbose);
+                addCellSummary(&sc_sum, &cell, i_CE, i_Sc);
             }
 
-            clock_t end = clock();
-            double time = (end-begin)/(double)CLOCKS_PER_SEC + ce.iteration*ce.delay_us/1.0e6;
-            //fprintf(dataFile, "Elapsed Time: %f (s)", time);
-			fprintf(dataFile, "Begin: %li End: %li Clock/s: %li Time: %f", begin, end, CLOCKS_PER_SEC, time);
-            fflush(dataFile);
+            endDataCell(&cellData, &testClock, paced ? &pacer : NULL);
+#ifdef CRTS_PROFILE
+            if (usingUSRPs)
+            {
+                pthread_mutex_lock(&fb.fb_mutex);
+                stageProfileMerge(profile, rxProfile);
+                pthread_mutex_unlock(&fb.fb_mutex);
+            }
+            if (isController)
+                stageProfilePrint(stdout, usingUSRPs ? profile : &sim->profile, i_CE, i_Sc);
+#endif
 
             // Reset the goal
             ce.latestGoalValue = 0.0;
             ce.errorFreePayloads = 0;
             if (verbose) printf("Scenario %i completed for CE %i.\n", i_Sc+1, i_CE+1);
-            fprintf(dataFile, "\n\n");
-            fflush(dataFile);
 
 			updateCognitiveEngineSummaryInfo(&ce_sum, &sc_sum, &ce, i_CE, i_Sc);
 
+            // Release the scenario's channel state
+            if (isController) destroyScenarioChannels(&sc);
+
 			// Reset frame number
 			ce.frameNumber = 0;
             
@@ -2554,21 +7344,29 @@ int main(int argc, char ** argv)
 
         if (verbose) printf("Tests on Cognitive Engine %i completed.\n", i_CE+1);
 
-		// Divide the sum of each metric by the number of scenarios run to get the final metric
-		ce_sum.EVM[i_CE] /= i_Sc;
-		ce_sum.RSSI[i_CE] /= i_Sc;
-		ce_sum.PER[i_CE] /= i_Sc;
-
-		// Print cognitive engine summaries
-		printf("Cognitive Engine %i Summary:\nTotal frames: %i\nPercent valid headers: %2f\nPercent valid payloads: %2f\nAverage EVM: %2f\n"
-			"Average RSSI: %2f\nAverage BER: %2f\nAverage PER: %2f\n\n", i_CE+1, ce_sum.total_frames[i_CE], (float)ce_sum.valid_headers[i_CE]/(float)ce_sum.total_frames[i_CE],
-			(float)ce_sum.valid_payloads[i_CE]/(float)ce_sum.total_frames[i_CE], ce_sum.EVM[i_CE], ce_sum.RSSI[i_CE], (float)ce_sum.bit_errors[i_CE]/(float)ce_sum.total_bits[i_CE], ce_sum.PER[i_CE]);
+		printCognitiveEngineSummary(&ce_sum, i_CE, i_Sc);
 
     } // End CE for loop
 
 	// destroy objects
-	msequence_destroy(tx_ms);
-	msequence_destroy(rx_ms);
+	if (dataLog) closeCrtsLog(dataLog, verbose);
+	if (sim) destroySimulationState(sim);
+#ifdef CRTS_PROFILE
+	free(profile);
+	// Detach it first: the receive thread may still be calling rxCallback()
+	pthread_mutex_lock(&fb.fb_mutex);
+	rxCBs.profile_ptr = NULL;
+	pthread_mutex_unlock(&fb.fb_mutex);
+	free(rxProfile);
+#endif
+	if (server)
+	{
+		stopTCPServer(server);
+		free(server);
+		free(inFlight);
+		free(ota);
+		free(nodeCE);
+	}
 	close(socket_to_server);
 
 	if(!usingUSRPs) close(socket_to_server);
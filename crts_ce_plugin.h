@@ -0,0 +1,101 @@
+// C interface for cognitive engine plugins.
+//
+// A plugin is a shared object that decides how a CE adapts its transmit
+// parameters. It is named in a CE config file with the 'plugin' option and
+// loaded into the crts process with dlopen(), so it is called once per
+// frame without copying feedback between processes.
+//
+// A plugin exports crts_ce_plugin_entry(), which returns a description of
+// the plugin. crts refuses plugins built against a different
+// CRTS_CE_PLUGIN_ABI_VERSION. Structures are only ever extended by
+// appending fields, along with a new version number.
+
+#ifndef CRTS_CE_PLUGIN_H
+#define CRTS_CE_PLUGIN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRTS_CE_PLUGIN_ABI_VERSION 1
+
+// Feedback on the last frame, as reported by the receiver.
+// Same layout as the start of crts' own feedback structure, which is
+// passed to the plugin as is.
+struct crts_ce_feedback {
+    int          header_valid;
+    int          payload_valid;
+    unsigned int payload_len;
+    unsigned int payloadByteErrors;
+    unsigned int payloadBitErrors;
+    unsigned int iteration;         // Frame number
+    float        evm;
+    float        rssi;
+    float        cfo;
+};
+
+// The CE's metrics and current transmit parameters
+struct crts_ce_metrics {
+    unsigned int frameNumber;
+    double       runningTime;       // Seconds since the CE started the scenario
+    float        PER;
+    float        PER_avg;
+    float        BER;
+    float        BER_avg;
+    unsigned int validPayloads;
+    unsigned int errorFreePayloads;
+    float        latestGoalValue;
+    float        averagedGoalValue;
+
+    unsigned int mcs_index;         // Rung of crts' ladder of modulation and coding schemes, which
+    unsigned int num_mcs;           // is sorted by strictly increasing efficiency. A scheme that is
+                                    // not on the ladder reports the closest rung below it.
+    unsigned int bits_per_symbol;
+    float        code_rate;
+    float        efficiency;        // Information bits per symbol
+    unsigned int payloadLen;
+    float        txgain_dB;
+};
+
+// Changes requested by a plugin. Only the fields whose CRTS_CE_SET_ bit is
+// set in 'set' are used.
+#define CRTS_CE_SET_MCS_STEP        (1u<<0)     // Move mcs_step rungs along the MCS ladder
+#define CRTS_CE_SET_MCS_INDEX       (1u<<1)     // Use the MCS ladder rung mcs_index
+#define CRTS_CE_SET_MCS_EFFICIENCY  (1u<<2)     // Use the most efficient rung with at most efficiency bits/symbol
+#define CRTS_CE_SET_PAYLOAD_LEN     (1u<<3)
+#define CRTS_CE_SET_TXGAIN_DB       (1u<<4)
+
+struct crts_ce_delta {
+    uint32_t     set;
+    int          mcs_step;
+    unsigned int mcs_index;
+    float        efficiency;
+    unsigned int payloadLen;        // Limited to the CE's payloadLenMin..payloadLenMax
+    float        txgain_dB;
+};
+
+struct crts_ce_plugin {
+    unsigned int abi_version;       // CRTS_CE_PLUGIN_ABI_VERSION
+    const char * name;
+
+    // Create the state of one CE instance. args is the CE's 'pluginArgs'
+    // option, or an empty string. May return NULL if the plugin keeps no state.
+    void * (*create)(const char * args);
+    void   (*destroy)(void * state);
+
+    // Called for every frame. The delta is cleared before the call.
+    // Returns 0 on success. Any other value ends the test with an error.
+    int (*decide)(void * state, const struct crts_ce_feedback * fb,
+                  const struct crts_ce_metrics * metrics, struct crts_ce_delta * delta);
+};
+
+#define CRTS_CE_PLUGIN_ENTRY "crts_ce_plugin_entry"
+typedef const struct crts_ce_plugin * (*crts_ce_plugin_entry_t)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRTS_CE_PLUGIN_H
@@ -0,0 +1,118 @@
+// Binary experiment log.
+//
+// With -l, crts writes one fixed-width record per frame instead of a line
+// of text, plus a record at the start and at the end of each CE/scenario
+// cell. The file starts with a crts_log_file_header. Records are written
+// in the byte order of the machine that ran the test, and are only read on
+// machines with the same byte order: readers reject a log whose magic
+// number reads byte-swapped.
+//
+// Records of different cells of a parallel run may be interleaved. The
+// records of one cell are always in order, so a stable sort by cell
+// restores the order of a serial run. 'crts -L <log>' does that and
+// prints the same text table a run without -l writes.
+//
+// Readers accept only logs of exactly their own version and record size,
+// so any change to the records needs a new version number. Version 2
+// widened the frame's mcs to 16 bits in place, since crts' MCS table has
+// more than 256 entries; version 1 logs can no longer be read.
+
+#ifndef CRTS_LOG_H
+#define CRTS_LOG_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CRTS_LOG_MAGIC 0x474c5443u         // "CTLG" when read in the right byte order
+#define CRTS_LOG_VERSION 2
+
+// Columns of the text table (crts' dataFileColumns) a log was written with
+#define CRTS_LOG_COL_FRAME_INFO         (1u<<0)
+#define CRTS_LOG_COL_VALIDITY           (1u<<1)
+#define CRTS_LOG_COL_ERRORS             (1u<<2)
+#define CRTS_LOG_COL_SIGNAL_QUALITY     (1u<<3)
+#define CRTS_LOG_COL_SPECTRAL           (1u<<4)
+#define CRTS_LOG_COL_GOAL               (1u<<5)
+#define CRTS_LOG_COL_LEARNING           (1u<<6)
+#define CRTS_LOG_COL_RECEIVERS          (1u<<7)
+
+struct crts_log_file_header {
+    uint32_t magic;                 // CRTS_LOG_MAGIC
+    uint16_t version;               // CRTS_LOG_VERSION
+    uint16_t record_size;           // sizeof(struct crts_log_record)
+    uint32_t columns;               // CRTS_LOG_COL_ bits
+    uint32_t reserved;
+};
+
+enum crts_log_record_type {
+    CRTS_LOG_CELL_BEGIN = 1,
+    CRTS_LOG_FRAME,
+    CRTS_LOG_CELL_END
+};
+
+// What the CE saw of one frame
+struct crts_log_frame {
+    uint32_t iteration;             // The Frame column
+    uint32_t frame_number;          // Number in the frame's header
+    double   ce_time;               // CE's running time when the feedback came in [s]
+    uint8_t  header_valid;
+    uint8_t  payload_valid;
+    uint16_t mcs;                   // Index into crts' MCS table
+    uint8_t  mod_scheme;            // liquid modulation_scheme
+    uint8_t  inner_fec;             // liquid fec_scheme
+    uint8_t  outer_fec;
+    uint8_t  reserved;
+    int16_t  node;                  // Receiver the frame was sent to, -1 if all
+    uint16_t reports;               // Receivers that reported on it
+    uint32_t payload_len;
+    uint32_t byte_errors;
+    uint32_t bit_errors;
+    float    PER;
+    float    BER;
+    float    PER_avg;
+    float    BER_avg;
+    float    evm;
+    float    rssi;
+    float    cfo;
+    float    throughput;
+    float    spectral_efficiency;
+    float    goal;                  // Averaged goal value
+    float    regret;
+};
+
+#define CRTS_LOG_CLOCK_WALL 0
+#define CRTS_LOG_CLOCK_VIRTUAL 1
+
+// Start (num_repetitions) or end (the rest) of a cell
+struct crts_log_cell {
+    uint32_t num_repetitions;
+    uint32_t clock;                 // CRTS_LOG_CLOCK_
+    double   time;                  // Length of the test on that clock [s]
+    uint32_t paced_frames;          // Frame pacing of USRP runs. 0 if not paced.
+    uint32_t pacing_overruns;
+    int64_t  pacing_interval_ns;
+    int64_t  pacing_max_ns;         // Lateness of the frames
+    double   pacing_sum_ns;
+    double   pacing_sumsq_ns;
+};
+
+struct crts_log_record {
+    uint16_t type;                  // crts_log_record_type
+    uint16_t i_CE;                  // Cell, from 0
+    uint16_t i_Sc;
+    uint16_t repetition;
+    uint64_t timestamp_ns;          // CLOCK_MONOTONIC when the record was made
+    union {
+        struct crts_log_frame frame;
+        struct crts_log_cell cell;
+    } u;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CRTS_LOG_H
@@ -0,0 +1,219 @@
+// Latency of the stages of the per-frame work, built in with -DCRTS_PROFILE.
+//
+// Each stage has an HDR-style log-linear histogram: values below 2^S ticks
+// get a bucket each and every power of two above that is split into 2^S
+// equal buckets, so a quantile is within 2^-S (about 3%) of the true value
+// anywhere in the 64-bit range, in a fixed 7.5 KiB per stage. Recording
+// counts the leading zeros of the value and increments a counter; nothing
+// is allocated or locked, so each profile may only be recorded by one
+// thread. Profiles of other threads are merged in with stageProfileMerge().
+//
+// Times are read from the TSC on x86 and from CLOCK_MONOTONIC elsewhere,
+// and turned into nanoseconds only when a report is printed.
+//
+// Without CRTS_PROFILE the PROFILE_ macros expand to nothing and none of the
+// rest is compiled.
+
+#ifndef STAGE_PROFILE_H
+#define STAGE_PROFILE_H
+
+#ifdef CRTS_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STAGE_PROFILE_TSC 1
+#endif
+
+// Stages of one frame. The sync stage includes the rxCallback() calls made
+// from inside ofdmflexframesync_execute(), so those two overlap.
+enum profileStage {
+    PROFILE_PAYLOAD = 0,        // Header and payload generation
+    PROFILE_ASSEMBLE,           // ofdmflexframegen_assemble()
+    PROFILE_WRITE_SYMBOL,       // ofdmflexframegen_writesymbol(), per symbol
+    PROFILE_CHANNEL,            // enactScenarioBasebandTx(), per symbol
+    PROFILE_TRANSMIT,           // Handing a symbol to the USRP
+    PROFILE_SYNC,               // ofdmflexframesync_execute(), per symbol
+    PROFILE_RX_CALLBACK,        // rxCallback(), per frame received
+    PROFILE_POST_TX,            // postTxTasks(), per frame
+    NUM_PROFILE_STAGES
+};
+
+static const char * const profileStageNames[NUM_PROFILE_STAGES] = {
+    "payload", "assemble", "writesymbol", "channel", "transmit", "sync", "rxCallback", "postTxTasks"
+};
+
+#define LATENCY_HISTOGRAM_SUB_BITS 5
+#define LATENCY_HISTOGRAM_BUCKETS ((64-LATENCY_HISTOGRAM_SUB_BITS+1) << LATENCY_HISTOGRAM_SUB_BITS)
+
+struct latencyHistogram {
+    unsigned long long count;
+    unsigned long long sum;                 // Ticks
+    unsigned long long max;
+    unsigned int buckets[LATENCY_HISTOGRAM_BUCKETS];
+};
+
+struct stageProfile {
+    struct latencyHistogram stages[NUM_PROFILE_STAGES];
+};
+
+static inline unsigned long long stageProfileTicks()
+{
+#ifdef STAGE_PROFILE_TSC
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec*1000000000ULL + now.tv_nsec;
+#endif
+}
+
+static inline int latencyHistogramBucket(unsigned long long v)
+{
+    if (v < (1ULL << LATENCY_HISTOGRAM_SUB_BITS))
+        return (int) v;
+    int shift = 63 - __builtin_clzll(v) - LATENCY_HISTOGRAM_SUB_BITS;
+    return ((shift+1) << LATENCY_HISTOGRAM_SUB_BITS) + (int) ((v >> shift) - (1ULL << LATENCY_HISTOGRAM_SUB_BITS));
+}
+
+// Smallest value that falls into bucket b, and the number of values that do
+static inline unsigned long long latencyHistogramBucketLow(int b, unsigned long long * width)
+{
+    if (b < (1 << LATENCY_HISTOGRAM_SUB_BITS))
+    {
+        *width = 1;
+        return (unsigned long long) b;
+    }
+    int shift = (b >> LATENCY_HISTOGRAM_SUB_BITS) - 1;
+    unsigned long long sub = (unsigned long long) (b & ((1 << LATENCY_HISTOGRAM_SUB_BITS) - 1));
+    *width = 1ULL << shift;
+    return ((1ULL << LATENCY_HISTOGRAM_SUB_BITS) + sub) << shift;
+}
+
+static inline void stageProfileRecord(struct stageProfile * p, int stage, unsigned long long ticks)
+{
+    if (p == NULL)
+        return;
+    struct latencyHistogram * h = &p->stages[stage];
+    h->count++;
+    h->sum += ticks;
+    if (ticks > h->max)
+        h->max = ticks;
+    h->buckets[latencyHistogramBucket(ticks)]++;
+}
+
+static inline void stageProfileReset(struct stageProfile * p)
+{
+    memset(p, 0, sizeof(struct stageProfile));
+}
+
+// Add the counts of src to dst, e.g. to combine the repetitions of a cell
+static inline void stageProfileMerge(struct stageProfile * dst, const struct stageProfile * src)
+{
+    for (int s=0; s<NUM_PROFILE_STAGES; s++)
+    {
+        struct latencyHistogram * d = &dst->stages[s];
+        const struct latencyHistogram * h = &src->stages[s];
+        d->count += h->count;
+        d->sum += h->sum;
+        if (h->max > d->max)
+            d->max = h->max;
+        for (int b=0; b<LATENCY_HISTOGRAM_BUCKETS; b++)
+            d->buckets[b] += h->buckets[b];
+    }
+}
+
+// q-quantile (0 < q <= 1) in ticks: the middle of the bucket it falls into,
+// but never more than the largest value recorded
+static inline double latencyHistogramQuantile(const struct latencyHistogram * h, double q)
+{
+    if (h->count == 0)
+        return 0.0;
+    unsigned long long target = (unsigned long long) ceil(q*h->count);
+    if (target < 1)
+        target = 1;
+    unsigned long long cumulative = 0;
+    for (int b=0; b<LATENCY_HISTOGRAM_BUCKETS; b++)
+    {
+        cumulative += h->buckets[b];
+        if (cumulative >= target)
+        {
+            unsigned long long width;
+            double v = (double) latencyHistogramBucketLow(b, &width) + 0.5*(double) (width-1);
+            return v < (double) h->max ? v : (double) h->max;
+        }
+    }
+    return (double) h->max;
+}
+
+// Nanoseconds per tick. The TSC is measured against CLOCK_MONOTONIC the
+// first time this is called, which takes 10 ms.
+static inline double stageProfileNsPerTick()
+{
+#ifdef STAGE_PROFILE_TSC
+    static double nsPerTick = 0.0;
+    if (nsPerTick == 0.0)
+    {
+        struct timespec t0, t1;
+        struct timespec pause = {0, 10000000};
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        unsigned long long c0 = __rdtsc();
+        nanosleep(&pause, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        unsigned long long c1 = __rdtsc();
+        double ns = (double) (t1.tv_sec - t0.tv_sec)*1e9 + (double) (t1.tv_nsec - t0.tv_nsec);
+        nsPerTick = c1 > c0 ? ns/(double) (c1 - c0) : 1.0;
+    }
+    return nsPerTick;
+#else
+    return 1.0;
+#endif
+}
+
+// Print a table of the stages that were recorded, in microseconds
+static inline void stageProfilePrint(FILE * f, const struct stageProfile * p, int i_CE, int i_Sc)
+{
+    double us = stageProfileNsPerTick()*1e-3;
+    fprintf(f, "Stage latency of Cognitive Engine %i in Scenario %i [us]:\n", i_CE+1, i_Sc+1);
+    fprintf(f, "%-13s %10s %10s %10s %10s %10s %10s %12s\n",
+        "Stage", "Count", "Mean", "p50", "p99", "p99.9", "Max", "Total[ms]");
+    for (int s=0; s<NUM_PROFILE_STAGES; s++)
+    {
+        const struct latencyHistogram * h = &p->stages[s];
+        if (h->count == 0)
+            continue;
+        fprintf(f, "%-13s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f %12.3f\n",
+            profileStageNames[s], h->count,
+            (double) h->sum/h->count*us,
+            latencyHistogramQuantile(h, 0.5)*us,
+            latencyHistogramQuantile(h, 0.99)*us,
+            latencyHistogramQuantile(h, 0.999)*us,
+            (double) h->max*us,
+            (double) h->sum*us*1e-3);
+    }
+    if (p->stages[PROFILE_SYNC].count > 0 && p->stages[PROFILE_RX_CALLBACK].count > 0)
+        fprintf(f, "(%s includes %s: the two rows overlap and do not add up)\n",
+            profileStageNames[PROFILE_SYNC], profileStageNames[PROFILE_RX_CALLBACK]);
+}
+
+// PROFILE_START(t) declares t and reads the clock into it. PROFILE_LAP()
+// records the time since t as one value of the stage and restarts t, so
+// consecutive stages share a clock read.
+#define PROFILE_START(t) unsigned long long t = stageProfileTicks()
+#define PROFILE_LAP(prof, stage, t) do { \
+        unsigned long long profile_now_ = stageProfileTicks(); \
+        stageProfileRecord((prof), (stage), profile_now_ - (t)); \
+        (t) = profile_now_; \
+    } while (0)
+
+#else
+
+#define PROFILE_START(t) do {} while (0)
+#define PROFILE_LAP(prof, stage, t) do {} while (0)
+
+#endif // CRTS_PROFILE
+
+#endif // STAGE_PROFILE_H
@@ -0,0 +1,177 @@
+// Statistics over a sliding window of the last 'length' values.
+//
+// Every update is O(1), amortized for the minimum and maximum: the mean and
+// variance are kept as running sums, the minimum and maximum with monotonic
+// deques, the EWMA as a single value, and approximate quantiles with a
+// histogram of the window over a range chosen for each metric.
+//
+// Windows of up to N values are stored inside the object; longer windows
+// are allocated on the heap. The object has no constructors so that it can
+// live in plain C-style structs. It must be set up with init() and, when it
+// may hold heap storage, released with release(). A copy shares that
+// storage, so give copies their own with init().
+
+#ifndef WINDOWED_STATS_H
+#define WINDOWED_STATS_H
+
+#include <stdlib.h>
+#include <math.h>
+
+// Number of histogram bins used for quantiles
+#define WINDOWED_STATS_BINS 64
+
+template <class T, int N>
+struct windowed_stats {
+    int length;                         // Window length
+    int count;                          // Values in the window, up to length
+    unsigned int seq;                   // Number of updates since init()
+    double sum;
+    double sumsq;
+    float alpha;                        // EWMA weight of the newest value
+    float ewma_value;
+    float lo, hi;                       // Range of the quantile histogram
+    int hist[WINDOWED_STATS_BINS];
+    int min_head, min_size;             // Deques of update numbers, oldest first.
+    int max_head, max_size;             // Their values increase (min) or decrease (max).
+    T * heap_values;                    // NULL when the window fits inside the object
+    unsigned int * heap_min;
+    unsigned int * heap_max;
+    T inline_values[N];
+    unsigned int inline_min[N];
+    unsigned int inline_max[N];
+
+    // Start an empty window. Quantiles are exact to one bin for values in
+    // [hist_lo, hist_hi]; values outside it count towards the nearest end.
+    // The EWMA is not limited to the window; it starts at the first value.
+    void init(int window_length, float hist_lo, float hist_hi, float ewma_alpha = 0.1f)
+    {
+        length = window_length > 0 ? window_length : 1;
+        count = 0;
+        seq = 0;
+        sum = sumsq = 0.0;
+        alpha = ewma_alpha;
+        ewma_value = 0.0f;
+        lo = hist_lo;
+        hi = hist_hi > hist_lo ? hist_hi : hist_lo + 1.0f;
+        for (int i=0; i<WINDOWED_STATS_BINS; i++)
+            hist[i] = 0;
+        min_head = min_size = max_head = max_size = 0;
+        heap_values = NULL;
+        heap_min = heap_max = NULL;
+        if (length > N)
+        {
+            heap_values = (T *) malloc(length*sizeof(T));
+            heap_min = (unsigned int *) malloc(length*sizeof(unsigned int));
+            heap_max = (unsigned int *) malloc(length*sizeof(unsigned int));
+        }
+    }
+
+    void release()
+    {
+        free(heap_values);
+        free(heap_min);
+        free(heap_max);
+        heap_values = NULL;
+        heap_min = heap_max = NULL;
+    }
+
+    T * values() { return heap_values ? heap_values : inline_values; }
+    unsigned int * min_deque() { return heap_min ? heap_min : inline_min; }
+    unsigned int * max_deque() { return heap_max ? heap_max : inline_max; }
+
+    int bin(T x) const
+    {
+        int b = (int) (((float) x - lo)/(hi - lo)*WINDOWED_STATS_BINS);
+        return b < 0 ? 0 : (b >= WINDOWED_STATS_BINS ? WINDOWED_STATS_BINS-1 : b);
+    }
+
+    // Add a value, dropping the oldest one once the window is full
+    void update(T x)
+    {
+        T * v = values();
+        unsigned int * mn = min_deque();
+        unsigned int * mx = max_deque();
+        int pos = seq % length;
+
+        // Drop the value leaving the window
+        if (count == length)
+        {
+            T old = v[pos];
+            sum -= (double) old;
+            sumsq -= (double) old*(double) old;
+            hist[bin(old)]--;
+            if (min_size > 0 && mn[min_head] == seq-length) { min_head = (min_head+1)%length; min_size--; }
+            if (max_size > 0 && mx[max_head] == seq-length) { max_head = (max_head+1)%length; max_size--; }
+        }
+        else
+            count++;
+
+        v[pos] = x;
+        sum += (double) x;
+        sumsq += (double) x*(double) x;
+        hist[bin(x)]++;
+        ewma_value = seq == 0 ? (float) x : alpha*(float) x + (1.0f-alpha)*ewma_value;
+
+        // Values that can no longer be the minimum or maximum leave the back
+        // of the deques. Each update is pushed and popped at most once.
+        while (min_size > 0 && v[mn[(min_head+min_size-1)%length] % length] >= x) min_size--;
+        mn[(min_head+min_size)%length] = seq;
+        min_size++;
+        while (max_size > 0 && v[mx[(max_head+max_size-1)%length] % length] <= x) max_size--;
+        mx[(max_head+max_size)%length] = seq;
+        max_size++;
+
+        seq++;
+
+        // Recompute the sums once per window so that rounding errors
+        // cannot accumulate. Amortized O(1).
+        if (seq % length == 0)
+        {
+            sum = sumsq = 0.0;
+            for (int i=0; i<count; i++)
+            {
+                sum += (double) v[i];
+                sumsq += (double) v[i]*(double) v[i];
+            }
+        }
+    }
+
+    float mean() const { return count ? (float) (sum/count) : 0.0f; }
+
+    // Population variance of the window
+    float variance() const
+    {
+        if (count == 0)
+            return 0.0f;
+        double m = sum/count;
+        double var = sumsq/count - m*m;
+        return var > 0.0 ? (float) var : 0.0f;
+    }
+
+    float stddev() const { return sqrtf(variance()); }
+    float ewma() const { return ewma_value; }
+
+    T min() { return count ? values()[min_deque()[min_head] % length] : (T) 0; }
+    T max() { return count ? values()[max_deque()[max_head] % length] : (T) 0; }
+
+    // Approximate q-quantile (0 <= q <= 1), interpolated within a histogram bin
+    float quantile(float q) const
+    {
+        if (count == 0)
+            return 0.0f;
+        float target = q*count;
+        int cumulative = 0;
+        for (int b=0; b<WINDOWED_STATS_BINS; b++)
+        {
+            if (hist[b] > 0 && cumulative + hist[b] >= target)
+            {
+                float frac = (target - cumulative)/hist[b];
+                return lo + (hi - lo)*(b + frac)/WINDOWED_STATS_BINS;
+            }
+            cumulative += hist[b];
+        }
+        return hi;
+    }
+};
+
+#endif // WINDOWED_STATS_H